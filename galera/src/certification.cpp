@@ -133,9 +133,9 @@ galera::Certification::purge_for_trx_v3(TrxHandle* trx)
         KeyEntryNG* const kep(*ci);
         assert(kep->referenced());
 
-        wsrep_key_type_t const p(kp.wsrep_type(trx->version()));
+        int const p(KeyEntryNG::ref_type(kp.wsrep_type(trx->version()), trx));
 
-        if (kep->ref_trx(p) == trx)
+        if (kep->ref_by(p, trx))
         {
             kep->unref(p, trx);
 
@@ -475,8 +475,16 @@ cert_fail:
     return TEST_FAILED;
 }
 
+static inline const char*
+ref_type_str(int const ref_type)
+{
+    return (galera::KeyEntryNG::REF_COMMUTATIVE       == ref_type ||
+            galera::KeyEntryNG::REF_COMMUTATIVE_OTHER == ref_type ? "CX" :
+            galera::KeySet::type(wsrep_key_type_t(ref_type)));
+}
+
 /* Specifically for chain use in certify_and_depend_v3to4() */
-template <wsrep_key_type_t REF_KEY_TYPE>
+template <int REF_KEY_TYPE>
 bool
 check_against(const galera::KeyEntryNG*   const found,
               const galera::KeySet::KeyPart&    key,
@@ -490,13 +498,19 @@ check_against(const galera::KeyEntryNG*   const found,
     // trx should not have any references in index at this point
     assert(ref_trx != trx);
 
+    /* exclusive keys of commutative trxs are exclusive to everyone else */
+    bool const ref_exclusive(
+        REF_KEY_TYPE == WSREP_KEY_EXCLUSIVE ||
+        REF_KEY_TYPE == galera::KeyEntryNG::REF_COMMUTATIVE ||
+        REF_KEY_TYPE == galera::KeyEntryNG::REF_COMMUTATIVE_OTHER);
+
     bool conflict(false);
 
     if (gu_likely(0 != ref_trx))
     {
-        if (REF_KEY_TYPE == WSREP_KEY_EXCLUSIVE && ref_trx)
+        if (ref_exclusive)
         {
-            cert_debug << KeySet::type(REF_KEY_TYPE) << " match: "
+            cert_debug << ref_type_str(REF_KEY_TYPE) << " match: "
                        << *trx << " <-----> " << *ref_trx;
         }
 
@@ -508,6 +522,8 @@ check_against(const galera::KeyEntryNG*   const found,
         // 2) ref_trx is in isolation mode, write sets are within cert range
         switch(REF_KEY_TYPE)
         {
+        case galera::KeyEntryNG::REF_COMMUTATIVE:
+        case galera::KeyEntryNG::REF_COMMUTATIVE_OTHER:
         case WSREP_KEY_EXCLUSIVE:
             conflict = ref_trx->is_toi();
             /* fall through */
@@ -521,7 +537,7 @@ check_against(const galera::KeyEntryNG*   const found,
         if (gu_unlikely(cert_debug_on || (conflict && log_conflict == true)))
         {
             log_info << KeySet::type(key_type) << '-'
-                     << KeySet::type(REF_KEY_TYPE)
+                     << ref_type_str(REF_KEY_TYPE)
                      << " trx " << (conflict ? "conflict" : "match")
                      << " for key " << key << ": "
                      << *trx << " <---> " << *ref_trx;
@@ -531,8 +547,7 @@ check_against(const galera::KeyEntryNG*   const found,
         {
             depends_seqno = -1;
         }
-        else if (key_type     == WSREP_KEY_EXCLUSIVE ||
-                 REF_KEY_TYPE == WSREP_KEY_EXCLUSIVE)
+        else if (key_type == WSREP_KEY_EXCLUSIVE || ref_exclusive)
         {
             depends_seqno = std::max(ref_trx->global_seqno(), depends_seqno);
         }
@@ -565,9 +580,20 @@ certify_and_depend_v3to4(const galera::KeyEntryNG*   const found,
      *
      * Note that depends_seqno is an in/out parameter and is updated on every
      * step.
+     *
+     * Exclusive keys of commutative trxs (cx) are referenced separately and
+     * are treated as ex by everyone except other commutative trxs:
+     * cx-cx gives N, so commutative trxs neither conflict with nor depend on
+     * each other, but are still ordered against non-commutative writers.
+     * Two cx references are kept per key, see KeyEntryNG::REF_COMMUTATIVE.
      */
     if (check_against<WSREP_KEY_EXCLUSIVE>
         (found, key, key_type, trx, log_conflict, depends_seqno) ||
+        (!trx->is_commutative() &&
+         (check_against<galera::KeyEntryNG::REF_COMMUTATIVE>
+          (found, key, key_type, trx, log_conflict, depends_seqno) ||
+          check_against<galera::KeyEntryNG::REF_COMMUTATIVE_OTHER>
+          (found, key, key_type, trx, log_conflict, depends_seqno))) ||
         (key_type == WSREP_KEY_EXCLUSIVE &&
          /* exclusive keys must be checked against shared */
          (check_against<WSREP_KEY_SEMI>
@@ -665,7 +691,8 @@ galera::Certification::do_test_v3to4(TrxHandle* trx, bool store_keys)
 
             KeyEntryNG* const kep(*ci);
 
-            kep->ref(k.wsrep_type(trx->version()), k, trx);
+            kep->ref(KeyEntryNG::ref_type(k.wsrep_type(trx->version()), trx),
+                     k, trx);
 
         }
 
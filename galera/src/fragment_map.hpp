@@ -0,0 +1,130 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#ifndef GALERA_FRAGMENT_MAP_HPP
+#define GALERA_FRAGMENT_MAP_HPP
+
+#include "trx_handle.hpp"
+#include "uuid.hpp"
+
+#include "wsrep_api.h"
+
+#include <map>
+#include <cstring>
+
+namespace galera
+{
+
+/*
+ * Fragments of remote streaming transactions replicated so far, keyed by
+ * (source, trx id). The fragments are kept until the committing or the
+ * rolling back write set of the transaction arrives.
+ *
+ * An entry is created only by the first (F_BEGIN) fragment, so fragments
+ * of transactions whose beginning was not seen (e.g. the map was cleared by
+ * a configuration change in between) are never collected and such a
+ * transaction can't be completed.
+ *
+ * The class is not thread safe: all calls are serialized by the local
+ * monitor or, during IST, by the apply monitor.
+ */
+class FragmentMap
+{
+public:
+
+    FragmentMap() : map_() {}
+
+    ~FragmentMap()
+    {
+        TrxHandle::Fragments tmp;
+        clear(tmp);
+        for (size_t i(0); i < tmp.size(); ++i) tmp[i]->unref();
+    }
+
+    /* Stores intermediate fragment, takes a reference to it.
+     * Returns false if the fragment was not stored. */
+    bool insert(TrxHandle* const frag)
+    {
+        assert(frag->is_fragment());
+
+        Key const key(frag->source_id(), frag->trx_id());
+        Map::iterator i(map_.find(key));
+
+        if (frag->flags() & TrxHandle::F_BEGIN)
+        {
+            if (gu_unlikely(i != map_.end()))
+            {
+                log_warn << "Duplicate first fragment of streaming trx "
+                         << frag->trx_id() << " from " << frag->source_id()
+                         << ", seqno: " << frag->global_seqno();
+                return false;
+            }
+
+            i = map_.insert(std::make_pair(key, TrxHandle::Fragments())).first;
+        }
+        else if (i == map_.end())
+        {
+            return false;
+        }
+
+        frag->ref();
+        i->second.push_back(frag);
+
+        return true;
+    }
+
+    /* Moves fragments collected for the trx to the end of frags.
+     * Returns false if the trx has no entry. */
+    bool remove(const TrxHandle& trx, TrxHandle::Fragments& frags)
+    {
+        Map::iterator const i(map_.find(Key(trx.source_id(), trx.trx_id())));
+
+        if (i == map_.end()) return false;
+
+        frags.insert(frags.end(), i->second.begin(), i->second.end());
+        map_.erase(i);
+
+        return true;
+    }
+
+    /* Moves all collected fragments to the end of frags. */
+    void clear(TrxHandle::Fragments& frags)
+    {
+        for (Map::iterator i(map_.begin()); i != map_.end(); ++i)
+        {
+            frags.insert(frags.end(), i->second.begin(), i->second.end());
+        }
+
+        map_.clear();
+    }
+
+    size_t size() const { return map_.size(); }
+
+private:
+
+    struct Key
+    {
+        Key(const wsrep_uuid_t& s, wsrep_trx_id_t t) : source(s), trx(t) {}
+
+        wsrep_uuid_t   source;
+        wsrep_trx_id_t trx;
+
+        bool operator< (const Key& other) const
+        {
+            if (trx != other.trx) return (trx < other.trx);
+            return (::memcmp(&source, &other.source, sizeof(source)) < 0);
+        }
+    };
+
+    typedef std::map<Key, TrxHandle::Fragments> Map;
+
+    Map map_;
+
+    FragmentMap(const FragmentMap&);
+    FragmentMap& operator=(const FragmentMap&);
+};
+
+} // namespace galera
+
+#endif // GALERA_FRAGMENT_MAP_HPP
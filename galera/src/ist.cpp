@@ -20,6 +20,37 @@ namespace
 {
     static std::string const CONF_KEEP_KEYS     ("ist.keep_keys");
     static bool        const CONF_KEEP_KEYS_DEFAULT (true);
+    static std::string const CONF_STRIPES       ("ist.stripes");
+    static int         const CONF_STRIPES_DEFAULT   (1);
+    static int         const MAX_STRIPES            (16);
+    static std::string const CONF_COMPRESS      ("ist.compress");
+    static bool        const CONF_COMPRESS_DEFAULT  (false);
+    static std::string const CONF_SEND_RATE     ("ist.send_rate");
+    static long long   const CONF_SEND_RATE_DEFAULT (0);
+    static std::string const CONF_SEND_ADAPTIVE ("ist.send_adaptive");
+    static bool        const CONF_SEND_ADAPTIVE_DEFAULT (false);
+    static std::string const CONF_SEND_PRIORITY ("ist.send_priority");
+    static std::string const CONF_SEND_PRIORITY_DEFAULT ("normal");
+    static std::string const CONF_RECV_QUEUE    ("ist.recv_queue_size");
+    static long long   const CONF_RECV_QUEUE_DEFAULT (1 << 25);
+
+    // compression algorithms requested by receiver
+    int compression_request(const gu::Config& conf)
+    {
+        return conf.get(CONF_COMPRESS, CONF_COMPRESS_DEFAULT) ?
+            galera::ist::Compressor::supported() :
+            galera::ist::Compressor::A_NONE;
+    }
+
+    bool low_priority(const std::string& value)
+    {
+        if (value == "low")    return true;
+        if (value == "normal") return false;
+
+        gu_throw_error(EINVAL) << "Invalid value for " << CONF_SEND_PRIORITY
+                               << ": '" << value
+                               << "', expected 'normal' or 'low'";
+    }
 }
 
 
@@ -35,9 +66,12 @@ namespace galera
                         wsrep_seqno_t first,
                         wsrep_seqno_t last,
                         AsyncSenderMap& asmap,
-                        int version)
+                        int version,
+                        int stripe,
+                        int stripes)
                 :
-                Sender (conf, asmap.gcache(), peer, version),
+                Sender (conf, asmap.gcache(), peer, version, stripe, stripes,
+                        &asmap.limiter(), &asmap.compression_stats()),
                 conf_  (conf),
                 peer_  (peer),
                 first_ (first),
@@ -75,6 +109,8 @@ std::string const
 galera::ist::Receiver::RECV_ADDR("ist.recv_addr");
 std::string const
 galera::ist::Receiver::RECV_BIND("ist.recv_bind");
+std::string const
+galera::ist::Sender::STRIPES_OPT(CONF_STRIPES);
 
 void
 galera::ist::register_params(gu::Config& conf)
@@ -82,6 +118,12 @@ galera::ist::register_params(gu::Config& conf)
     conf.add(Receiver::RECV_ADDR);
     conf.add(Receiver::RECV_BIND);
     conf.add(CONF_KEEP_KEYS);
+    conf.add(CONF_STRIPES);
+    conf.add(CONF_COMPRESS);
+    conf.add(CONF_SEND_RATE);
+    conf.add(CONF_SEND_ADAPTIVE);
+    conf.add(CONF_SEND_PRIORITY);
+    conf.add(CONF_RECV_QUEUE);
 }
 
 galera::ist::Receiver::Receiver(gu::Config&           conf,
@@ -96,11 +138,17 @@ galera::ist::Receiver::Receiver(gu::Config&           conf,
 #ifdef HAVE_PSI_INTERFACE
     mutex_        (WSREP_PFS_INSTR_TAG_IST_RECEIVER_MUTEX),
     cond_         (WSREP_PFS_INSTR_TAG_IST_RECEIVER_CONDVAR),
+    recv_cond_    (WSREP_PFS_INSTR_TAG_IST_CONSUMER_CONDVAR),
 #else
     mutex_        (),
     cond_         (),
+    recv_cond_    (),
 #endif /* HAVE_PSI_INTERFACE */
-    consumers_    (),
+    progress_     (),
+    comp_stats_   (),
+    queue_        (),
+    queue_bytes_  (0),
+    queue_max_bytes_(0),
     current_seqno_(-1),
     first_seqno_  (-1),
     last_seqno_   (-1),
@@ -109,10 +157,12 @@ galera::ist::Receiver::Receiver(gu::Config&           conf,
     thread_       (),
     error_code_   (0),
     version_      (-1),
+    eofs_         (0),
     use_ssl_      (false),
     running_      (false),
     interrupted_  (false),
-    ready_        (false)
+    ready_        (false),
+    failed_       (false)
 {
     std::string recv_addr;
     std::string recv_bind;
@@ -145,7 +195,9 @@ galera::ist::Receiver::Receiver(gu::Config&           conf,
 
 
 galera::ist::Receiver::~Receiver()
-{ }
+{
+    assert(queue_.empty());
+}
 
 
 extern "C" void* run_receiver_thread(void* arg)
@@ -169,6 +221,28 @@ extern "C" void* run_receiver_thread(void* arg)
     return 0;
 }
 
+extern "C" void* run_stripe_thread(void* arg)
+{
+#ifdef HAVE_PSI_INTERFACE
+    pfs_instr_callback(WSREP_PFS_INSTR_TYPE_THREAD,
+                       WSREP_PFS_INSTR_OPS_INIT,
+                       WSREP_PFS_INSTR_TAG_IST_RECEIVER_THREAD,
+                       NULL, NULL, NULL);
+#endif /* HAVE_PSI_INTERFACE */
+
+    galera::ist::Receiver::Stripe* s
+        (static_cast<galera::ist::Receiver::Stripe*>(arg));
+    s->receiver->run_stripe(*s);
+
+#ifdef HAVE_PSI_INTERFACE
+    pfs_instr_callback(WSREP_PFS_INSTR_TYPE_THREAD,
+                       WSREP_PFS_INSTR_OPS_DESTROY,
+                       WSREP_PFS_INSTR_TAG_IST_RECEIVER_THREAD,
+                       NULL, NULL, NULL);
+#endif /* HAVE_PSI_INTERFACE */
+    return 0;
+}
+
 static std::string
 IST_determine_recv_addr (gu::Config& conf)
 {
@@ -357,6 +431,27 @@ galera::ist::Receiver::prepare(wsrep_seqno_t first_seqno,
     current_seqno_ = first_seqno;
     first_seqno_   = first_seqno;
     last_seqno_    = last_seqno;
+    eofs_          = 0;
+    failed_        = false;
+    queue_max_bytes_ = std::max(conf_.get(CONF_RECV_QUEUE,
+                                          CONF_RECV_QUEUE_DEFAULT), 0LL);
+
+    // ask donor to stripe IST over several connections, donors that don't
+    // support it ignore the option
+    int const stripes(std::min(conf_.get(CONF_STRIPES, CONF_STRIPES_DEFAULT),
+                               MAX_STRIPES));
+    if (stripes > 1)
+    {
+        recv_addr_ += "?" + CONF_STRIPES + "=" + gu::to_string(stripes);
+    }
+
+    if (conf_.get(CONF_COMPRESS, CONF_COMPRESS_DEFAULT) &&
+        Compressor::supported() == Compressor::A_NONE)
+    {
+        log_warn << CONF_COMPRESS << " is set, but this build does not "
+                 << "support IST compression";
+    }
+
     int err;
     if ((err = gu_thread_create(&thread_, 0, &run_receiver_thread, this)) != 0)
     {
@@ -376,22 +471,26 @@ galera::ist::Receiver::prepare(wsrep_seqno_t first_seqno,
 }
 
 
-void galera::ist::Receiver::run()
+void galera::ist::Receiver::accept(Stripe& s)
 {
-    asio::ip::tcp::socket socket(io_service_);
-    asio::ssl::stream<asio::ip::tcp::socket> ssl_stream(io_service_, ssl_ctx_);
+    s.receiver = this;
+
     try
     {
         if (use_ssl_ == true)
         {
-            acceptor_.accept(ssl_stream.lowest_layer());
-            gu::set_fd_options(ssl_stream.lowest_layer());
-            ssl_stream.handshake(asio::ssl::stream<asio::ip::tcp::socket>::server);
+            s.ssl_stream = new asio::ssl::stream<asio::ip::tcp::socket>(
+                io_service_, ssl_ctx_);
+            acceptor_.accept(s.ssl_stream->lowest_layer());
+            gu::set_fd_options(s.ssl_stream->lowest_layer());
+            s.ssl_stream->handshake(
+                asio::ssl::stream<asio::ip::tcp::socket>::server);
         }
         else
         {
-            acceptor_.accept(socket);
-            gu::set_fd_options(socket);
+            s.socket = new asio::ip::tcp::socket(io_service_);
+            acceptor_.accept(*s.socket);
+            gu::set_fd_options(*s.socket);
         }
     }
     catch (asio::system_error& e)
@@ -401,24 +500,205 @@ void galera::ist::Receiver::run()
                                          << e.what() << "': "
                                          << gu::extra_error_info(e.code());
     }
-    acceptor_.close();
+}
+
+
+void galera::ist::Receiver::handshake(Proto& p, Stripe& s)
+{
+    Message hsr;
+
+    if (use_ssl_ == true)
+    {
+        p.send_handshake(*s.ssl_stream);
+        hsr = p.recv_handshake_response(*s.ssl_stream);
+        p.send_ctrl(*s.ssl_stream, Ctrl::C_OK);
+    }
+    else
+    {
+        p.send_handshake(*s.socket);
+        hsr = p.recv_handshake_response(*s.socket);
+        p.send_ctrl(*s.socket, Ctrl::C_OK);
+    }
+
+    s.count       = hsr.flags() > 0 ? hsr.flags() : 1;
+    s.index       = hsr.ctrl();
+    s.compression = p.compression();
+
+    if (s.index < 0 || s.index >= s.count)
+    {
+        gu_throw_error(EPROTO) << "invalid IST stripe " << s.index << '/'
+                               << s.count;
+    }
+}
+
+
+template <class ST>
+void galera::ist::Receiver::recv_stripe(ST& stream, Stripe& s)
+{
+    TrxHandle* trx(0);
     int ec(0);
+
     try
     {
         Proto p(trx_pool_, version_,
-                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT));
+                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT),
+                Compressor::A_NONE, &comp_stats_);
+        p.compression(s.compression);
 
-        if (use_ssl_ == true)
+        wsrep_seqno_t expected(first_seqno_ + s.index);
+
+        while (true)
+        {
+            trx = p.recv_trx(stream);
+
+            gu::Lock lock(mutex_);
+
+            if (trx != 0)
+            {
+                if (trx->global_seqno() != expected)
+                {
+                    log_error << "unexpected trx seqno: " << trx->global_seqno()
+                              << " expected: " << expected;
+                    ec = EINVAL;
+                    break;
+                }
+
+                expected += s.count;
+
+                // wait for the turn of this stripe
+                while (current_seqno_ != trx->global_seqno() &&
+                       !interrupted_ && !failed_)
+                {
+                    lock.wait(cond_);
+                }
+
+                if (current_seqno_ != trx->global_seqno()) break;
+
+                // wait for room in the queue, a write set bigger than the
+                // whole queue is let in when the queue is empty
+                size_t const size(trx->write_set_collection().size());
+
+                assert(ready_ || interrupted_);
+                while (!queue_.empty() &&
+                       queue_bytes_ + size > queue_max_bytes_ &&
+                       !interrupted_)
+                {
+                    lock.wait(cond_);
+                }
+
+                if (interrupted_) break;
+
+                queue_.push_back(trx);
+                queue_bytes_ += size;
+                recv_cond_.signal();
+
+                // the turn passes only after the write set is queued, so
+                // write sets are delivered strictly in seqno order
+                ++current_seqno_;
+                s.progress->update(1);
+                progress_.update(trx->global_seqno(), size);
+
+                cond_.broadcast(); // next seqno may belong to another stripe
+            }
+            else
+            {
+                // consumers are notified when run() completes
+                ++eofs_;
+                log_debug << "eof received, closing socket";
+                break;
+            }
+
+            trx = 0;
+        }
+    }
+    catch (asio::system_error& e)
+    {
+        log_error << "got error while reading ist stream: " << e.code();
+        ec = e.code().value();
+    }
+    catch (gu::Exception& e)
+    {
+        ec = e.get_errno();
+        if (ec != EINTR)
         {
-            p.send_handshake(ssl_stream);
-            p.recv_handshake_response(ssl_stream);
-            p.send_ctrl(ssl_stream, Ctrl::C_OK);
+            log_error << "got exception while reading ist stream: " << e.what();
         }
-        else
+    }
+
+    if (trx != 0) trx->unref();
+
+    if (ec != 0 && ec != EINTR)
+    {
+        gu::Lock lock(mutex_);
+        failed_ = true;
+        cond_.broadcast();
+    }
+
+    s.ec = ec;
+}
+
+
+void galera::ist::Receiver::run_stripe(Stripe& s)
+{
+    if (use_ssl_ == true)
+    {
+        recv_stripe(*s.ssl_stream, s);
+    }
+    else
+    {
+        recv_stripe(*s.socket, s);
+    }
+}
+
+
+void galera::ist::Receiver::run()
+{
+    std::vector<Stripe> stripes(1);
+
+    accept(stripes[0]);
+
+    int ec(0);
+    size_t threads(0);
+    try
+    {
+        Proto p(trx_pool_, version_,
+                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT),
+                compression_request(conf_));
+
+        handshake(p, stripes[0]);
+
+        int const count(stripes[0].count);
+        std::vector<bool> seen(count, false);
+        seen[stripes[0].index] = true;
+
+        // stripes may connect in any order
+        while (int(stripes.size()) < count)
+        {
+            stripes.push_back(Stripe());
+            accept(stripes.back());
+            handshake(p, stripes.back());
+
+            Stripe& s(stripes.back());
+            if (s.count != count || seen[s.index])
+            {
+                gu_throw_error(EPROTO) << "unexpected IST stripe " << s.index
+                                       << '/' << s.count << ", expected "
+                                       << count << " stripes";
+            }
+            seen[s.index] = true;
+        }
+
+        acceptor_.close();
+
+        if (count > 1)
         {
-            p.send_handshake(socket);
-            p.recv_handshake_response(socket);
-            p.send_ctrl(socket, Ctrl::C_OK);
+            log_info << "Receiving IST in " << count << " stripes";
+        }
+
+        if (p.compression() != Compressor::A_NONE)
+        {
+            log_info << "Receiving compressed IST, algorithm "
+                     << p.compression();
         }
 
         /* wait for ready signal from the STR thread */
@@ -436,52 +716,47 @@ void galera::ist::Receiver::run()
              * once per BOTH 10 seconds (default) and 16 events */
             16);
 
-        while (true)
+        for (size_t i(0); i < stripes.size(); ++i)
         {
-            TrxHandle* trx;
-            if (use_ssl_ == true)
-            {
-                trx = p.recv_trx(ssl_stream);
-            }
-            else
-            {
-                trx = p.recv_trx(socket);
-            }
-            if (trx != 0)
-            {
-                if (trx->global_seqno() != current_seqno_)
-                {
-                    log_error << "unexpected trx seqno: " << trx->global_seqno()
-                              << " expected: " << current_seqno_;
-                    ec = EINVAL;
-                    goto err;
-                }
-                ++current_seqno_;
+            stripes[i].progress = &progress;
+        }
 
-                progress.update(1);
-            }
-            gu::Lock lock(mutex_);
-            assert(ready_ || interrupted_);
-            while (consumers_.empty())
-            {
-                if (interrupted_)
-                {
-                    goto Intrrupted;
-                }
-                lock.wait(cond_);
-            }
-            Consumer* cons(consumers_.top());
-            consumers_.pop();
-            cons->trx(trx);
-            cons->cond().signal();
-            if (trx == 0)
+        progress_.start(current_seqno_, last_seqno_);
+
+        for (threads = 1; threads < stripes.size(); ++threads)
+        {
+            int const err(gu_thread_create(&stripes[threads].thread, 0,
+                                           &run_stripe_thread,
+                                           &stripes[threads]));
+            if (err != 0)
             {
-                log_debug << "eof received, closing socket";
+                log_error << "Unable to create IST stripe thread: " << err;
+                gu::Lock lock(mutex_);
+                failed_ = true;
+                cond_.broadcast();
+                ec = err;
                 break;
             }
         }
 
-        progress.finish();
+        run_stripe(stripes[0]);
+
+        for (size_t i(1); i < threads; ++i)
+        {
+            gu_thread_join(stripes[i].thread, 0);
+        }
+
+        for (size_t i(0); i < threads; ++i)
+        {
+            // report real error rather than EINTR of the stopped stripes
+            if (ec == 0 || ec == EINTR) ec = stripes[i].ec;
+        }
+
+        if (ec == 0)
+        {
+            progress.finish();
+            progress_.finish("IST received");
+        }
     }
     catch (asio::system_error& e)
     {
@@ -497,17 +772,23 @@ void galera::ist::Receiver::run()
         }
     }
 
-Intrrupted:
-err:
+    acceptor_.close();
+
     gu::Lock lock(mutex_);
-    if (use_ssl_ == true)
+    for (size_t i(0); i < stripes.size(); ++i)
     {
-        ssl_stream.lowest_layer().close();
-        // ssl_stream.shutdown();
-    }
-    else
-    {
-        socket.close();
+        if (stripes[i].ssl_stream)
+        {
+            stripes[i].ssl_stream->lowest_layer().close();
+            // ssl_stream.shutdown();
+            delete stripes[i].ssl_stream;
+        }
+
+        if (stripes[i].socket)
+        {
+            stripes[i].socket->close();
+            delete stripes[i].socket;
+        }
     }
 
     running_ = false;
@@ -521,11 +802,8 @@ err:
     {
         error_code_ = ec;
     }
-    while (consumers_.empty() == false)
-    {
-        consumers_.top()->cond().signal();
-        consumers_.pop();
-    }
+    // consumers drain the queue before they see the end of stream
+    recv_cond_.broadcast();
 }
 
 
@@ -533,37 +811,68 @@ void galera::ist::Receiver::ready()
 {
     gu::Lock lock(mutex_);
     ready_ = true;
-    cond_.signal();
+    cond_.broadcast();
 }
 
 int galera::ist::Receiver::recv(TrxHandle** trx)
 {
-    Consumer cons;
-    gu::Lock lock(mutex_);
-    if (running_ == false)
+    TrxHandle* ret;
     {
-        if (error_code_ != 0)
+        gu::Lock lock(mutex_);
+        while (queue_.empty() && running_)
         {
-            gu_throw_error(error_code_) << "IST receiver reported error";
+            lock.wait(recv_cond_);
         }
-        return EINTR;
-    }
-    consumers_.push(&cons);
-    cond_.signal();
-    lock.wait(cons.cond());
-    if (cons.trx() == 0)
-    {
-        if (error_code_ != 0)
+        if (queue_.empty())
         {
-            gu_throw_error(error_code_) << "IST receiver reported error";
+            // error_code_ is never EINTR, see run()
+            return (error_code_ != 0 ? error_code_ : EINTR);
         }
-        return EINTR;
+        ret = queue_.front();
+        queue_.pop_front();
+        queue_bytes_ -= ret->write_set_collection().size();
+        cond_.broadcast(); // a stripe may be waiting for room
     }
-    *trx = cons.trx();
+
+    // receiver thread only reads write sets from the socket, parsing
+    // is done here, concurrently by all consumers
+    try
+    {
+        Proto::parse_trx(ret);
+    }
+    catch (...)
+    {
+        ret->unref();
+        throw;
+    }
+
+    *trx = ret;
     return 0;
 }
 
 
+wsrep_seqno_t galera::ist::Receiver::delivered_seqno()
+{
+    gu::Lock lock(mutex_);
+    return current_seqno_ - 1 - queue_.size();
+}
+
+
+int galera::ist::Receiver::error()
+{
+    gu::Lock lock(mutex_);
+    return error_code_;
+}
+
+
+void galera::ist::Receiver::queue_stats(size_t& len, size_t& bytes)
+{
+    gu::Lock lock(mutex_);
+    len   = queue_.size();
+    bytes = queue_bytes_;
+}
+
+
 wsrep_seqno_t galera::ist::Receiver::finished()
 {
     if (recv_addr_ == "")
@@ -580,7 +889,7 @@ wsrep_seqno_t galera::ist::Receiver::finished()
         {
             gu::Lock local_lock(mutex_);
             interrupted_ = true;
-            cond_.signal();
+            cond_.broadcast();
         }
 
         int err;
@@ -595,12 +904,19 @@ wsrep_seqno_t galera::ist::Receiver::finished()
 
         running_ = false;
 
-        while (consumers_.empty() == false)
+        // write sets not consumed by now are never applied
+        if (!queue_.empty())
         {
-            consumers_.top()->cond().signal();
-            consumers_.pop();
+            log_info << "Discarding " << queue_.size() << " queued IST "
+                     << "write sets";
+            current_seqno_ -= queue_.size();
+            for (size_t i(0); i < queue_.size(); ++i) queue_[i]->unref();
+            queue_.clear();
+            queue_bytes_ = 0;
         }
 
+        recv_cond_.broadcast();
+
         recv_addr_ = "";
     }
 
@@ -665,7 +981,11 @@ void galera::ist::Receiver::interrupt()
 galera::ist::Sender::Sender(const gu::Config&  conf,
                             gcache::GCache&    gcache,
                             const std::string& peer,
-                            int                version)
+                            int                version,
+                            int                stripe,
+                            int                stripes,
+                            RateLimiter*       limiter,
+                            Compressor::Stats* comp_stats)
     :
     io_service_(),
     socket_    (io_service_),
@@ -674,8 +994,16 @@ galera::ist::Sender::Sender(const gu::Config&  conf,
     conf_      (conf),
     gcache_    (gcache),
     version_   (version),
-    use_ssl_   (false)
+    stripe_    (stripe),
+    stripes_   (stripes),
+    use_ssl_   (false),
+    limiter_   (limiter),
+    comp_stats_(comp_stats),
+    priority_  (),
+    progress_  ()
 {
+    assert(stripe_ >= 0 && stripe_ < stripes_);
+
     gu::URI uri(peer);
     try
     {
@@ -730,28 +1058,30 @@ galera::ist::Sender::~Sender()
 
 void galera::ist::Sender::send(wsrep_seqno_t first, wsrep_seqno_t last)
 {
-    if (first > last)
+    if (first + stripe_ > last)
     {
         gu_throw_error(EINVAL) << "sender send first greater than last: "
-                               << first << " > " << last ;
+                               << first << " + " << stripe_ << " > " << last;
     }
     try
     {
         TrxHandle::SlavePool unused(1, 0, "");
+        // donor agrees to any compression it supports
         Proto p(unused, version_,
-                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT));
+                conf_.get(CONF_KEEP_KEYS, CONF_KEEP_KEYS_DEFAULT),
+                Compressor::supported(), comp_stats_);
         int32_t ctrl;
 
         if (use_ssl_ == true)
         {
             p.recv_handshake(*ssl_stream_);
-            p.send_handshake_response(*ssl_stream_);
+            p.send_handshake_response(*ssl_stream_, stripes_, stripe_);
             ctrl = p.recv_ctrl(*ssl_stream_);
         }
         else
         {
             p.recv_handshake(socket_);
-            p.send_handshake_response(socket_);
+            p.send_handshake_response(socket_, stripes_, stripe_);
             ctrl = p.recv_ctrl(socket_);
         }
         if (ctrl < 0)
@@ -760,63 +1090,123 @@ void galera::ist::Sender::send(wsrep_seqno_t first, wsrep_seqno_t last)
                 << "ist send failed, peer reported error: " << ctrl;
         }
 
+        progress_.start(first, last, stripes_);
+
+        std::string const name(stripes_ > 1 ?
+                               "Sending IST stripe " + gu::to_string(stripe_) :
+                               "Sending IST");
+        // this stripe sends every stripes_-th seqno starting with its own
+        size_t const stride(stripes_);
+        first += stripe_;
+
+        gu::Progress<wsrep_seqno_t> log_progress(
+            name, " events", (last - first) / stride + 1, 16);
+
         std::vector<gcache::GCache::Buffer> buf_vec(
-            std::min(static_cast<size_t>(last - first + 1),
+            std::min(static_cast<size_t>((last - first) / stride + 1),
                      static_cast<size_t>(1024)));
         ssize_t n_read;
-        while ((n_read = gcache_.seqno_get_buffers(buf_vec, first)) > 0)
+        while ((n_read = gcache_.seqno_get_buffers(buf_vec, first, stride)) > 0)
         {
             GU_DBUG_SYNC_WAIT("ist_sender_send_after_get_buffers")
             //log_info << "read " << first << " + " << n_read << " from gcache";
-            for (wsrep_seqno_t i(0); i < n_read; ++i)
+
+            wsrep_seqno_t const next(first + n_read * stride);
+
+            if (next <= last)
+            {
+                // let the kernel read in the next batch while this one
+                // is being sent
+                gcache_.seqno_prefetch(next,
+                                       std::min(static_cast<size_t>(
+                                                    (last - next) / stride + 1),
+                                                buf_vec.size()),
+                                       stride);
+            }
+
+            const gcache::GCache::Buffer* to_send(&buf_vec[0]);
+            size_t n_send(n_read);
+
+            while (n_send > 0)
             {
-                // log_info << "sending " << buf_vec[i].seqno_g();
+                size_t n(n_send);
+
+                if (limiter_ != 0)
+                {
+                    limiter_->apply_priority(priority_);
+
+                    // split the batch so that sleeps stay short
+                    size_t const burst(limiter_->burst());
+                    size_t bytes(to_send[0].size());
+                    for (n = 1; n < n_send && (0 == burst || bytes < burst);
+                         ++n)
+                    {
+                        bytes += to_send[n].size();
+                    }
+                    limiter_->consume(bytes);
+                }
+
                 if (use_ssl_ == true)
                 {
-                    p.send_trx(*ssl_stream_, buf_vec[i]);
+                    p.send_trx(*ssl_stream_, to_send, n);
                 }
                 else
                 {
-                    p.send_trx(socket_, buf_vec[i]);
+                    p.send_trx(socket_, gcache_, to_send, n);
                 }
 
-                if (buf_vec[i].seqno_g() == last)
+                size_t bytes(0);
+                for (size_t i(0); i < n; ++i) bytes += to_send[i].size();
+                progress_.update(to_send[n - 1].seqno_g(), bytes, n);
+                log_progress.update(n);
+
+                to_send += n;
+                n_send  -= n;
+            }
+
+            // buf_vec is never longer than the remaining range
+            assert(buf_vec[n_read - 1].seqno_g() <= last);
+
+            if (next > last)
+            {
+                log_progress.finish();
+                progress_.finish((name + " done:").c_str());
+                if (use_ssl_ == true)
+                {
+                    p.send_ctrl(*ssl_stream_, Ctrl::C_EOF);
+                }
+                else
+                {
+                    p.send_ctrl(socket_, Ctrl::C_EOF);
+                }
+                // wait until receiver closes the connection
+                try
                 {
+                    gu::byte_t b;
+                    size_t n;
                     if (use_ssl_ == true)
                     {
-                        p.send_ctrl(*ssl_stream_, Ctrl::C_EOF);
+                        n = asio::read(*ssl_stream_, asio::buffer(&b, 1));
                     }
                     else
                     {
-                        p.send_ctrl(socket_, Ctrl::C_EOF);
+                        n = asio::read(socket_, asio::buffer(&b, 1));
                     }
-                    // wait until receiver closes the connection
-                    try
+                    if (n > 0)
                     {
-                        gu::byte_t b;
-                        size_t n;
-                        if (use_ssl_ == true)
-                        {
-                            n = asio::read(*ssl_stream_, asio::buffer(&b, 1));
-                        }
-                        else
-                        {
-                            n = asio::read(socket_, asio::buffer(&b, 1));
-                        }
-                        if (n > 0)
-                        {
-                            log_warn << "received " << n
-                                     << " bytes, expected none";
-                        }
+                        log_warn << "received " << n
+                                 << " bytes, expected none";
                     }
-                    catch (asio::system_error& e)
-                    { }
-                    return;
                 }
+                catch (asio::system_error& e)
+                { }
+                return;
             }
-            first += n_read;
+
+            first = next;
             // resize buf_vec to avoid scanning gcache past last
-            size_t next_size(std::min(static_cast<size_t>(last - first + 1),
+            size_t next_size(std::min(static_cast<size_t>(
+                                          (last - first) / stride + 1),
                                       static_cast<size_t>(1024)));
 
             if (buf_vec.size() != next_size)
@@ -849,7 +1239,10 @@ void* run_async_sender(void* arg)
 #endif /* HAVE_PSI_INTERFACE */
 
     log_info << "async IST sender starting to serve " << as->peer().c_str()
-             << " sending " << as->first() << "-" << as->last();
+             << " sending " << as->first() << "-" << as->last()
+             << (as->stripes() > 1 ? ", stripe " : "")
+             << (as->stripes() > 1 ? gu::to_string(as->stripe()) + '/' +
+                 gu::to_string(as->stripes()) : "");
     wsrep_seqno_t join_seqno;
     try
     {
@@ -897,15 +1290,82 @@ void galera::ist::AsyncSenderMap::run(const gu::Config&  conf,
                                       wsrep_seqno_t      last,
                                       int                version)
 {
+    int stripes(1);
+
+    try
+    {
+        stripes = gu::from_string<int>(
+            gu::URI(peer).get_option(Sender::STRIPES_OPT, "1"));
+    }
+    catch (gu::NotFound&)
+    {
+        log_warn << "Invalid IST stripes option in '" << peer
+                 << "', using 1 stripe";
+    }
+
+    stripes = std::max(1, std::min(stripes, MAX_STRIPES));
+    if (last - first + 1 < stripes) stripes = last - first + 1;
+
     gu::Critical crit(monitor_);
-    AsyncSender* as(new AsyncSender(conf, peer, first, last, *this, version));
-    int err(gu_thread_create(&as->thread_, 0, &run_async_sender, as));
-    if (err != 0)
+
+    if (senders_.empty())
     {
-        delete as;
-        gu_throw_error(err) << "failed to start sender thread";
+        // settings could have been changed only through param_set() which
+        // updates both the limiter and conf
+        limiter_.rate(conf.get(CONF_SEND_RATE, CONF_SEND_RATE_DEFAULT));
+        limiter_.adaptive(conf.get(CONF_SEND_ADAPTIVE,
+                                   CONF_SEND_ADAPTIVE_DEFAULT));
+        limiter_.low_priority(low_priority(
+                                  conf.get(CONF_SEND_PRIORITY,
+                                           CONF_SEND_PRIORITY_DEFAULT)));
+    }
+    std::vector<AsyncSender*> started;
+
+    try
+    {
+        for (int i(0); i < stripes; ++i)
+        {
+            // every stripe holds its own history lock, released in ~Sender(),
+            // the request itself was counted by the donor's lock
+            try
+            {
+                gcache_.seqno_lock(first + i, false);
+            }
+            catch (gu::NotFound&)
+            {
+                gu_throw_error(ENODATA) << "IST seqno " << first + i
+                                        << " not found in cache";
+            }
+
+            AsyncSender* as(0);
+            try
+            {
+                as = new AsyncSender(conf, peer, first, last, *this,
+                                     version, i, stripes);
+            }
+            catch (...)
+            {
+                gcache_.seqno_unlock();
+                throw;
+            }
+
+            int err(gu_thread_create(&as->thread_, 0, &run_async_sender, as));
+            if (err != 0)
+            {
+                delete as;
+                gu_throw_error(err) << "failed to start sender thread";
+            }
+            senders_.insert(as);
+            started.push_back(as);
+        }
+    }
+    catch (gu::Exception&)
+    {
+        // receiver can't complete without the remaining stripes,
+        // make already started ones fail
+        for (size_t i(0); i < started.size(); ++i) started[i]->cancel();
+        throw;
     }
-    senders_.insert(as);
 }
 
 
@@ -940,3 +1400,54 @@ void galera::ist::AsyncSenderMap::cancel()
     }
 
 }
+
+
+int galera::ist::AsyncSenderMap::progress(ProgressMeter::Status& st)
+{
+    st = ProgressMeter::Status();
+
+    gu::Critical crit(monitor_);
+
+    for (std::set<AsyncSender*>::const_iterator i(senders_.begin());
+         i != senders_.end(); ++i)
+    {
+        ProgressMeter::Status s;
+        (*i)->progress().status(s);
+
+        bool const first(i == senders_.begin());
+
+        st.first       = first ? s.first   : std::min(st.first,   s.first);
+        st.last        = first ? s.last    : std::max(st.last,    s.last);
+        st.current     = first ? s.current : std::min(st.current, s.current);
+        st.write_sets += s.write_sets;
+        st.bytes      += s.bytes;
+        st.rate       += s.rate;
+        st.rate_avg   += s.rate_avg;
+        st.eta         = (first || st.eta >= 0) && s.eta >= 0 ?
+            std::max(st.eta, s.eta) : -1;
+    }
+
+    return senders_.size();
+}
+
+
+void galera::ist::AsyncSenderMap::param_set(const std::string& key,
+                                            const std::string& value)
+{
+    if (key == CONF_SEND_RATE)
+    {
+        limiter_.rate(gu::Config::from_config<long long>(value));
+    }
+    else if (key == CONF_SEND_ADAPTIVE)
+    {
+        limiter_.adaptive(gu::Config::from_config<bool>(value));
+    }
+    else if (key == CONF_SEND_PRIORITY)
+    {
+        limiter_.low_priority(low_priority(value));
+    }
+    else
+    {
+        throw gu::NotFound();
+    }
+}
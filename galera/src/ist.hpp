@@ -8,13 +8,16 @@
 
 #include "wsrep_api.h"
 #include "galera_gcs.hpp"
+#include "ist_progress.hpp"
+#include "ist_rate_limiter.hpp"
+#include "ist_compress.hpp"
 #include "trx_handle.hpp"
 #include "gu_config.hpp"
 #include "gu_lock.hpp"
 #include "gu_monitor.hpp"
 #include "gu_asio.hpp"
 
-#include <stack>
+#include <deque>
 #include <set>
 
 namespace gcache
@@ -22,12 +25,19 @@ namespace gcache
     class GCache;
 }
 
+namespace gu
+{
+    template <typename T> class Progress;
+}
+
 namespace galera
 {
     class TrxHandle;
 
     namespace ist
     {
+        class Proto;
+
         void register_params(gu::Config& conf);
 
         class Receiver
@@ -41,6 +51,10 @@ namespace galera
 
             std::string   prepare(wsrep_seqno_t, wsrep_seqno_t, int);
             void          ready();
+            /* Returns 0 with the next write set in trx, EINTR when IST is
+             * over or the error which broke the stream once all write sets
+             * received before it were handed over. Throws if the write set
+             * can't be parsed. */
             int           recv(TrxHandle** trx);
             wsrep_seqno_t finished();
             void          run();
@@ -50,10 +64,62 @@ namespace galera
             wsrep_seqno_t last_seqno()      { return last_seqno_; }
             bool          running()         { return running_; }
 
+            /* Last seqno handed over to consumers. All seqnos before it
+             * were handed over too, so once they are applied the state is
+             * consistent at that seqno even if the stream breaks. */
+            wsrep_seqno_t delivered_seqno();
+            /* Error which broke the stream, 0 if none */
+            int           error();
+
+            /* Write sets are read from the socket ahead of consumers into
+             * a queue bounded by ist.recv_queue_size bytes, so that network
+             * receive and apply overlap. Current queue occupancy: */
+            void          queue_stats(size_t& len, size_t& bytes);
+
+            /* Transfer progress of the current IST */
+            void          progress(ProgressMeter::Status& st) const
+            {
+                progress_.status(st);
+            }
+
+            const Compressor::Stats& compression_stats() const
+            {
+                return comp_stats_;
+            }
+
+            /* Donor may stripe IST over several connections, stripe i
+             * carrying seqnos first + i, first + i + count, ... Each stripe
+             * is read by its own thread and write sets are handed over to
+             * consumers in seqno order. */
+            struct Stripe
+            {
+                Stripe()
+                    : receiver(0), socket(0), ssl_stream(0), progress(0),
+                      index(0), count(1), compression(0), ec(0), thread()
+                { }
+
+                Receiver*                                 receiver;
+                asio::ip::tcp::socket*                    socket;
+                asio::ssl::stream<asio::ip::tcp::socket>* ssl_stream;
+                gu::Progress<wsrep_seqno_t>*              progress;
+                int                                       index;
+                int                                       count;
+                int                                       compression;
+                int                                       ec;
+                gu_thread_t                               thread;
+            };
+
+            void          run_stripe(Stripe& s);
+
         private:
 
             void interrupt();
 
+            void accept(Stripe& s);
+            void handshake(Proto& p, Stripe& s);
+            template <class ST>
+            void recv_stripe(ST& stream, Stripe& s);
+
             std::string                                   recv_addr_;
             std::string                                   recv_bind_;
             asio::io_service                              io_service_;
@@ -62,50 +128,19 @@ namespace galera
 #ifdef HAVE_PSI_INTERFACE
             gu::MutexWithPFS                              mutex_;
             gu::CondWithPFS                               cond_;
+            gu::CondWithPFS                               recv_cond_;
 #else
             gu::Mutex                                     mutex_;
             gu::Cond                                      cond_;
+            gu::Cond                                      recv_cond_;
 #endif /* HAVE_PSI_INTERFACE */
 
-            class Consumer
-            {
-            public:
-
-#ifdef HAVE_PSI_INTERFACE
-                Consumer()
-                    :
-                    cond_(WSREP_PFS_INSTR_TAG_IST_CONSUMER_CONDVAR),
-                    trx_(0)
-                { }
-#else
-                Consumer() : cond_(), trx_(0) { }
-#endif
-                ~Consumer() { }
-
-#ifdef HAVE_PSI_INTERFACE
-                gu::CondWithPFS&  cond()        { return cond_; }
-#else
-                gu::Cond&  cond()              { return cond_; }
-#endif /* HAVE_PSI_INTERFACE */
-                void       trx(TrxHandle* trx) { trx_ = trx;   }
-                TrxHandle* trx() const         { return trx_;  }
-
-            private:
-
-                // Non-copyable
-                Consumer(const Consumer&);
-                Consumer& operator=(const Consumer&);
-
-#ifdef HAVE_PSI_INTERFACE
-                gu::CondWithPFS   cond_;
-#else
-                gu::Cond   cond_;
-#endif /* HAVE_PSI_INTERFACE */
-                TrxHandle* trx_;
-            };
-
-            std::stack<Consumer*> consumers_;
-            wsrep_seqno_t         current_seqno_;
+            ProgressMeter         progress_;
+            Compressor::Stats     comp_stats_; // decompression
+            std::deque<TrxHandle*> queue_;   // received, not yet consumed
+            size_t                queue_bytes_;
+            size_t                queue_max_bytes_;
+            wsrep_seqno_t         current_seqno_; // next to be delivered
             wsrep_seqno_t         first_seqno_;
             wsrep_seqno_t         last_seqno_;
             gu::Config&           conf_;
@@ -113,10 +148,12 @@ namespace galera
             gu_thread_t           thread_;
             int                   error_code_;
             int                   version_;
+            int                   eofs_;   // number of stripes finished
             bool                  use_ssl_;
             bool                  running_;
             bool                  interrupted_;
             bool                  ready_;
+            bool                  failed_; // one of the stripes failed
 
             // GCC 4.8.5 on FreeBSD wants this
             Receiver(const Receiver&);
@@ -127,14 +164,25 @@ namespace galera
         {
         public:
 
+            static std::string const STRIPES_OPT; // peer URI option
+
             Sender(const gu::Config& conf,
                    gcache::GCache& gcache,
                    const std::string& peer,
-                   int version);
+                   int version,
+                   int stripe  = 0,
+                   int stripes = 1,
+                   RateLimiter* limiter = 0,
+                   Compressor::Stats* comp_stats = 0);
             virtual ~Sender();
 
             void send(wsrep_seqno_t first, wsrep_seqno_t last);
 
+            int stripe()  const { return stripe_;  }
+            int stripes() const { return stripes_; }
+
+            const ProgressMeter& progress() const { return progress_; }
+
             void cancel()
             {
                 if (use_ssl_ == true)
@@ -156,7 +204,13 @@ namespace galera
             const gu::Config&                         conf_;
             gcache::GCache&                           gcache_;
             int                                       version_;
+            int                                       stripe_;
+            int                                       stripes_;
             bool                                      use_ssl_;
+            RateLimiter*                              limiter_;
+            Compressor::Stats*                        comp_stats_;
+            RateLimiter::ThreadPriority               priority_;
+            ProgressMeter                             progress_;
 
             Sender(const Sender&);
             void operator=(const Sender&);
@@ -176,7 +230,9 @@ namespace galera
 #else
                 monitor_(),
 #endif /* HAVE_PSI_INTERFACE */
-                gcache_(gcache) { }
+                gcache_(gcache),
+                limiter_(&gcs),
+                comp_stats_() { }
             void run(const gu::Config& conf,
                      const std::string& peer,
                      wsrep_seqno_t,
@@ -185,11 +241,25 @@ namespace galera
             void remove(AsyncSender*, wsrep_seqno_t);
             void cancel();
             gcache::GCache& gcache() { return gcache_; }
+            RateLimiter&    limiter() { return limiter_; }
+            Compressor::Stats& compression_stats() { return comp_stats_; }
+
+            /* Aggregate progress of all running senders (stripes are
+             * counted separately), returns the number of senders.
+             * current is the lowest seqno any of them has reached and
+             * eta is the longest estimate. */
+            int  progress(ProgressMeter::Status& st);
+
+            /* Applies runtime changes of sender throttling parameters,
+             * throws gu::NotFound for other keys. */
+            void param_set(const std::string& key, const std::string& value);
         private:
             std::set<AsyncSender*> senders_;
             // use monitor instead of mutex, it provides cancellation point
             gu::Monitor            monitor_;
             gcache::GCache&        gcache_;
+            RateLimiter            limiter_;
+            Compressor::Stats      comp_stats_; // of all senders
         };
 
 
@@ -0,0 +1,240 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#include "ist_compress.hpp"
+
+#include "gu_lock.hpp"
+#include "gu_throw.hpp"
+#include "gu_logger.hpp"
+#include "gu_time.h"
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <cstring>
+
+
+int galera::ist::Compressor::supported()
+{
+#ifdef HAVE_ZLIB_H
+    return A_ZLIB;
+#else
+    return A_NONE;
+#endif
+}
+
+
+galera::ist::Compressor::Compressor(Stats* const stats)
+    :
+    stats_      (stats),
+    mutex_      (),
+    cond_       (),
+    queue_      (),
+    thd_        (),
+    thd_running_(false),
+    exit_       (false)
+{ }
+
+
+galera::ist::Compressor::~Compressor()
+{
+    if (thd_running_)
+    {
+        {
+            gu::Lock lock(mutex_);
+            exit_ = true;
+            cond_.broadcast();
+        }
+
+        gu_thread_join(thd_, NULL);
+    }
+}
+
+
+void* galera::ist::Compressor::run_thread(void* arg)
+{
+    static_cast<Compressor*>(arg)->run();
+    return 0;
+}
+
+
+void galera::ist::Compressor::run()
+{
+    for (;;)
+    {
+        Job* job;
+
+        {
+            gu::Lock lock(mutex_);
+
+            while (queue_.empty() && !exit_) lock.wait(cond_);
+
+            if (queue_.empty()) break;
+
+            job = queue_.front();
+        }
+
+        compress(*job, stats_);
+
+        gu::Lock lock(mutex_);
+        queue_.pop_front();
+        job->done = true;
+        cond_.broadcast();
+    }
+}
+
+
+void galera::ist::Compressor::start(Job& job)
+{
+    assert(job.done);
+
+    job.err  = 0;
+    job.done = false;
+
+    if (!thd_running_)
+    {
+        int const err(gu_thread_create(&thd_, NULL, run_thread, this));
+
+        if (gu_unlikely(err != 0))
+        {
+            log_warn << "Starting IST compression thread failed: " << err
+                     << '(' << ::strerror(err) << ')';
+
+            /* compress in foreground */
+            compress(job, stats_);
+            job.done = true;
+            return;
+        }
+
+        thd_running_ = true;
+    }
+
+    gu::Lock lock(mutex_);
+    queue_.push_back(&job);
+    cond_.broadcast();
+}
+
+
+size_t galera::ist::Compressor::wait(Job& job)
+{
+    {
+        gu::Lock lock(mutex_);
+        while (!job.done) lock.wait(cond_);
+    }
+
+    if (gu_unlikely(job.err != 0))
+    {
+        gu_throw_error(job.err) << "IST batch compression failed";
+    }
+
+    return job.out_size;
+}
+
+
+void galera::ist::Compressor::drain()
+{
+    gu::Lock lock(mutex_);
+    while (!queue_.empty()) lock.wait(cond_);
+}
+
+
+#ifdef HAVE_ZLIB_H
+
+void galera::ist::Compressor::compress(Job& job, Stats* const stats)
+{
+    long long const start(gu_time_monotonic());
+
+    z_stream strm;
+    ::memset(&strm, 0, sizeof(strm));
+
+    if (deflateInit(&strm, Z_BEST_SPEED) != Z_OK)
+    {
+        job.err = ENOMEM;
+        return;
+    }
+
+    job.out.resize(job.offset + deflateBound(&strm, job.in_size));
+
+    strm.next_out  = &job.out[job.offset];
+    strm.avail_out = job.out.size() - job.offset;
+
+    int ret(Z_OK);
+
+    for (size_t i(0); i < job.in.size() && Z_OK == ret; ++i)
+    {
+        strm.next_in  = static_cast<Bytef*>(const_cast<void*>(job.in[i].ptr));
+        strm.avail_in = job.in[i].size;
+
+        ret = deflate(&strm, i + 1 < job.in.size() ? Z_NO_FLUSH : Z_FINISH);
+    }
+
+    if (job.in.empty()) ret = deflate(&strm, Z_FINISH);
+
+    job.out_size = strm.total_out;
+    deflateEnd(&strm);
+
+    if (Z_STREAM_END != ret)
+    {
+        job.err = EPROTO;
+        return;
+    }
+
+    if (stats)
+        stats->record(job.in_size, job.out_size, gu_time_monotonic() - start);
+}
+
+
+void galera::ist::Compressor::decompress(const gu::byte_t* const in,
+                                         size_t            const in_size,
+                                         gu::byte_t*       const out,
+                                         size_t            const out_size,
+                                         Stats*            const stats)
+{
+    long long const start(gu_time_monotonic());
+
+    z_stream strm;
+    ::memset(&strm, 0, sizeof(strm));
+
+    if (inflateInit(&strm) != Z_OK)
+    {
+        gu_throw_error(ENOMEM) << "failed to initialize IST decompression";
+    }
+
+    strm.next_in   = const_cast<Bytef*>(in);
+    strm.avail_in  = in_size;
+    strm.next_out  = out;
+    strm.avail_out = out_size;
+
+    int const ret(inflate(&strm, Z_FINISH));
+    size_t const total(strm.total_out);
+
+    inflateEnd(&strm);
+
+    if (Z_STREAM_END != ret || total != out_size || strm.avail_in != 0)
+    {
+        gu_throw_error(EPROTO) << "corrupt compressed IST batch: " << ret
+                               << ", " << total << " out of " << out_size
+                               << " bytes";
+    }
+
+    if (stats) stats->record(out_size, in_size, gu_time_monotonic() - start);
+}
+
+#else  /* HAVE_ZLIB_H */
+
+void galera::ist::Compressor::compress(Job& job, Stats*)
+{
+    job.err = ENOTSUP;
+}
+
+
+void galera::ist::Compressor::decompress(const gu::byte_t*, size_t,
+                                         gu::byte_t*, size_t, Stats*)
+{
+    gu_throw_error(ENOTSUP) << "IST compression is not supported";
+}
+
+#endif /* HAVE_ZLIB_H */
+
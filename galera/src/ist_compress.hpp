@@ -0,0 +1,122 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#ifndef GALERA_IST_COMPRESS_HPP
+#define GALERA_IST_COMPRESS_HPP
+
+#include "gu_buf.hpp"
+#include "gu_buffer.hpp"
+#include "gu_atomic.hpp"
+#include "gu_lock.hpp"
+#include "gu_threads.h"
+
+#include <deque>
+#include <vector>
+
+namespace galera
+{
+    namespace ist
+    {
+        /*
+         * Compression of IST batches. A batch of serialized trx messages
+         * is compressed as a whole into a single frame which is then
+         * decompressed by the receiver into exactly the same byte stream.
+         *
+         * Compression is optional and is used only if the receiver asked
+         * for it in the handshake and the sender agreed in the handshake
+         * response, so algorithms are never used by just one side.
+         *
+         * Batches are compressed in order by a worker thread which is
+         * started with the first batch and lives as long as the
+         * Compressor, so that the sender can write one batch while the
+         * next is being compressed.
+         */
+        class Compressor
+        {
+        public:
+
+            enum Algorithm
+            {
+                A_NONE = 0,
+                A_ZLIB = 1
+            };
+
+            /* Bitmask of algorithms available in this build */
+            static int supported();
+
+            /* Uncompressed and compressed bytes passed through
+             * (de)compression and time spent on it. */
+            struct Stats
+            {
+                Stats() : raw(0), compressed(0), nsec(0) { }
+
+                void record(size_t r, size_t c, long long n)
+                {
+                    raw += r; compressed += c; nsec += n;
+                }
+
+                gu::Atomic<long long> raw;
+                gu::Atomic<long long> compressed;
+                gu::Atomic<long long> nsec;
+            };
+
+            /* A batch to compress: concatenation of in buffers (in_size
+             * bytes total) goes to out after the first offset bytes, which
+             * are left for the frame header. */
+            struct Job
+            {
+                Job() : in(), in_size(0), offset(0), out(), out_size(0),
+                        err(0), done(true) { }
+
+                std::vector<gu::Buf> in;
+                size_t               in_size;
+                size_t               offset;
+                gu::Buffer           out;
+                size_t               out_size;
+                int                  err;
+                bool                 done;
+            };
+
+            explicit Compressor(Stats* stats = 0);
+            ~Compressor();
+
+            /* Queues the job for compression, job and its in buffers must
+             * stay valid until wait() returns. Compresses in foreground if
+             * the worker thread can't be started. */
+            void start(Job& job);
+
+            /* Waits for the job to finish, throws on error.
+             * Returns the size of compressed data after the offset. */
+            size_t wait(Job& job);
+
+            /* Waits for all queued jobs to finish, errors are ignored. */
+            void drain();
+
+            /* Decompresses in to exactly out_size bytes at out,
+             * throws EPROTO if the data is corrupt or of different size. */
+            static void decompress(const gu::byte_t* in,  size_t in_size,
+                                   gu::byte_t*       out, size_t out_size,
+                                   Stats* stats = 0);
+
+        private:
+
+            static void* run_thread(void* arg);
+            void run();
+            static void compress(Job& job, Stats* stats);
+
+            Stats*            stats_;
+            gu::Mutex         mutex_;
+            gu::Cond          cond_;
+            std::deque<Job*>  queue_;
+            gu_thread_t       thd_;
+            bool              thd_running_;
+            bool              exit_;
+
+            Compressor(const Compressor&);
+            Compressor& operator=(const Compressor&);
+        };
+    }
+}
+
+#endif // GALERA_IST_COMPRESS_HPP
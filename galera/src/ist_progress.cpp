@@ -0,0 +1,118 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#include "ist_progress.hpp"
+
+#include "gu_lock.hpp"
+#include "gu_logger.hpp"
+#include "gu_time.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace
+{
+    static long long const NSEC_PER_SEC  = 1000000000LL;
+    static long long const RATE_INTERVAL = NSEC_PER_SEC;
+}
+
+
+galera::ist::ProgressMeter::ProgressMeter()
+    :
+    mutex_       (),
+    rates_       (),
+    st_          (),
+    stride_      (1),
+    start_       (gu_time_monotonic()),
+    window_start_(start_),
+    window_bytes_(0)
+{ }
+
+
+void galera::ist::ProgressMeter::start(wsrep_seqno_t const first,
+                                       wsrep_seqno_t const last,
+                                       int           const stride)
+{
+    gu::Lock lock(mutex_);
+
+    st_           = Status();
+    st_.first     = first;
+    st_.last      = last;
+    st_.current   = first - 1;
+    stride_       = std::max(stride, 1);
+    start_        = gu_time_monotonic();
+    window_start_ = start_;
+    window_bytes_ = 0;
+    rates_.clear();
+}
+
+
+void galera::ist::ProgressMeter::update(wsrep_seqno_t const seqno,
+                                        size_t        const bytes,
+                                        long          const write_sets)
+{
+    gu::Lock lock(mutex_);
+
+    st_.current     = std::max(st_.current, seqno);
+    st_.write_sets += write_sets;
+    st_.bytes      += bytes;
+    window_bytes_  += bytes;
+
+    long long const now(gu_time_monotonic());
+    long long const elapsed(now - window_start_);
+
+    if (elapsed >= RATE_INTERVAL)
+    {
+        st_.rate = double(window_bytes_) * NSEC_PER_SEC / elapsed;
+        rates_.insert(st_.rate);
+        window_start_ = now;
+        window_bytes_ = 0;
+    }
+}
+
+
+void galera::ist::ProgressMeter::finish(const char* const prefix)
+{
+    Status st;
+    status(st);
+
+    gu::Lock lock(mutex_);
+
+    log_info << prefix << ' ' << st.write_sets << " write sets, "
+             << st.bytes << " bytes of " << st.first << '-' << st.last
+             << " at " << std::fixed << std::setprecision(0) << st.rate_avg
+             << " B/s"
+             << (rates_.times() > 1 ? ", rate min/avg/max/dev/samples: " : "")
+             << (rates_.times() > 1 ? rates_.to_string() : "");
+}
+
+
+void galera::ist::ProgressMeter::status(Status& st) const
+{
+    gu::Lock lock(mutex_);
+
+    st = st_;
+
+    long long const now(gu_time_monotonic());
+    long long const elapsed(now - start_);
+
+    if (elapsed > 0)
+    {
+        st.rate_avg = double(st_.bytes) * NSEC_PER_SEC / elapsed;
+    }
+
+    // a stalled transfer doesn't call update(), make it show
+    if (now - window_start_ >= 2 * RATE_INTERVAL)
+    {
+        st.rate = double(window_bytes_) * NSEC_PER_SEC / (now - window_start_);
+    }
+
+    if (st_.write_sets > 0 && elapsed > 0)
+    {
+        double const remaining(double(st_.last - st_.current) / stride_);
+
+        st.eta = static_cast<long long>(
+            remaining * elapsed / st_.write_sets / NSEC_PER_SEC + 0.5);
+    }
+}
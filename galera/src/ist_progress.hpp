@@ -0,0 +1,82 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#ifndef GALERA_IST_PROGRESS_HPP
+#define GALERA_IST_PROGRESS_HPP
+
+#include "wsrep_api.h"
+
+#include "gu_mutex.hpp"
+#include "gu_stats.hpp"
+
+#include <cstddef>
+
+namespace galera
+{
+    namespace ist
+    {
+        /*
+         * Thread safe IST transfer progress accounting for status variables.
+         *
+         * Instantaneous rate is measured over intervals of at least one
+         * second, every measurement is also recorded in gu::Stats so that
+         * rate variation can be reported at the end of transfer. Estimated
+         * time of completion is based on the average write set rate.
+         */
+        class ProgressMeter
+        {
+        public:
+
+            struct Status
+            {
+                Status()
+                    : first(0), last(0), current(0), write_sets(0), bytes(0),
+                      rate(0), rate_avg(0), eta(-1)
+                { }
+
+                wsrep_seqno_t first;
+                wsrep_seqno_t last;
+                wsrep_seqno_t current;    // last seqno transferred
+                long long     write_sets;
+                long long     bytes;
+                double        rate;       // bytes per second
+                double        rate_avg;
+                long long     eta;        // seconds, -1 if unknown
+            };
+
+            ProgressMeter();
+
+            /* Starts accounting of a transfer of seqnos first - last,
+             * stride is the distance between seqnos transferred through this
+             * meter (number of IST stripes) */
+            void start(wsrep_seqno_t first, wsrep_seqno_t last,
+                       int stride = 1);
+
+            /* Accounts for write_sets write sets of bytes total size,
+             * seqno is the last of them */
+            void update(wsrep_seqno_t seqno, size_t bytes,
+                        long write_sets = 1);
+
+            /* Logs transfer summary, prefix names the transfer */
+            void finish(const char* prefix);
+
+            void status(Status& st) const;
+
+        private:
+
+            gu::Mutex     mutex_;
+            gu::Stats     rates_;
+            Status        st_;
+            int           stride_;
+            long long     start_;
+            long long     window_start_;
+            long long     window_bytes_;
+
+            ProgressMeter(const ProgressMeter&);
+            ProgressMeter& operator=(const ProgressMeter&);
+        };
+    }
+}
+
+#endif // GALERA_IST_PROGRESS_HPP
@@ -6,6 +6,7 @@
 #define GALERA_IST_PROTO_HPP
 
 #include "trx_handle.hpp"
+#include "ist_compress.hpp"
 
 #include "GCache.hpp"
 
@@ -14,6 +15,16 @@
 #include "gu_vector.hpp"
 #include "gu_array.hpp"
 
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <poll.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
 //
 // Message class must have non-virtual destructor until
 // support up to version 3 is removed as serialization/deserialization
@@ -59,7 +70,8 @@ namespace galera
                 T_HANDSHAKE = 1,
                 T_HANDSHAKE_RESPONSE = 2,
                 T_CTRL = 3,
-                T_TRX = 4
+                T_TRX = 4,
+                T_COMPRESSED = 5
             } Type;
 
             Message(int       version = -1,
@@ -192,21 +204,29 @@ namespace galera
             uint64_t len_;
         };
 
+        /* Flags field carries the mask of compression algorithms
+         * the receiver is willing to accept, 0 if none */
         class Handshake : public Message
         {
         public:
-            Handshake(int version = -1)
+            Handshake(int version = -1, uint8_t compression = 0)
                 :
-                Message(version, Message::T_HANDSHAKE, 0, 0, 0)
+                Message(version, Message::T_HANDSHAKE, compression, 0, 0)
             { }
         };
 
+        /* When IST is striped over several connections, flags field carries
+         * the number of stripes and ctrl field the stripe index, otherwise
+         * both are 0. Len field carries the compression algorithm chosen
+         * by the sender, 0 if the stream is not compressed. */
         class HandshakeResponse : public Message
         {
         public:
-            HandshakeResponse(int version = -1)
+            HandshakeResponse(int version = -1, uint8_t stripes = 0,
+                              int8_t stripe = 0, uint64_t compression = 0)
                 :
-                Message(version, Message::T_HANDSHAKE_RESPONSE, 0, 0, 0)
+                Message(version, Message::T_HANDSHAKE_RESPONSE,
+                        stripes, stripe, compression)
             { }
         };
 
@@ -235,17 +255,44 @@ namespace galera
         };
 
 
+        /*
+         * If compression is negotiated in the handshake, the sender
+         * compresses each batch of trx messages into a single
+         * T_COMPRESSED message:
+         *
+         *   header (len = 8 + compressed size, flags = algorithm)
+         *   uncompressed size (8 bytes)
+         *   compressed trx messages
+         *
+         * Control messages and trxs that are too big to be batched are
+         * never compressed.
+         */
         class Proto
         {
         public:
 
-            Proto(TrxHandle::SlavePool& sp, int version, bool keep_keys)
+            /* compression is the mask of algorithms to request (receiver)
+             * or to agree to (sender), (de)compression is accounted in
+             * stats */
+            Proto(TrxHandle::SlavePool& sp, int version, bool keep_keys,
+                  int compression = Compressor::A_NONE,
+                  Compressor::Stats* stats = 0)
                 :
-                trx_pool_ (sp),
-                raw_sent_ (0),
-                real_sent_(0),
-                version_  (version),
-                keep_keys_(keep_keys)
+                trx_pool_    (sp),
+                raw_sent_    (0),
+                real_sent_   (0),
+                file_sent_   (0),
+                version_     (version),
+                keep_keys_   (keep_keys),
+                compression_ (compression & Compressor::supported()),
+                compress_    (Compressor::A_NONE),
+                stats_       (stats),
+                jobs_        (),
+                compressor_  (stats),
+                compressed_  (),
+                inflated_    (),
+                inflated_off_(0),
+                sendfile_    (true)
             { }
 
             ~Proto()
@@ -258,14 +305,20 @@ namespace galera
                              << real_sent_
                              << " frac: "
                              << (raw_sent_ == 0 ? 0. :
-                                 static_cast<double>(real_sent_)/raw_sent_);
+                                 static_cast<double>(real_sent_)/raw_sent_)
+                             << " sent from file: "
+                             << file_sent_;
                 }
             }
 
+            /* Compression algorithm negotiated in the handshake */
+            int  compression() const    { return compress_; }
+            void compression(int const c) { compress_ = c;  }
+
             template <class ST>
             void send_handshake(ST& socket)
             {
-                Handshake  hs(version_);
+                Handshake  hs(version_, compression_);
                 gu::Buffer buf(hs.serial_size());
                 size_t offset(hs.serialize(&buf[0], buf.size(), 0));
                 size_t n(asio::write(socket, asio::buffer(&buf[0],
@@ -319,12 +372,18 @@ namespace galera
                                            << version_;
                 }
                 // TODO: Figure out protocol versions to use
+
+                // pick the first algorithm supported by both sides
+                int const common(msg.flags() & compression_);
+                compress_ = common & -common;
             }
 
             template <class ST>
-            void send_handshake_response(ST& socket)
+            void send_handshake_response(ST& socket, int stripes = 1,
+                                         int stripe = 0)
             {
-                HandshakeResponse hsr(version_);
+                HandshakeResponse hsr(version_, stripes > 1 ? stripes : 0,
+                                      stripe, compress_);
                 gu::Buffer buf(hsr.serial_size());
                 size_t offset(hsr.serialize(&buf[0], buf.size(), 0));
                 size_t n(asio::write(socket, asio::buffer(&buf[0], buf.size())));
@@ -336,7 +395,7 @@ namespace galera
             }
 
             template <class ST>
-            void recv_handshake_response(ST& socket)
+            Message recv_handshake_response(ST& socket)
             {
                 Message    msg(version_);
                 gu::Buffer buf(msg.serial_size());
@@ -356,7 +415,14 @@ namespace galera
                 switch (msg.type())
                 {
                 case Message::T_HANDSHAKE_RESPONSE:
-                    break;
+                    if (msg.len() & ~uint64_t(compression_))
+                    {
+                        gu_throw_error(EPROTO)
+                            << "unexpected compression algorithm: "
+                            << msg.len();
+                    }
+                    compress_ = msg.len();
+                    return msg;
                 case Message::T_CTRL:
                     switch (msg.ctrl())
                     {
@@ -370,6 +436,9 @@ namespace galera
                     gu_throw_error(EINVAL) << "unexpected message type: "
                                            << msg.type();
                 }
+
+                gu_throw_fatal; throw;
+                return msg; // keep compiler happy
             }
 
             template <class ST>
@@ -418,67 +487,142 @@ namespace galera
             void send_trx(ST&                           socket,
                           const gcache::GCache::Buffer& buffer)
             {
-                const bool rolled_back(buffer.seqno_d() == -1);
-
-                galera::WriteSetIn ws;
-                gu::array<asio::const_buffer, 3>::type cbs;
-                size_t      payload_size; /* size of the 2nd cbs buffer */
-                size_t      sent;
+                send_trx(socket, &buffer, 1);
+            }
 
-                if (gu_unlikely(rolled_back))
+            /* Sends n write sets from consecutive gcache buffers, coalescing
+             * as many of them as possible into a single scatter/gather
+             * write. Wire format is the same as of individual send_trx()
+             * calls. */
+            template <class ST>
+            void send_trx(ST&                                 socket,
+                          const gcache::GCache::Buffer* const buffers,
+                          size_t const                        n)
+            {
+                if (compress_ != Compressor::A_NONE)
                 {
-                    payload_size = 0;
+                    send_compressed(socket, buffers, n);
+                    return;
                 }
-                else
+
+                std::vector<asio::const_buffer> cbs;
+                cbs.reserve(3 * std::min(n, size_t(max_batch_trxs)));
+
+                size_t i(0);
+
+                while (i < n)
                 {
-                    if (keep_keys_ || version_ < WS_NG_VERSION)
-                    {
-                        payload_size = buffer.size();
-                        const void* const ptr(buffer.ptr());
-                        cbs[1] = asio::const_buffer(ptr, payload_size);
-                        cbs[2] = asio::const_buffer(ptr, 0);
-                    }
-                    else
-                    {
-                        gu::Buf tmp = { buffer.ptr(), buffer.size() };
-                        ws.read_buf (tmp, 0);
+                    /* headers must stay in place until written */
+                    std::vector<gu::Buffer> hdrs;
+                    size_t batch_bytes(0);
+                    size_t const j(prepare_batch(buffers + i, n - i, hdrs,
+                                                 cbs, batch_bytes));
 
-                        WriteSetIn::GatherVector out;
-                        payload_size = ws.gather (out, false, false);
-                        assert (2 == out->size());
-                        cbs[1] = asio::const_buffer(out[0].ptr, out[0].size);
-                        cbs[2] = asio::const_buffer(out[1].ptr, out[1].size);
-                    }
-                }
+                    size_t const sent(asio::write(socket, cbs));
 
-                size_t const trx_meta_size(
-                    8 /* serial_size(buffer.seqno_g()) */ +
-                    8 /* serial_size(buffer.seqno_d()) */
-                    );
+                    if (sent != batch_bytes)
+                    {
+                        gu_throw_error(EPROTO) << "error sending trx batch: "
+                                               << sent << " out of "
+                                               << batch_bytes << " bytes";
+                    }
 
-                Trx trx_msg(version_, trx_meta_size + payload_size);
+                    log_debug << "sent " << j << " trxs, " << sent << " bytes";
 
-                gu::Buffer buf(trx_msg.serial_size() + trx_meta_size);
-                size_t  offset(trx_msg.serialize(&buf[0], buf.size(), 0));
+                    raw_sent_  += sent;
+                    real_sent_ += sent;
 
-                offset = gu::serialize8(buffer.seqno_g(),
-                                        &buf[0], buf.size(), offset);
-                offset = gu::serialize8(buffer.seqno_d(),
-                                        &buf[0], buf.size(), offset);
-                cbs[0] = asio::const_buffer(&buf[0], buf.size());
+                    i += j;
+                    cbs.clear();
+                }
+            }
 
-                if (gu_likely(payload_size))
+            /* Same as send_trx() above, but write set data which resides in
+             * gcache files is sent with sendfile() straight from the page
+             * cache instead of being copied through user space. Only plain
+             * TCP sockets can do that, SSL streams must use the generic
+             * send_trx(). Falls back to copying if compression is negotiated
+             * or if the file does not support sendfile(). */
+            void send_trx(asio::ip::tcp::socket&              socket,
+                          const gcache::GCache&               gcache,
+                          const gcache::GCache::Buffer* const buffers,
+                          size_t const                        n)
+            {
+                if (compress_ != Compressor::A_NONE || !sendfile_)
                 {
-                    sent = asio::write(socket, cbs);
+                    send_trx(socket, buffers, n);
+                    return;
                 }
-                else
+
+                std::vector<asio::const_buffer> cbs;
+                std::vector<asio::const_buffer> mem; // to write from memory
+
+                size_t i(0);
+
+                while (i < n)
                 {
-                    sent = asio::write(socket, asio::buffer(cbs[0]));
-                }
+                    std::vector<gu::Buffer> hdrs;
+                    size_t batch_bytes(0);
+                    size_t const j(prepare_batch(buffers + i, n - i, hdrs,
+                                                 cbs, batch_bytes));
+
+                    size_t k(0);              // next trx in the batch
+                    const gu::byte_t* begin(0);
+                    const gu::byte_t* end(0); // current gcache buffer
+                    int   fd(-1);
+                    off_t base(0);
+
+                    for (size_t c(0); c < cbs.size(); ++c)
+                    {
+                        const gu::byte_t* const ptr(
+                            asio::buffer_cast<const gu::byte_t*>(cbs[c]));
+                        size_t const size(asio::buffer_size(cbs[c]));
 
-                log_debug << "sent " << sent << " bytes";
-            }
+                        if (k < j && ptr == &hdrs[k][0])
+                        {
+                            // trx header, buffers that follow are its payload
+                            const gcache::GCache::Buffer& b(buffers[i + k]);
+                            begin = b.ptr();
+                            end   = begin + b.size();
+                            if (!gcache.seqno_file_location(begin, fd, base))
+                            {
+                                fd = -1;
+                            }
+                            ++k;
+                        }
+                        else if (fd >= 0 && size >= min_sendfile_size &&
+                                 ptr >= begin && ptr + size <= end)
+                        {
+                            write_all(socket, mem);
+
+                            if (send_file(socket.native_handle(), fd,
+                                          base + (ptr - begin), size))
+                            {
+                                file_sent_ += size;
+                                continue;
+                            }
+
+                            log_info << "sendfile() is not supported, "
+                                     << "IST will be sent from memory";
+                            sendfile_ = false;
+                            fd = -1;
+                        }
 
+                        mem.push_back(cbs[c]);
+                    }
+
+                    write_all(socket, mem);
+
+                    log_debug << "sent " << j << " trxs, " << batch_bytes
+                              << " bytes";
+
+                    raw_sent_  += batch_bytes;
+                    real_sent_ += batch_bytes;
+
+                    i += j;
+                    cbs.clear();
+                }
+            }
 
             template <class ST>
             galera::TrxHandle*
@@ -486,20 +630,30 @@ namespace galera
             {
                 Message    msg(version_);
                 gu::Buffer buf(msg.serial_size());
-                size_t n(asio::read(socket, asio::buffer(&buf[0], buf.size())));
+                bool const batched(inflated_off_ < inflated_.size());
 
-                if (n != buf.size())
-                {
-                    gu_throw_error(EPROTO) << "error receiving trx header";
-                }
+                recv_bytes(socket, &buf[0], buf.size(),
+                           "error receiving trx header");
 
                 (void)msg.unserialize(&buf[0], buf.size(), 0);
 
-                log_debug << "received header: " << n << " bytes, type "
-                          << msg.type() << " len " << msg.len();
+                log_debug << "received header: " << buf.size()
+                          << " bytes, type " << msg.type()
+                          << " len " << msg.len();
 
                 switch (msg.type())
                 {
+                case Message::T_COMPRESSED:
+                    if (batched || compress_ == Compressor::A_NONE ||
+                        msg.flags() != compress_)
+                    {
+                        gu_throw_error(EPROTO)
+                            << "unexpected compressed message, algorithm "
+                            << int(msg.flags()) << ", negotiated "
+                            << compress_;
+                    }
+                    recv_compressed(socket, msg);
+                    return recv_trx(socket); // next header is in the batch
                 case Message::T_TRX:
                 {
                     // TODO: ideally we want to make seqno_g and cert verdict
@@ -510,11 +664,8 @@ namespace galera
 
                     buf.resize(sizeof(seqno_g) + sizeof(seqno_d));
 
-                    n = asio::read(socket, asio::buffer(&buf[0], buf.size()));
-                    if (n != buf.size())
-                    {
-                        gu_throw_error(EPROTO) << "error reading trx meta data";
-                    }
+                    recv_bytes(socket, &buf[0], buf.size(),
+                               "error reading trx meta data");
 
                     size_t offset(gu::unserialize8(&buf[0], buf.size(), 0,
                                                    seqno_g));
@@ -538,33 +689,15 @@ namespace galera
                         size_t const wsize(msg.len() - offset);
                         wbuf.resize(wsize);
 
-                        n = asio::read(socket,
-                                       asio::buffer(&wbuf[0], wbuf.size()));
-
-                        if (gu_unlikely(n != wbuf.size()))
-                        {
-                            gu_throw_error(EPROTO)
-                                << "error reading write set data";
-                        }
-
-                        trx->unserialize(&wbuf[0], wbuf.size(), 0);
+                        recv_bytes(socket, &wbuf[0], wbuf.size(),
+                                   "error reading write set data");
                     }
 
-                    if (seqno_d == WSREP_SEQNO_UNDEFINED ||
-                        trx->version() < 3)
-                    {
-                        trx->set_received(0, -1, seqno_g);
-                        trx->set_depends_seqno(seqno_d);
-                    }
-                    else
-                    {
-                        trx->set_received_from_ws();
-                        assert(trx->global_seqno() == seqno_g);
-                        assert(trx->depends_seqno() >= seqno_d);
-                    }
-                    trx->mark_certified();
+                    /* write set is parsed later by parse_trx() in the
+                     * applier thread, until then seqnos come from meta */
+                    trx->set_received(0, -1, seqno_g);
+                    trx->set_depends_seqno(seqno_d);
 
-                    log_debug << "received trx body: " << *trx;
                     return trx;
                 }
                 case Message::T_CTRL:
@@ -592,14 +725,410 @@ namespace galera
                 return 0; // keep compiler happy
             }
 
+            /* Parses the write set of a trx returned by recv_trx().
+             * This is the CPU-heavy part of receiving, so it is left to
+             * be done in parallel by IST applier threads. */
+            static void parse_trx(TrxHandle* const trx)
+            {
+                wsrep_seqno_t const seqno_g(trx->global_seqno());
+                wsrep_seqno_t const seqno_d(trx->depends_seqno());
+
+                if (seqno_d != WSREP_SEQNO_UNDEFINED)
+                {
+                    MappedBuffer& wbuf(trx->write_set_collection());
+                    trx->unserialize(&wbuf[0], wbuf.size(), 0);
+
+                    if (trx->version() >= 3)
+                    {
+                        trx->set_received_from_ws();
+                        assert(trx->global_seqno() == seqno_g);
+                        assert(trx->depends_seqno() >= seqno_d);
+                    }
+                }
+
+                trx->mark_certified();
+
+                log_debug << "received trx body: " << *trx;
+            }
+
         private:
 
+            enum
+            {
+                max_batch_trxs    = 256,
+                max_batch_bytes   = 1 << 22,
+                min_sendfile_size = 1 << 12 // smaller ones are just copied
+            };
+
+            /* Writes and clears the buffers */
+            template <class ST>
+            void write_all(ST& socket, std::vector<asio::const_buffer>& cbs)
+            {
+                if (cbs.empty()) return;
+
+                size_t const size(asio::buffer_size(cbs));
+                size_t const sent(asio::write(socket, cbs));
+
+                if (sent != size)
+                {
+                    gu_throw_error(EPROTO) << "error sending trx batch: "
+                                           << sent << " out of " << size
+                                           << " bytes";
+                }
+
+                cbs.clear();
+            }
+
+            /* Sends size bytes at offset of file fd to socket sock.
+             * Returns false if sendfile() is not supported for them,
+             * in which case nothing was sent. */
+            static bool send_file(int const sock, int const fd, off_t offset,
+                                  size_t size)
+            {
+#if defined(__linux__)
+                bool sent(false);
+
+                while (size > 0)
+                {
+                    ssize_t const ret(::sendfile(sock, fd, &offset, size));
+
+                    if (gu_likely(ret > 0))
+                    {
+                        size -= ret;
+                        sent  = true;
+                        continue;
+                    }
+
+                    int const err(ret < 0 ? errno : EIO);
+
+                    switch (err)
+                    {
+                    case EINTR:
+                        continue;
+                    case EAGAIN:
+                    {
+                        struct pollfd pfd = { sock, POLLOUT, 0 };
+                        (void)::poll(&pfd, 1, -1);
+                        continue;
+                    }
+                    case EINVAL:
+                    case ENOSYS:
+                    case EOPNOTSUPP:
+                        if (!sent) return false;
+                        // fall through
+                    default:
+                        gu_throw_error(err) << "sendfile() failed";
+                    }
+                }
+
+                return true;
+#else
+                return false;
+#endif /* __linux__ */
+            }
+
+            /* Prepares up to max_batch_trxs messages from n buffers, or
+             * fewer if they exceed max_batch_bytes. Message headers are
+             * stored in hdrs and everything to be sent is appended to cbs.
+             * Returns the number of buffers taken, bytes to be sent are
+             * returned in batch_bytes. */
+            size_t prepare_batch(const gcache::GCache::Buffer* const buffers,
+                                 size_t const                        n,
+                                 std::vector<gu::Buffer>&            hdrs,
+                                 std::vector<asio::const_buffer>&    cbs,
+                                 size_t&                         batch_bytes)
+            {
+                hdrs.resize(std::min(n, size_t(max_batch_trxs)));
+                batch_bytes = 0;
+                size_t j(0);
+
+                do
+                {
+                    batch_bytes += prepare_trx(buffers[j], hdrs[j], cbs);
+                }
+                while (++j < hdrs.size() &&
+                       batch_bytes < size_t(max_batch_bytes));
+
+                return j;
+            }
+
+            /* Upper bound of uncompressed batch size: a batch ends as soon
+             * as it reaches max_batch_bytes and trxs of that size or bigger
+             * are never compressed. */
+            size_t max_batch_size() const
+            {
+                size_t const trx_hdr(Message(version_).serial_size() + 16);
+
+                return 2 * size_t(max_batch_bytes) +
+                    size_t(max_batch_trxs) * trx_hdr;
+            }
+
+            /* Same as send_trx(), but each batch is compressed in the
+             * background while the previous one is being written. */
+            template <class ST>
+            void send_compressed(ST&                                 socket,
+                                 const gcache::GCache::Buffer* const buffers,
+                                 size_t const                        n)
+            {
+                std::vector<gu::Buffer>         hdrs[2];
+                std::vector<asio::const_buffer> cbs;
+
+                size_t const offset(Message(version_).serial_size() + 8);
+                int  cur(0);
+                bool pending(false); // jobs_[1 - cur] is yet to be sent
+
+                try
+                {
+                    for (size_t i(0); i < n; cur = 1 - cur)
+                    {
+                        if (buffers[i].size() >= size_t(max_batch_bytes))
+                        {
+                            /* too big to be batched, goes uncompressed so
+                             * that the receiver can bound batch size */
+                            if (pending) send_frame(socket, jobs_[1 - cur]);
+                            pending = false;
+
+                            std::vector<gu::Buffer> hdr;
+                            size_t bytes(0);
+                            (void)prepare_batch(buffers + i, 1, hdr, cbs,
+                                                bytes);
+                            write_all(socket, cbs);
+
+                            raw_sent_  += bytes;
+                            real_sent_ += bytes;
+                            ++i;
+                            continue;
+                        }
+
+                        size_t m(1);
+                        while (m < n - i && m < size_t(max_batch_trxs) &&
+                               buffers[i + m].size() < size_t(max_batch_bytes))
+                        {
+                            ++m;
+                        }
+
+                        Compressor::Job& job(jobs_[cur]);
+
+                        i += prepare_batch(buffers + i, m, hdrs[cur], cbs,
+                                           job.in_size);
+
+                        job.in.resize(cbs.size());
+                        for (size_t k(0); k < cbs.size(); ++k)
+                        {
+                            job.in[k].ptr =
+                                asio::buffer_cast<const void*>(cbs[k]);
+                            job.in[k].size = asio::buffer_size(cbs[k]);
+                        }
+                        cbs.clear();
+
+                        job.offset = offset;
+                        compressor_.start(job);
+
+                        if (pending) send_frame(socket, jobs_[1 - cur]);
+
+                        pending = true;
+                    }
+
+                    if (pending) send_frame(socket, jobs_[1 - cur]);
+                }
+                catch (...)
+                {
+                    // job buffers must outlive compression
+                    compressor_.drain();
+                    throw;
+                }
+            }
+
+            template <class ST>
+            void send_frame(ST& socket, Compressor::Job& job)
+            {
+                size_t const csize(compressor_.wait(job));
+                size_t const raw(job.in_size);
+                gu::Buffer&  out(job.out);
+
+                Message const msg(version_, Message::T_COMPRESSED, compress_,
+                                  0, 8 + csize);
+                size_t offset(msg.serialize(&out[0], out.size(), 0));
+                offset = gu::serialize8(uint64_t(raw), &out[0], out.size(),
+                                        offset);
+
+                size_t const frame(offset + csize);
+                size_t const sent(asio::write(socket,
+                                              asio::buffer(&out[0], frame)));
+                if (sent != frame)
+                {
+                    gu_throw_error(EPROTO) << "error sending compressed batch: "
+                                           << sent << " out of " << frame
+                                           << " bytes";
+                }
+
+                log_debug << "sent compressed batch: " << raw << " -> "
+                          << sent << " bytes";
+
+                raw_sent_  += raw;
+                real_sent_ += sent;
+            }
+
+            /* Reads the rest of a compressed message and decompresses it,
+             * subsequent recv_bytes() calls will read from it until it is
+             * exhausted. */
+            template <class ST>
+            void recv_compressed(ST& socket, const Message& msg)
+            {
+                uint64_t raw;
+                gu::byte_t rbuf[8];
+
+                if (msg.len() <= sizeof(rbuf))
+                {
+                    gu_throw_error(EPROTO) << "compressed message too short: "
+                                           << msg.len();
+                }
+
+                recv_bytes(socket, rbuf, sizeof(rbuf),
+                           "error reading compressed batch size");
+                (void)gu::unserialize8(rbuf, sizeof(rbuf), 0, raw);
+
+                if (raw == 0)
+                {
+                    gu_throw_error(EPROTO) << "empty compressed batch";
+                }
+
+                /* both sizes come off the wire, check them before
+                 * allocating anything */
+                size_t const max_raw(max_batch_size());
+                uint64_t const csize(msg.len() - sizeof(rbuf));
+
+                if (raw > max_raw || csize > max_raw + max_raw / 256 + 64)
+                {
+                    gu_throw_error(EPROTO) << "compressed batch too big: "
+                                           << csize << " -> " << raw
+                                           << " bytes, max " << max_raw;
+                }
+
+                compressed_.resize(csize);
+                recv_bytes(socket, &compressed_[0], compressed_.size(),
+                           "error reading compressed batch");
+
+                inflated_.resize(raw);
+                inflated_off_ = 0;
+                Compressor::decompress(&compressed_[0], compressed_.size(),
+                                       &inflated_[0], inflated_.size(),
+                                       stats_);
+            }
+
+            /* Reads len bytes from the current decompressed batch if there
+             * is one, otherwise from socket. Trx messages never span
+             * batches. */
+            template <class ST>
+            void recv_bytes(ST& socket, void* const ptr, size_t const len,
+                            const char* const err)
+            {
+                if (inflated_off_ < inflated_.size())
+                {
+                    if (gu_unlikely(inflated_.size() - inflated_off_ < len))
+                    {
+                        gu_throw_error(EPROTO) << err << ": truncated batch";
+                    }
+
+                    ::memcpy(ptr, &inflated_[inflated_off_], len);
+                    inflated_off_ += len;
+                    return;
+                }
+
+                size_t const n(asio::read(socket, asio::buffer(ptr, len)));
+
+                if (gu_unlikely(n != len))
+                {
+                    gu_throw_error(EPROTO) << err;
+                }
+            }
+
+            /* Serializes trx message header for the buffer into hdr and
+             * appends the header and the payload to cbs.
+             * Returns the number of bytes appended. */
+            size_t prepare_trx(const gcache::GCache::Buffer&    buffer,
+                               gu::Buffer&                      hdr,
+                               std::vector<asio::const_buffer>& cbs)
+            {
+                const bool rolled_back(buffer.seqno_d() == -1);
+
+                size_t const trx_meta_size(
+                    8 /* serial_size(buffer.seqno_g()) */ +
+                    8 /* serial_size(buffer.seqno_d()) */
+                    );
+
+                size_t const hdr_idx(cbs.size());
+                cbs.push_back(asio::const_buffer()); // placeholder for hdr
+
+                size_t payload_size(0); /* size of the buffers after hdr */
+                size_t ws_hdr_size (0); /* WS header copy appended to hdr */
+                galera::WriteSetIn ws;
+                WriteSetIn::GatherVector out;
+
+                if (gu_likely(!rolled_back))
+                {
+                    if (keep_keys_ || version_ < WS_NG_VERSION)
+                    {
+                        payload_size = buffer.size();
+                        cbs.push_back(asio::const_buffer(buffer.ptr(),
+                                                         payload_size));
+                    }
+                    else
+                    {
+                        gu::Buf tmp = { buffer.ptr(), buffer.size() };
+                        ws.read_buf (tmp, 0);
+
+                        payload_size = ws.gather (out, false, false);
+                        assert (out->size() >= 2);
+
+                        /* the first buffer is the modified header copy
+                         * which is owned by ws: copy it to hdr */
+                        ws_hdr_size = out[0].size;
+
+                        for (size_t k(1); k < out->size(); ++k)
+                        {
+                            cbs.push_back(asio::const_buffer(out[k].ptr,
+                                                             out[k].size));
+                        }
+                    }
+                }
+
+                Trx trx_msg(version_, trx_meta_size + payload_size);
+
+                hdr.resize(trx_msg.serial_size() + trx_meta_size +ws_hdr_size);
+                size_t offset(trx_msg.serialize(&hdr[0], hdr.size(), 0));
+
+                offset = gu::serialize8(buffer.seqno_g(),
+                                        &hdr[0], hdr.size(), offset);
+                offset = gu::serialize8(buffer.seqno_d(),
+                                        &hdr[0], hdr.size(), offset);
+
+                if (ws_hdr_size > 0)
+                {
+                    ::memcpy(&hdr[offset], out[0].ptr, ws_hdr_size);
+                }
+
+                cbs[hdr_idx] = asio::const_buffer(&hdr[0], hdr.size());
+
+                return (hdr.size() + payload_size - ws_hdr_size);
+            }
+
             TrxHandle::SlavePool& trx_pool_;
 
-            uint64_t raw_sent_;
-            uint64_t real_sent_;
-            int      version_;
-            bool     keep_keys_;
+            uint64_t   raw_sent_;
+            uint64_t   real_sent_;
+            uint64_t   file_sent_;    // sent with sendfile()
+            int        version_;
+            bool       keep_keys_;
+            int        compression_;  // algorithms allowed locally
+            int        compress_;     // algorithm negotiated
+            Compressor::Stats* stats_;
+            Compressor::Job jobs_[2]; // batches being compressed and sent
+            Compressor compressor_;   // must go after jobs_
+            gu::Buffer compressed_;   // last received compressed batch
+            gu::Buffer inflated_;     // ... and its contents
+            size_t     inflated_off_; // read offset in inflated_
+            bool       sendfile_;     // sendfile() may be used
         };
     }
 }
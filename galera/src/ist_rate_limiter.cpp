@@ -0,0 +1,278 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#include "ist_rate_limiter.hpp"
+#include "galera_gcs.hpp"
+
+#include "gu_lock.hpp"
+#include "gu_logger.hpp"
+#include "gu_time.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+    static long long const NSEC_PER_SEC    = 1000000000LL;
+    static long long const ADAPT_INTERVAL  = NSEC_PER_SEC / 10;
+    static size_t    const MIN_BURST       = 1 << 16;
+    static double    const MIN_FACTOR      = 1.0 / 64;
+    static double    const FACTOR_STEP     = 1.0 / 16;
+    static long long const MIN_ADAPT_RATE  = 1 << 20;
+    static int       const LOW_NICE        = 10;
+}
+
+
+galera::ist::RateLimiter::RateLimiter(const GcsI* gcs)
+    :
+    mutex_       (),
+    gcs_         (gcs),
+    rate_        (0),
+    adaptive_    (false),
+    low_priority_(false),
+    tokens_      (0),
+    last_        (gu_time_monotonic()),
+    factor_      (1.0),
+    base_        (0),
+    check_time_  (last_),
+    window_bytes_(0)
+{ }
+
+
+void galera::ist::RateLimiter::rate(long long const bytes_per_sec)
+{
+    gu::Lock lock(mutex_);
+    rate_   = std::max(bytes_per_sec, 0LL);
+    tokens_ = 0;
+    last_   = gu_time_monotonic();
+}
+
+
+long long galera::ist::RateLimiter::rate() const
+{
+    gu::Lock lock(mutex_);
+    return rate_;
+}
+
+
+void galera::ist::RateLimiter::adaptive(bool const on)
+{
+    gu::Lock lock(mutex_);
+    adaptive_     = on;
+    factor_       = 1.0;
+    base_         = 0;
+    check_time_   = gu_time_monotonic();
+    window_bytes_ = 0;
+}
+
+
+bool galera::ist::RateLimiter::adaptive() const
+{
+    gu::Lock lock(mutex_);
+    return adaptive_;
+}
+
+
+void galera::ist::RateLimiter::low_priority(bool const low)
+{
+    gu::Lock lock(mutex_);
+    low_priority_ = low;
+}
+
+
+bool galera::ist::RateLimiter::low_priority() const
+{
+    gu::Lock lock(mutex_);
+    return low_priority_;
+}
+
+
+long long galera::ist::RateLimiter::effective_rate_locked() const
+{
+    long long const base(rate_ > 0 ? rate_ : base_);
+
+    if (base <= 0) return 0;
+
+    return std::max(static_cast<long long>(base * factor_), 1LL);
+}
+
+
+long long galera::ist::RateLimiter::effective_rate() const
+{
+    gu::Lock lock(mutex_);
+    return effective_rate_locked();
+}
+
+
+size_t galera::ist::RateLimiter::burst() const
+{
+    gu::Lock lock(mutex_);
+    long long const rate(effective_rate_locked());
+    return rate > 0 ? std::max(size_t(rate / 10), MIN_BURST) : 0;
+}
+
+
+void galera::ist::RateLimiter::adapt(long long const now)
+{
+    long long const elapsed(now - check_time_);
+
+    if (elapsed < ADAPT_INTERVAL) return;
+
+    long long const measured(window_bytes_ * NSEC_PER_SEC / elapsed);
+    check_time_   = now;
+    window_bytes_ = 0;
+
+    gcs_stats stats;
+    gcs_->get_stats(&stats);
+
+    if (stats.fc_lower_limit <= 0) return;
+
+    if (stats.recv_q_len >= stats.fc_lower_limit)
+    {
+        if (factor_ <= MIN_FACTOR) return;
+
+        if (0 == rate_ && 0 == base_)
+        {
+            base_ = std::max(measured, MIN_ADAPT_RATE);
+        }
+
+        factor_ = std::max(factor_ / 2, MIN_FACTOR);
+
+        log_info << "IST sender: recv queue " << stats.recv_q_len
+                 << " >= " << stats.fc_lower_limit << ", reducing rate to "
+                 << effective_rate_locked() << " B/s";
+    }
+    else if (factor_ < 1.0 && stats.recv_q_len < stats.fc_lower_limit / 4)
+    {
+        factor_ = std::min(factor_ + FACTOR_STEP, 1.0);
+
+        if (factor_ >= 1.0)
+        {
+            base_ = 0;
+            log_info << "IST sender: recv queue drained, rate restored";
+        }
+    }
+}
+
+
+void galera::ist::RateLimiter::consume(size_t const bytes)
+{
+    long long sleep_nsec(0);
+
+    {
+        gu::Lock lock(mutex_);
+
+        long long const now(gu_time_monotonic());
+
+        if (adaptive_ && gcs_ != 0)
+        {
+            window_bytes_ += bytes;
+            adapt(now);
+        }
+
+        long long const rate(effective_rate_locked());
+
+        if (0 == rate)
+        {
+            last_ = now;
+            return;
+        }
+
+        double const max_tokens(std::max(double(rate) / 10, double(MIN_BURST)));
+
+        tokens_ += double(now - last_) * rate / NSEC_PER_SEC;
+        tokens_  = std::min(tokens_, max_tokens);
+        last_    = now;
+        tokens_ -= bytes;
+
+        // tokens may go negative: the caller sleeps until the debt is paid
+        // and concurrent senders queue up behind it
+        if (tokens_ < 0)
+        {
+            sleep_nsec = static_cast<long long>(-tokens_ * NSEC_PER_SEC / rate);
+        }
+    }
+
+    if (sleep_nsec > 0) usleep(sleep_nsec / 1000);
+}
+
+
+void galera::ist::RateLimiter::apply_priority(ThreadPriority& applied) const
+{
+    int const low(low_priority() ? 1 : 0);
+
+    if (low == applied.low) return;
+
+    // a fresh thread already runs with normal priority
+    if (low || applied.low >= 0) set_thread_priority(low, applied);
+
+    applied.low = low;
+}
+
+
+void galera::ist::RateLimiter::set_thread_priority(bool const low,
+                                                   ThreadPriority& saved)
+{
+#if defined(__linux__) && defined(SYS_ioprio_set) && defined(SYS_gettid)
+    // see ioprio_set(2): best effort class, lowest level for low priority
+    static int const IOPRIO_CLASS_SHIFT = 13;
+    static int const IOPRIO_CLASS_BE    = 2;
+    static int const IOPRIO_WHO_PROCESS = 1;
+
+    // on Linux nice value is per thread
+    id_t const tid(syscall(SYS_gettid));
+
+    if (low)
+    {
+#ifdef SYS_ioprio_get
+        long const io(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+        saved.ioprio = io >= 0 ? io : 0;
+#endif
+        errno = 0;
+        int const cur(getpriority(PRIO_PROCESS, tid));
+        saved.nice = (cur != -1 || errno == 0) ? cur : 0;
+    }
+
+    int const ioprio(low ? ((IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7) :
+                     saved.ioprio);
+
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) != 0)
+    {
+        log_warn << "IST sender: failed to set I/O priority: " << errno
+                 << " (" << ::strerror(errno) << ')';
+    }
+
+    int const prio(low ? std::max(saved.nice, LOW_NICE) : saved.nice);
+
+    if (setpriority(PRIO_PROCESS, tid, prio) != 0)
+    {
+        if (low)
+        {
+            log_warn << "IST sender: failed to set thread priority: "
+                     << errno << " (" << ::strerror(errno) << ')';
+        }
+        else
+        {
+            // raising priority back needs CAP_SYS_NICE or RLIMIT_NICE
+            log_info << "IST sender: could not restore thread priority: "
+                     << errno << " (" << ::strerror(errno) << "), normal "
+                     << "priority will apply to new senders only";
+        }
+    }
+#else
+    if (low)
+    {
+        log_warn << "IST sender: thread priority is not supported "
+                 "on this platform";
+    }
+#endif
+}
@@ -0,0 +1,101 @@
+//
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+//
+
+#ifndef GALERA_IST_RATE_LIMITER_HPP
+#define GALERA_IST_RATE_LIMITER_HPP
+
+#include "gu_mutex.hpp"
+
+#include <cstddef>
+
+namespace galera
+{
+    class GcsI;
+
+    namespace ist
+    {
+        /*
+         * Token bucket shared by all IST sender threads of a donor, so the
+         * configured rate is the total rate of all stripes and all joiners.
+         *
+         * In adaptive mode the rate is scaled down while the donor's own
+         * recv queue is above the flow control lower limit (i.e. IST starts
+         * to interfere with replication) and is gradually restored when the
+         * queue drains. If no rate is configured, the throughput measured
+         * when congestion was first detected is used as the base rate and
+         * the limit is lifted again once fully restored.
+         *
+         * All settings can be changed while senders are running.
+         */
+        class RateLimiter
+        {
+        public:
+
+            explicit RateLimiter(const GcsI* gcs = 0);
+
+            /* Bytes per second, 0 - unlimited */
+            void      rate(long long bytes_per_sec);
+            long long rate() const;
+
+            void adaptive(bool on);
+            bool adaptive() const;
+
+            /* Whether senders should run with lowered CPU and I/O priority */
+            void low_priority(bool low);
+            bool low_priority() const;
+
+            /* Maximum amount of bytes that should be passed to a single
+             * consume() call to keep sleeps short, 0 if sending is not
+             * limited and batches need not be split */
+            size_t burst() const;
+
+            /* Accounts for bytes about to be sent, sleeps if the sender
+             * is ahead of the allowed rate */
+            void consume(size_t bytes);
+
+            /* Effective rate currently enforced, 0 - unlimited */
+            long long effective_rate() const;
+
+            /* Priority state of a sender thread */
+            struct ThreadPriority
+            {
+                ThreadPriority() : low(-1), nice(0), ioprio(0) { }
+
+                int low;    // applied setting, -1 - none yet
+                int nice;   // saved before lowering
+                int ioprio; // saved before lowering
+            };
+
+            /* Applies the current priority setting to the calling thread
+             * if it differs from the applied one. Lowered priority is
+             * restored to what the thread had before, which may fail
+             * without privileges: then only new senders get it back. */
+            void apply_priority(ThreadPriority& applied) const;
+
+        private:
+
+            void      adapt(long long now);     // called under lock
+            long long effective_rate_locked() const;
+
+            static void set_thread_priority(bool low, ThreadPriority& saved);
+
+            gu::Mutex         mutex_;
+            const GcsI*       gcs_;
+            long long         rate_;
+            bool              adaptive_;
+            bool              low_priority_;
+            double            tokens_;
+            long long         last_;        // last token refill time
+            double            factor_;      // adaptive scaling of base rate
+            long long         base_;        // adaptive base if rate_ is 0
+            long long         check_time_;  // start of measurement window
+            long long         window_bytes_;
+
+            RateLimiter(const RateLimiter&);
+            RateLimiter& operator=(const RateLimiter&);
+        };
+    }
+}
+
+#endif // GALERA_IST_RATE_LIMITER_HPP
@@ -6,6 +6,7 @@
 #define GALERA_KEY_ENTRY_NG_HPP
 
 #include "trx_handle.hpp"
+#include "uuid.hpp"
 
 namespace galera
 {
@@ -14,11 +15,28 @@ namespace galera
     class KeyEntryNG
     {
     public:
+        /* reference type for exclusive keys of commutative trxs, they are
+         * kept apart from other exclusive references. Commutative trxs don't
+         * certify against each other, so the newest one may hide an older
+         * one from another source: REF_COMMUTATIVE_OTHER keeps the newest
+         * commutative reference from a source other than REF_COMMUTATIVE's,
+         * so that any source finds the newest conflicting one of the two. */
+        static int const REF_COMMUTATIVE       = KeySet::Key::TYPE_MAX + 1;
+        static int const REF_COMMUTATIVE_OTHER = REF_COMMUTATIVE + 1;
+        static int const REF_MAX               = REF_COMMUTATIVE_OTHER;
+
+        /* returns reference type for a key of given type in trx */
+        static int ref_type(wsrep_key_type_t const p, const TrxHandle* trx)
+        {
+            return ((WSREP_KEY_EXCLUSIVE == p && trx->is_commutative()) ?
+                    REF_COMMUTATIVE : p);
+        }
+
         KeyEntryNG(const KeySet::KeyPart& key)
             : refs_(), key_(key)
         {
             std::fill(&refs_[0],
-                      &refs_[KeySet::Key::TYPE_MAX],
+                      &refs_[REF_MAX],
                       static_cast<TrxHandle*>(NULL));
         }
 
@@ -26,23 +44,29 @@ namespace galera
         : refs_(), key_(other.key_)
         {
             std::copy(&other.refs_[0],
-                      &other.refs_[KeySet::Key::TYPE_MAX],
+                      &other.refs_[REF_MAX],
                       &refs_[0]);
         }
 
         const KeySet::KeyPart& key() const { return key_; }
 
-        void ref(wsrep_key_type_t p, const KeySet::KeyPart& k,
+        void ref(int p, const KeySet::KeyPart& k,
                  TrxHandle* trx)
         {
             assert(0 == refs_[p] ||
                    refs_[p]->global_seqno() <= trx->global_seqno());
 
+            if (REF_COMMUTATIVE == p && 0 != refs_[p] &&
+                refs_[p]->source_id() != trx->source_id())
+            {
+                refs_[REF_COMMUTATIVE_OTHER] = refs_[p];
+            }
+
             refs_[p] = trx;
             key_ = k;
         }
 
-        void unref(wsrep_key_type_t p, TrxHandle* trx)
+        void unref(int p, TrxHandle* trx)
         {
             assert(refs_[p] != NULL);
 
@@ -50,6 +74,11 @@ namespace galera
             {
                 refs_[p] = NULL;
             }
+            else if (REF_COMMUTATIVE == p &&
+                     refs_[REF_COMMUTATIVE_OTHER] == trx)
+            {
+                refs_[REF_COMMUTATIVE_OTHER] = NULL;
+            }
             else
             {
                 assert(refs_[p]->global_seqno() > trx->global_seqno());
@@ -61,7 +90,7 @@ namespace galera
         {
             bool ret(refs_[0] != NULL);
 
-            for (int i(1); false == ret && i <= KeySet::Key::TYPE_MAX; ++i)
+            for (int i(1); false == ret && i <= REF_MAX; ++i)
             {
                 ret = (refs_[i] != NULL);
             }
@@ -74,6 +103,14 @@ namespace galera
             return refs_[p];
         }
 
+        /* true if trx holds a reference of type p */
+        bool ref_by(int const p, const TrxHandle* const trx) const
+        {
+            return (refs_[p] == trx ||
+                    (REF_COMMUTATIVE == p &&
+                     refs_[REF_COMMUTATIVE_OTHER] == trx));
+        }
+
         size_t size() const
         {
             return sizeof(*this);
@@ -99,7 +136,7 @@ namespace galera
 
     private:
 
-        TrxHandle*      refs_[KeySet::Key::TYPE_MAX + 1];
+        TrxHandle*      refs_[REF_MAX + 1];
         KeySet::KeyPart key_;
 
 #ifndef NDEBUG
@@ -21,7 +21,7 @@ KeySet::throw_version(int ver)
 
 static const char* ver_str[KeySet::MAX_VERSION + 1] =
 {
-    "EMPTY", "FLAT8", "FLAT8A", "FLAT16", "FLAT16A"
+    "EMPTY", "FLAT8", "FLAT8A", "FLAT16", "FLAT16A", "FLAT16AC"
 };
 
 KeySet::Version
@@ -52,9 +52,13 @@ KeySet::KeyPart::store_annotation (const wsrep_buf_t* const parts,
                                    int                const part_num,
                                    gu::byte_t*              buf,
                                    int                const size,
-                                   int                const alignment)
+                                   int                const alignment,
+                                   bool               const compact,
+                                   int                const parent)
 {
     assert(size >= 0);
+    assert(parent >= 0 && parent <= NO_PARENT);
+    assert(compact || NO_PARENT == parent);
 
     /* max len representable in one byte */
     static size_t const max_part_len(std::numeric_limits<gu::byte_t>::max());
@@ -63,10 +67,13 @@ KeySet::KeyPart::store_annotation (const wsrep_buf_t* const parts,
     ann_size_t const max_ann_len(std::numeric_limits<ann_size_t>::max() /
                                  alignment * alignment);
 
+    /* with parent reference only the last part needs to be stored */
+    int const first_part(NO_PARENT != parent ? part_num : 0);
+
     ann_size_t ann_size;
-    int        tmp_size(sizeof(ann_size));
+    int        tmp_size(sizeof(ann_size) + (compact ? sizeof(ann_ref_t) : 0));
 
-    for (int i(0); i <= part_num; ++i)
+    for (int i(first_part); i <= part_num; ++i)
     {
         tmp_size += 1 + std::min(parts[i].len, max_part_len);
     }
@@ -92,7 +99,16 @@ KeySet::KeyPart::store_annotation (const wsrep_buf_t* const parts,
 
         ::memcpy(buf, &tmp, off);
 
-        for (int i(0); i <= part_num && off < ann_size; ++i)
+        if (compact)
+        {
+            assert(off + sizeof(ann_ref_t) <= ann_size);
+
+            ann_ref_t const ref(gu::htog<ann_ref_t>(parent));
+            ::memcpy(buf + off, &ref, sizeof(ref));
+            off += sizeof(ref);
+        }
+
+        for (int i(first_part); i <= part_num && off < ann_size; ++i)
         {
             size_t const left(ann_size - off - 1);
             gu::byte_t const part_len
@@ -122,7 +138,8 @@ KeySet::KeyPart::store_annotation (const wsrep_buf_t* const parts,
 }
 
 void
-KeySet::KeyPart::print_annotation(std::ostream& os, const gu::byte_t* buf)
+KeySet::KeyPart::print_annotation(std::ostream& os, const gu::byte_t* buf,
+                                  bool const compact)
 {
     ann_size_t const ann_size(gu::gtoh<ann_size_t>(
                                   *reinterpret_cast<const ann_size_t*>(buf)));
@@ -130,9 +147,21 @@ KeySet::KeyPart::print_annotation(std::ostream& os, const gu::byte_t* buf)
     size_t const begin(sizeof(ann_size_t));
     size_t off(begin);
 
+    if (compact && off + sizeof(ann_ref_t) <= ann_size)
+    {
+        ann_ref_t const ref(gu::gtoh<ann_ref_t>(
+                                *reinterpret_cast<const ann_ref_t*>(buf+off)));
+        off += sizeof(ref);
+
+        /* parent parts are found in the referenced record */
+        if (NO_PARENT != ref) os << '^' << ref << '/';
+    }
+
+    size_t const parts_begin(off);
+
     while (off < ann_size)
     {
-        if (off != begin) os << '/';
+        if (off != parts_begin) os << '/';
 
         gu::byte_t const part_len(buf[off]); ++off;
 
@@ -188,7 +217,7 @@ KeySet::KeyPart::print (std::ostream& os) const
     if (annotated(ver))
     {
         os << "=";
-        print_annotation (os, data_ + size);
+        print_annotation (os, data_ + size, ver == FLAT16AC);
     }
 }
 
@@ -213,7 +242,8 @@ KeySetOut::KeyPart::KeyPart (KeyParts&      added,
     value_(static_cast<const gu::byte_t*>(kd.parts[part_num].ptr)),
     size_ (kd.parts[part_num].len),
     ver_  (parent->ver_),
-    own_  (false)
+    own_  (false),
+    rec_  (KeySet::KeyPart::NO_PARENT)
 {
     assert (ver_);
     uint32_t const s(gu::htog(size_));
@@ -232,7 +262,8 @@ KeySetOut::KeyPart::KeyPart (KeyParts&      added,
 
     assert (kd.parts_num > part_num);
 
-    KeySet::KeyPart kp(ts, hd, kd.parts, ver_, prefix, part_num, alignment);
+    KeySet::KeyPart kp(ts, hd, kd.parts, ver_, prefix, part_num, alignment,
+                       parent->rec_);
 
 #if 0 /* find() way */
     /* the reason to use find() first, instead of going straight to insert()
@@ -277,6 +308,7 @@ KeySetOut::KeyPart::KeyPart (KeyParts&      added,
         /* The key part was successfully inserted, store it in the key set
            buffer */
         inserted.first->store (store);
+        rec_ = store.stored(inserted.first->ptr());
     }
     else
     {
@@ -290,6 +322,7 @@ KeySetOut::KeyPart::KeyPart (KeyParts&      added,
                have to store a duplicate with a stronger constraint) */
             kp.store (store);
             inserted.first->update_ptr(kp.ptr());
+            rec_ = store.stored(kp.ptr());
             /* It is a hack, but it should be safe to modify key part already
                inserted into unordered set, as long as modification does not
                change hash and equality test results. And we get it to point to
@@ -309,6 +342,10 @@ KeySetOut::KeyPart::KeyPart (KeyParts&      added,
 #endif
             throw DUPLICATE();
         }
+        else
+        {
+            rec_ = store.stored_rec(inserted.first->ptr());
+        }
     }
 
     part_ = &(*inserted.first);
@@ -30,8 +30,9 @@ public:
         FLAT8A,   /*  8-byte hash (flat), annotated */
         FLAT16,   /* 16-byte hash (flat) */
         FLAT16A,  /* 16-byte hash (flat), annotated */
+        FLAT16AC, /* 16-byte hash (flat), compactly annotated */
 //      TREE8,    /*  8-byte hash + full serialized key */
-        MAX_VERSION = FLAT16A
+        MAX_VERSION = FLAT16AC
     };
 
     static Version version (unsigned int ver)
@@ -69,6 +70,12 @@ public:
         static size_t const TMP_STORE_SIZE = 4096;
         static size_t const MAX_HASH_SIZE  = 16;
 
+        /* Compact annotation (FLAT16AC) references the parent key part by
+         * its record number in the key set and carries only the last part.
+         * NO_PARENT means that the annotation carries all parts in full
+         * (root part or parent record number not representable). */
+        static int const NO_PARENT = 0xffff;
+
         union TmpStore { gu::byte_t buf[TMP_STORE_SIZE]; gu_word_t align; };
         union HashData { gu::byte_t buf[MAX_HASH_SIZE];  gu_word_t align; };
 
@@ -80,15 +87,16 @@ public:
                  Version const   ver,
                  int const       prefix,
                  int const       part_num,
-                 int const       alignment
+                 int const       alignment,
+                 int const       parent = NO_PARENT
             )
             : data_(tmp.buf)
         {
             assert(ver > EMPTY && ver <= MAX_VERSION);
 
-            /* 16 if ver in { FLAT16, FLAT16A }, 8 otherwise */
+            /* 16 if ver in { FLAT16, FLAT16A, FLAT16AC }, 8 otherwise */
             int const key_size
-                (8 << (static_cast<unsigned int>(ver - FLAT16) <= 1));
+                (8 << (static_cast<unsigned int>(ver - FLAT16) <= 2));
 
             assert((key_size % alignment) == 0);
             assert((uintptr_t(tmp.buf)  % GU_WORD_BYTES) == 0);
@@ -115,7 +123,8 @@ public:
                 store_annotation(parts, part_num,
                                  tmp.buf + key_size,
                                  sizeof(tmp.buf) - key_size,
-                                 alignment);
+                                 alignment,
+                                 ver == FLAT16AC, parent);
             }
         }
 
@@ -218,6 +227,7 @@ public:
                 throw_match_empty_key(version(), kp.version());
             case FLAT16:
             case FLAT16A:
+            case FLAT16AC:
 #if GU_WORDSIZE == 64
                 ret = (lhs[1] == rhs[1]);
 #else
@@ -308,6 +318,7 @@ public:
             {
             case FLAT16:
             case FLAT16A:
+            case FLAT16AC:
                 return 16;
             case FLAT8:
             case FLAT8A:
@@ -321,10 +332,11 @@ public:
         static bool
         annotated (Version const ver)
         {
-            return (ver == FLAT16A || ver == FLAT8A);
+            return (ver == FLAT16A || ver == FLAT8A || ver == FLAT16AC);
         }
 
         typedef uint16_t ann_size_t;
+        typedef uint16_t ann_ref_t;
 
         static size_t
         serial_size (Version const ver,
@@ -346,10 +358,12 @@ public:
 
         static size_t
         store_annotation (const wsrep_buf_t* parts, int part_num,
-                          gu::byte_t* buf, int size, int alignment);
+                          gu::byte_t* buf, int size, int alignment,
+                          bool compact, int parent);
 
         static void
-        print_annotation (std::ostream& os, const gu::byte_t* buf);
+        print_annotation (std::ostream& os, const gu::byte_t* buf,
+                          bool compact);
 
         static void
         throw_buffer_too_short (size_t expected, size_t got) GU_NORETURN;
@@ -567,7 +581,8 @@ public:
             value_(0),
             size_ (0),
             ver_  (ver),
-            own_  (false)
+            own_  (false),
+            rec_  (KeySet::KeyPart::NO_PARENT)
         {
             assert (ver_);
         }
@@ -590,7 +605,8 @@ public:
         value_(k.value_),
         size_ (k.size_),
         ver_  (k.ver_),
-        own_  (k.own_)
+        own_  (k.own_),
+        rec_  (k.rec_)
         {
             assert (ver_);
             k.own_ = false;
@@ -607,6 +623,7 @@ public:
             swap (l.size_,  r.size_ );
             swap (l.ver_,   r.ver_  );
             swap (l.own_,   r.own_  );
+            swap (l.rec_,   r.rec_  );
         }
 
         KeyPart&
@@ -657,6 +674,7 @@ public:
         KeySet::Version   ver_;
         mutable
         bool              own_;
+        int               rec_;  // record number of the stored part
 
     }; /* class KeySetOut::KeyPart */
 
@@ -667,6 +685,7 @@ public:
         added_(),
         prev_ (),
         new_  (),
+        recs_ (),
         version_()
     {}
 
@@ -687,6 +706,7 @@ public:
         added_(),
         prev_ (),
         new_  (),
+        recs_ (),
         version_(version),
         ws_ver_(ws_ver)
     {
@@ -699,6 +719,32 @@ public:
 
     ~KeySetOut () {}
 
+    /* records the number of the just stored key part for reference by its
+     * children, returns the number or NO_PARENT if it is not representable */
+    int
+    stored (const gu::byte_t* ptr)
+    {
+        if (version_ != KeySet::FLAT16AC) return KeySet::KeyPart::NO_PARENT;
+
+        int const rec(count() - 1);
+
+        if (rec >= KeySet::KeyPart::NO_PARENT)
+            return KeySet::KeyPart::NO_PARENT;
+
+        recs_.insert(std::make_pair(ptr, rec));
+        return rec;
+    }
+
+    /* returns the record number of the already stored key part */
+    int
+    stored_rec (const gu::byte_t* ptr) const
+    {
+        gu::UnorderedMap<const gu::byte_t*, int>::const_iterator const
+            i(recs_.find(ptr));
+
+        return (i != recs_.end() ? i->second : KeySet::KeyPart::NO_PARENT);
+    }
+
     size_t
     append (const KeyData& kd);
 
@@ -711,6 +757,8 @@ private:
     KeyParts              added_;
     gu::Vector<KeyPart,5> prev_;
     gu::Vector<KeyPart,5> new_;
+    /* record numbers of stored parts, FLAT16AC only */
+    gu::UnorderedMap<const gu::byte_t*, int> recs_;
     KeySet::Version       version_;
     int                   ws_ver_;
 
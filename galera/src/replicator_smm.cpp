@@ -146,6 +146,8 @@ galera::ReplicatorSMM::ReplicatorSMM(const struct wsrep_init_args* args)
     state_uuid_         (WSREP_UUID_UNDEFINED),
     state_uuid_str_     (),
     cc_seqno_           (WSREP_SEQNO_UNDEFINED),
+    fragment_size_      (gu::from_string<size_t>(
+                             config_.get(Param::fragment_size))),
     pause_seqno_        (WSREP_SEQNO_UNDEFINED),
     app_ctx_            (args->app_ctx),
     view_cb_            (args->view_handler_cb),
@@ -178,6 +180,7 @@ galera::ReplicatorSMM::ReplicatorSMM(const struct wsrep_init_args* args)
     ist_senders_        (gcs_, gcache_),
     wsdb_               (),
     cert_               (config_, service_thd_, gcache_),
+    fragments_          (),
 #ifdef HAVE_PSI_INTERFACE
     local_monitor_      (WSREP_PFS_INSTR_TAG_LOCAL_MONITOR_MUTEX,
                          WSREP_PFS_INSTR_TAG_LOCAL_MONITOR_CONDVAR),
@@ -478,6 +481,37 @@ void galera::ReplicatorSMM::apply_trx(void* recv_ctx, TrxHandle* trx)
     CommitOrder co(*trx, co_mode_);
 
     gu_trace(apply_monitor_.enter(ao));
+
+    if (gu_unlikely(trx->is_streaming()))
+    {
+        bool apply(trx->flags() & TrxHandle::F_COMMIT);
+
+        // write sets received via IST did not go through cert(),
+        // so fragments are collected here
+        if (trx->local_seqno() == WSREP_SEQNO_UNDEFINED &&
+            !process_streaming(trx, true))
+        {
+            log_warn << "Skipping incomplete streaming trx: " << *trx;
+            assert(0);
+            apply = false;
+        }
+
+        if (!apply)
+        {
+            // fragment data is applied together with the committing write
+            // set, rollback write set has nothing to apply
+            if (co_mode_ != CommitOrder::BYPASS) commit_monitor_.self_cancel(co);
+
+            if (!trx->is_fragment() && trx->local_seqno() != -1)
+            {
+                report_last_committed(cert_.set_trx_committed(trx));
+            }
+
+            apply_monitor_.leave(ao);
+            return;
+        }
+    }
+
     trx->set_state(TrxHandle::S_APPLYING);
 
     wsrep_trx_meta_t meta = {{state_uuid_, trx->global_seqno() },
@@ -538,6 +572,11 @@ void galera::ReplicatorSMM::apply_trx(void* recv_ctx, TrxHandle* trx)
      * is needed here. */
     trx->unordered(recv_ctx, unordered_cb_);
 
+    if (gu_unlikely(!trx->fragments().empty()))
+    {
+        release_fragments(trx->fragments());
+    }
+
     apply_monitor_.leave(ao);
 
     if (trx->is_toi())
@@ -551,6 +590,37 @@ void galera::ReplicatorSMM::apply_trx(void* recv_ctx, TrxHandle* trx)
 }
 
 
+wsrep_status_t galera::ReplicatorSMM::flush_fragment(TrxHandle* trx)
+{
+    if (gu_likely(0 == fragment_size_) || protocol_version_ < 10 ||
+        !trx->new_version() || trx->write_set_out().size() < fragment_size_)
+    {
+        return WSREP_OK;
+    }
+
+    if (trx->state() != TrxHandle::S_EXECUTING) return WSREP_TRX_FAIL;
+
+    TrxHandle::Fragments const& frags(trx->fragments());
+
+    if (!frags.empty() && frags.front()->global_seqno() <= cc_seqno_)
+    {
+        // configuration change since the first fragment, trx is doomed
+        trx->set_state(TrxHandle::S_MUST_ABORT);
+        return WSREP_TRX_FAIL;
+    }
+
+    wsrep_status_t const retval
+        (replicate_fragment(trx, frags.empty() ? TrxHandle::F_BEGIN : 0));
+
+    if (WSREP_OK != retval && trx->state() != TrxHandle::S_MUST_ABORT)
+    {
+        trx->set_state(TrxHandle::S_MUST_ABORT);
+    }
+
+    return retval;
+}
+
+
 wsrep_status_t galera::ReplicatorSMM::replicate(TrxHandle* trx,
                                                 wsrep_trx_meta_t* meta)
 {
@@ -570,6 +640,22 @@ wsrep_status_t galera::ReplicatorSMM::replicate(TrxHandle* trx,
         return retval;
     }
 
+    if (gu_unlikely(!trx->fragments().empty()))
+    {
+        // committing write set of streaming trx must be applied after all
+        // preceding write sets, see apply_trx()
+        trx->set_flags(trx->flags() | TrxHandle::F_STREAMING |
+                       TrxHandle::F_PA_UNSAFE);
+    }
+
+    if (gu_unlikely(trx->flags() & TrxHandle::F_COMMUTATIVE) &&
+        protocol_version_ < 10)
+    {
+        // nodes of older protocols certify all write sets as
+        // non-commutative, keep certification results consistent
+        trx->set_flags(trx->flags() & ~TrxHandle::F_COMMUTATIVE);
+    }
+
     WriteSetNG::GatherVector actv;
 
     gcs_action act;
@@ -1084,6 +1170,11 @@ wsrep_status_t galera::ReplicatorSMM::post_commit(TrxHandle* trx)
 
     trx->set_state(TrxHandle::S_COMMITTED);
 
+    if (gu_unlikely(!trx->fragments().empty()))
+    {
+        release_fragments(trx->fragments());
+    }
+
     ++local_commits_;
 
     return WSREP_OK;
@@ -1102,6 +1193,22 @@ wsrep_status_t galera::ReplicatorSMM::post_rollback(TrxHandle* trx)
 
     trx->set_state(TrxHandle::S_ROLLED_BACK);
 
+    if (gu_unlikely(!trx->fragments().empty()))
+    {
+        // let the other nodes discard the fragments they have collected
+        TrxHandle::Params params(trx_params_);
+        params.version_ = trx->version();
+        trx->next_fragment(params);
+
+        if (WSREP_OK != replicate_fragment(trx, TrxHandle::F_ROLLBACK))
+        {
+            log_debug << "Failed to replicate rollback of streaming trx "
+                      << *trx;
+        }
+
+        release_fragments(trx->fragments());
+    }
+
     // Trx was either rolled back by user or via certification failure,
     // last committed report not needed since cert index state didn't change.
     // report_last_committed();
@@ -1510,6 +1617,14 @@ void galera::ReplicatorSMM::establish_protocol_versions (int proto_ver)
         trx_params_.record_set_ver_ = gu::RecordSet::VER2;
         str_proto_ver_ = 2;
         break;
+    case 10:
+        // Protocol upgrade to enable streaming of large transactions in
+        // fragments, FLAT16AC key sets and certification of commutative
+        // write sets, no effect to TRX or STR protocols.
+        trx_params_.version_ = 4;
+        trx_params_.record_set_ver_ = gu::RecordSet::VER2;
+        str_proto_ver_ = 2;
+        break;
     default:
         log_fatal << "Configuration change resulted in an unsupported protocol "
             "version: " << proto_ver << ". Can't continue.";
@@ -1517,6 +1632,8 @@ void galera::ReplicatorSMM::establish_protocol_versions (int proto_ver)
     };
 
     protocol_version_ = proto_ver;
+    trx_params_.key_format_ =
+        key_format(KeySet::version(config_.get(Param::key_format)));
     log_info << "REPL Protocols: " << protocol_version_ << " ("
               << trx_params_.version_ << ", " << str_proto_ver_ << ")";
 }
@@ -1648,6 +1765,14 @@ galera::ReplicatorSMM::process_conf_change(void*                    recv_ctx,
 
     if (view_info.view >= 0) // Primary configuration
     {
+        // streaming trxs can't survive configuration change: there is no
+        // way to pass the fragments collected so far to joining nodes
+        {
+            TrxHandle::Fragments frags;
+            fragments_.clear(frags);
+            release_fragments(frags);
+        }
+
         // we have to reset cert initial position here, SST does not contain
         // cert index yet (see #197).
         // Also this must be done before releasing GCache buffers.
@@ -1964,7 +2089,17 @@ wsrep_status_t galera::ReplicatorSMM::cert(TrxHandle* trx)
         switch (cert_.append_trx(trx))
         {
         case Certification::TEST_OK:
-            if (gu_likely(applicable))
+            if (gu_unlikely(trx->is_streaming()) &&
+                !process_streaming(trx, true))
+            {
+                // streaming trx can't be completed, treat it as failed
+                log_debug << "Incomplete streaming trx: " << *trx;
+                trx->set_depends_seqno(WSREP_SEQNO_UNDEFINED);
+                local_cert_failures_ += trx->is_local();
+                trx->set_state(TrxHandle::S_MUST_ABORT);
+                retval = WSREP_TRX_FAIL;
+            }
+            else if (gu_likely(applicable))
             {
                 if (trx->state() == TrxHandle::S_CERTIFYING)
                 {
@@ -2022,6 +2157,11 @@ wsrep_status_t galera::ReplicatorSMM::cert(TrxHandle* trx)
                 log_debug << "Certification failed for replicated action: "
                           << *trx;
 
+            if (gu_unlikely(trx->is_streaming()))
+            {
+                (void)process_streaming(trx, false);
+            }
+
             local_cert_failures_ += trx->is_local();
             trx->set_state(TrxHandle::S_MUST_ABORT);
             retval = WSREP_TRX_FAIL;
@@ -2031,6 +2171,11 @@ wsrep_status_t galera::ReplicatorSMM::cert(TrxHandle* trx)
         if (gu_unlikely(WSREP_TRX_FAIL == retval))
         {
             report_last_committed(cert_.set_trx_committed(trx));
+
+            if (!trx->is_local() && !trx->fragments().empty())
+            {
+                release_fragments(trx->fragments());
+            }
         }
 
         // at this point we are about to leave local_monitor_. Make sure
@@ -2118,6 +2263,163 @@ wsrep_status_t galera::ReplicatorSMM::cert_for_aborted(TrxHandle* trx)
 }
 
 
+/* Replicates current contents of the write set of a local streaming trx as
+ * a separate fragment and starts a new one. The fragment is certified like
+ * any other write set, but is not applied locally since its data is already
+ * in the database. Slave handle of the fragment is kept by the trx until
+ * it commits or rolls back. */
+wsrep_status_t
+galera::ReplicatorSMM::replicate_fragment(TrxHandle* const trx,
+                                          uint32_t   const flags)
+{
+    assert(trx->is_local());
+    assert(trx->new_version());
+
+    if (state_() < S_JOINED) return WSREP_TRX_FAIL;
+
+    trx->set_flags(flags | TrxHandle::F_STREAMING);
+
+    WriteSetNG::GatherVector actv;
+
+    gcs_action act;
+    act.type = GCS_ACT_TORDERED;
+    act.buf  = NULL;
+    act.size = trx->write_set_out().gather(trx->source_id(),
+                                           trx->conn_id(),
+                                           trx->trx_id(),
+                                           actv);
+    ssize_t rcode;
+
+    do
+    {
+        trx->set_last_seen_seqno(last_committed());
+        trx->unlock();
+        rcode = gcs_.replv(actv, act, false);
+        trx->lock();
+    }
+    while (rcode == -EAGAIN && trx->state() != TrxHandle::S_MUST_ABORT &&
+           (usleep(1000), true));
+
+    if (rcode < 0)
+    {
+        log_debug << "gcs_repl() failed with " << strerror(-rcode)
+                  << " for fragment of trx " << *trx;
+        return WSREP_TRX_FAIL;
+    }
+
+    assert(act.buf != NULL);
+    assert(act.size == rcode);
+
+    ++replicated_;
+    replicated_bytes_ += rcode;
+
+    TrxHandle* const frag(TrxHandle::New(slave_pool_));
+
+    gu_trace(frag->unserialize(static_cast<const gu::byte_t*>(act.buf),
+                               act.size, 0));
+    frag->update_stats(keys_count_, keys_bytes_, data_bytes_, unrd_bytes_);
+    frag->set_received(act.buf, act.seqno_l, act.seqno_g);
+    frag->set_state(TrxHandle::S_REPLICATING);
+
+    wsrep_status_t const retval(cert_and_catch(frag));
+
+    if (WSREP_OK == retval)
+    {
+        ApplyOrder  ao(*frag);
+        CommitOrder co(*frag, co_mode_);
+        apply_monitor_.self_cancel(ao);
+        if (co_mode_ != CommitOrder::BYPASS) commit_monitor_.self_cancel(co);
+
+        if (flags & TrxHandle::F_ROLLBACK)
+        {
+            report_last_committed(cert_.set_trx_committed(frag));
+        }
+        else
+        {
+            trx->fragments().push_back(frag);
+
+            TrxHandle::Params params(trx_params_);
+            params.version_ = trx->version();
+            trx->next_fragment(params);
+
+            return retval;
+        }
+    }
+
+    frag->unref();
+
+    return retval;
+}
+
+
+/* Keeps track of streaming trx write sets. Must be called in total order:
+ * from cert() inside local monitor or, for write sets that came from IST,
+ * from apply_trx(). Returns false if the write set can't be committed. */
+bool
+galera::ReplicatorSMM::process_streaming(TrxHandle* const trx,
+                                         bool       const certified)
+{
+    assert(trx->is_streaming());
+
+    if (trx->is_local())
+    {
+        // Configuration change discards all collected fragments on all
+        // nodes, so trx can't be committed if it started before it.
+        assert(!trx->fragments().empty());
+        return (trx->fragments().front()->global_seqno() > cc_seqno_);
+    }
+
+    // own fragments and rollbacks are kept by the local trx
+    if (trx->source_id() == uuid_) return true;
+
+    if (trx->is_fragment())
+    {
+        if (certified && !fragments_.insert(trx) &&
+            trx->local_seqno() != WSREP_SEQNO_UNDEFINED)
+        {
+            // beginning of the trx was missed, fragment is not needed
+            report_last_committed(cert_.set_trx_committed(trx));
+        }
+
+        return true;
+    }
+
+    bool const complete(fragments_.remove(*trx, trx->fragments()));
+
+    if (certified && complete && (trx->flags() & TrxHandle::F_COMMIT))
+    {
+        return true; // fragments will be applied together with trx
+    }
+
+    release_fragments(trx->fragments());
+
+    return ((trx->flags() & TrxHandle::F_COMMIT) == 0);
+}
+
+
+void
+galera::ReplicatorSMM::release_fragments(TrxHandle::Fragments& frags)
+{
+    wsrep_seqno_t purge(WSREP_SEQNO_UNDEFINED);
+
+    for (size_t i(0); i < frags.size(); ++i)
+    {
+        TrxHandle* const frag(frags[i]);
+
+        if (frag->local_seqno() != WSREP_SEQNO_UNDEFINED)
+        {
+            purge = std::max(purge, cert_.set_trx_committed(frag));
+        }
+
+        frag->unref();
+    }
+
+    frags.clear();
+
+    report_last_committed(purge);
+}
+
+
 void
 galera::ReplicatorSMM::update_state_uuid (const wsrep_uuid_t& uuid,
                                           const wsrep_seqno_t seqno)
@@ -18,6 +18,7 @@
 #include "monitor.hpp"
 #include "wsdb.hpp"
 #include "certification.hpp"
+#include "fragment_map.hpp"
 #include "trx_handle.hpp"
 #include "write_set.hpp"
 #include "galera_service_thd.hpp"
@@ -91,6 +92,9 @@ namespace galera
 
         void apply_trx(void* recv_ctx, TrxHandle* trx);
 
+        /* replicates the write set collected so far as a fragment of
+         * streaming trx if it has grown over repl.fragment_size */
+        wsrep_status_t flush_fragment(TrxHandle* trx);
         wsrep_status_t replicate(TrxHandle* trx, wsrep_trx_meta_t*);
         void abort_trx(TrxHandle* trx) ;
         wsrep_status_t pre_commit(TrxHandle*  trx, wsrep_trx_meta_t*);
@@ -205,6 +209,7 @@ namespace galera
             static const std::string commit_order;
             static const std::string causal_read_timeout;
             static const std::string max_write_set_size;
+            static const std::string fragment_size;
         };
 
         typedef std::pair<std::string, std::string> Default;
@@ -236,6 +241,11 @@ namespace galera
         wsrep_status_t cert_and_catch(TrxHandle* trx);
         wsrep_status_t cert_for_aborted(TrxHandle* trx);
 
+        // streaming trx support
+        wsrep_status_t replicate_fragment(TrxHandle* trx, uint32_t flags);
+        bool process_streaming(TrxHandle* trx, bool certified);
+        void release_fragments(TrxHandle::Fragments& frags);
+
         void update_state_uuid (const wsrep_uuid_t& u,
                                 const wsrep_seqno_t seqno);
         void update_incoming_list (const wsrep_view_info_t& v);
@@ -502,6 +512,9 @@ namespace galera
 
         void establish_protocol_versions (int version);
 
+        /* returns key set version supported by current protocol version */
+        KeySet::Version key_format (KeySet::Version ver) const;
+
         bool state_transfer_required(const wsrep_view_info_t& view_info);
 
         void prepare_for_IST (void*& req, ssize_t& req_len,
@@ -509,6 +522,7 @@ namespace galera
                               wsrep_seqno_t       group_seqno);
 
         void recv_IST(void* recv_ctx);
+        void IST_interrupted(int err);
 
         StateRequest* prepare_state_request (const void* sst_req,
                                              ssize_t     sst_req_len,
@@ -568,6 +582,7 @@ namespace galera
          * |                 7 |           3 |              2 |               1 |
          * |                 8 |           3 |              2 |               2 |
          * |                 9 |           4 |              2 |               2 |
+         * |                10 |           4 |              2 |               2 |
          * |--------------------------------------------------------------------|
          */
 
@@ -597,6 +612,7 @@ namespace galera
         wsrep_uuid_t const    state_uuid_;
         const char            state_uuid_str_[37];
         wsrep_seqno_t         cc_seqno_; // seqno of last CC
+        size_t                fragment_size_; // streaming threshold, 0 - off
         wsrep_seqno_t         pause_seqno_; // local seqno of last pause call
 
         // application callbacks
@@ -638,6 +654,7 @@ namespace galera
         // trx processing
         Wsdb            wsdb_;
         Certification   cert_;
+        FragmentMap     fragments_; // fragments of remote streaming trxs
 
         // concurrency control
         Monitor<LocalOrder>  local_monitor_;
@@ -674,6 +691,7 @@ namespace galera
         // Storage space for dynamic status strings
         char                  interval_string_[64];
         char                  ist_status_string_[128];
+        char                  gcache_alloc_sizes_[512];
     };
 
     std::ostream& operator<<(std::ostream& os, ReplicatorSMM::State state);
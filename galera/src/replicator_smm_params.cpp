@@ -24,8 +24,10 @@ const std::string galera::ReplicatorSMM::Param::key_format =
     common_prefix + "key_format";
 const std::string galera::ReplicatorSMM::Param::max_write_set_size =
     common_prefix + "max_ws_size";
+const std::string galera::ReplicatorSMM::Param::fragment_size =
+    common_prefix + "fragment_size";
 
-int const galera::ReplicatorSMM::MAX_PROTO_VER(9);
+int const galera::ReplicatorSMM::MAX_PROTO_VER(10);
 
 galera::ReplicatorSMM::Defaults::Defaults() : map_()
 {
@@ -38,6 +40,7 @@ galera::ReplicatorSMM::Defaults::Defaults() : map_()
     const int max_write_set_size(galera::WriteSetNG::MAX_SIZE);
     map_.insert(Default(Param::max_write_set_size,
                         gu::to_string(max_write_set_size)));
+    map_.insert(Default(Param::fragment_size, "0"));
 }
 
 const galera::ReplicatorSMM::Defaults galera::ReplicatorSMM::defaults;
@@ -155,6 +158,21 @@ galera::ReplicatorSMM::ParseOptions::ParseOptions(Replicator&       repl,
 }
 
 
+galera::KeySet::Version
+galera::ReplicatorSMM::key_format (KeySet::Version const ver) const
+{
+    /* compactly annotated key sets can't be parsed before protocol 10 */
+    if (KeySet::FLAT16AC == ver && protocol_version_ < 10)
+    {
+        log_info << "Key format " << Param::key_format << " = FLAT16AC "
+                 << "is not supported by protocol " << protocol_version_
+                 << ", using FLAT16A";
+        return KeySet::FLAT16A;
+    }
+
+    return ver;
+}
+
 /* helper for param_set() below */
 void
 galera::ReplicatorSMM::set_param (const std::string& key,
@@ -180,12 +198,16 @@ galera::ReplicatorSMM::set_param (const std::string& key,
     }
     else if (key == Param::key_format)
     {
-        trx_params_.key_format_ = KeySet::version(value);
+        trx_params_.key_format_ = key_format(KeySet::version(value));
     }
     else if (key == Param::max_write_set_size)
     {
         trx_params_.max_write_set_size_ = gu::from_string<int>(value);
     }
+    else if (key == Param::fragment_size)
+    {
+        fragment_size_ = gu::from_string<size_t>(value);
+    }
     else
     {
         log_warn << "parameter '" << key << "' not found";
@@ -237,6 +259,14 @@ galera::ReplicatorSMM::param_set (const std::string& key,
             found = true;
         }
         catch (gu::NotFound&) {}
+
+        try
+        {
+            ist_senders_.param_set (key, value);
+            config_.set (key, value);
+            found = true;
+        }
+        catch (gu::NotFound&) {}
     }
 
     if (!found) throw gu::NotFound();
@@ -2,6 +2,7 @@
 
 #include "replicator_smm.hpp"
 #include "uuid.hpp"
+#include "ist_compress.hpp"
 #include <gu_debug_sync.hpp>
 #include <gu_mem.h>
 
@@ -119,6 +120,32 @@ typedef enum status_vars
     STATS_CERT_INDEX_SIZE,
     STATS_CERT_BUCKET_COUNT,
     STATS_GCACHE_POOL_SIZE,
+    STATS_GCACHE_RB_RESIDENT,
+    STATS_GCACHE_RB_HUGEPAGES,
+    STATS_GCACHE_RB_LOCKED,
+    STATS_GCACHE_WRITE_RATE,
+    STATS_GCACHE_HISTORY_SECONDS,
+    STATS_GCACHE_IST_REQUESTS,
+    STATS_GCACHE_IST_MISSES,
+    STATS_GCACHE_IST_DEMAND_SECONDS,
+    STATS_GCACHE_RECOMMENDED_SIZE,
+    STATS_GCACHE_RECOMMENDED_HISTORY,
+    STATS_GCACHE_MALLOCS,
+    STATS_GCACHE_REALLOCS,
+    STATS_GCACHE_MALLOCS_MEM,
+    STATS_GCACHE_MALLOCS_RB,
+    STATS_GCACHE_MALLOCS_PAGE,
+    STATS_GCACHE_ALLOC_SIZES,
+    STATS_GCACHE_RB_USED,
+    STATS_GCACHE_RB_FREE,
+    STATS_GCACHE_RB_TRAIL,
+    STATS_GCACHE_RB_WRAPS,
+    STATS_GCACHE_PAGES,
+    STATS_GCACHE_PAGES_CREATED,
+    STATS_GCACHE_PAGES_DELETED,
+    STATS_GCACHE_SEQNO_HITS,
+    STATS_GCACHE_SEQNO_COLD_HITS,
+    STATS_GCACHE_SEQNO_MISSES,
     STATS_CAUSAL_READS,
     STATS_CERT_INTERVAL,
     STATS_OPEN_TRX,
@@ -127,6 +154,27 @@ typedef enum status_vars
     STATS_IST_RECEIVE_SEQNO_START,
     STATS_IST_RECEIVE_SEQNO_CURRENT,
     STATS_IST_RECEIVE_SEQNO_END,
+    STATS_IST_RECEIVE_QUEUE_LEN,
+    STATS_IST_RECEIVE_QUEUE_BYTES,
+    STATS_IST_RECEIVE_WRITE_SETS,
+    STATS_IST_RECEIVE_BYTES,
+    STATS_IST_RECEIVE_RATE,
+    STATS_IST_RECEIVE_RATE_AVG,
+    STATS_IST_RECEIVE_APPLY_LAG,
+    STATS_IST_RECEIVE_ETA,
+    STATS_IST_SEND_ACTIVE,
+    STATS_IST_SEND_SEQNO_START,
+    STATS_IST_SEND_SEQNO_CURRENT,
+    STATS_IST_SEND_SEQNO_END,
+    STATS_IST_SEND_WRITE_SETS,
+    STATS_IST_SEND_BYTES,
+    STATS_IST_SEND_RATE,
+    STATS_IST_SEND_RATE_AVG,
+    STATS_IST_SEND_ETA,
+    STATS_IST_COMPRESSION_RAW,
+    STATS_IST_COMPRESSION_BYTES,
+    STATS_IST_COMPRESSION_RATIO,
+    STATS_IST_COMPRESSION_RATE,
     STATS_INCOMING_LIST,
     STATS_MAX
 } StatusVars;
@@ -178,6 +226,32 @@ static const struct wsrep_stats_var wsrep_stats[STATS_MAX + 1] =
     { "cert_index_size",          WSREP_VAR_INT64,  { 0 }  },
     { "cert_bucket_count",        WSREP_VAR_INT64,  { 0 }  },
     { "gcache_pool_size",         WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_resident",       WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_hugepages",      WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_locked",         WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_write_rate",        WSREP_VAR_DOUBLE, { 0 }  },
+    { "gcache_history_seconds",   WSREP_VAR_DOUBLE, { 0 }  },
+    { "gcache_ist_requests",      WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_ist_misses",        WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_ist_demand_seconds",WSREP_VAR_DOUBLE, { 0 }  },
+    { "gcache_recommended_size",  WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_recommended_history",WSREP_VAR_DOUBLE,{ 0 }  },
+    { "gcache_mallocs",           WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_reallocs",          WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_mallocs_mem",       WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_mallocs_rb",        WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_mallocs_page",      WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_alloc_sizes",       WSREP_VAR_STRING, { 0 }  },
+    { "gcache_rb_used",           WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_free",           WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_trail",          WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_rb_wraps",          WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_pages",             WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_pages_created",     WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_pages_deleted",     WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_seqno_hits",        WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_seqno_cold_hits",   WSREP_VAR_INT64,  { 0 }  },
+    { "gcache_seqno_misses",      WSREP_VAR_INT64,  { 0 }  },
     { "causal_reads",             WSREP_VAR_INT64,  { 0 }  },
     { "cert_interval",            WSREP_VAR_DOUBLE, { 0 }  },
     { "open_transactions",        WSREP_VAR_INT64,  { 0 }  },
@@ -186,6 +260,27 @@ static const struct wsrep_stats_var wsrep_stats[STATS_MAX + 1] =
     { "ist_receive_seqno_start",  WSREP_VAR_INT64,  { 0 }  },
     { "ist_receive_seqno_current",WSREP_VAR_INT64,  { 0 }  },
     { "ist_receive_seqno_end",    WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_queue_len",    WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_queue_bytes",  WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_write_sets",   WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_bytes",        WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_rate",         WSREP_VAR_DOUBLE, { 0 }  },
+    { "ist_receive_rate_avg",     WSREP_VAR_DOUBLE, { 0 }  },
+    { "ist_receive_apply_lag",    WSREP_VAR_INT64,  { 0 }  },
+    { "ist_receive_eta",          WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_active",          WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_seqno_start",     WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_seqno_current",   WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_seqno_end",       WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_write_sets",      WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_bytes",           WSREP_VAR_INT64,  { 0 }  },
+    { "ist_send_rate",            WSREP_VAR_DOUBLE, { 0 }  },
+    { "ist_send_rate_avg",        WSREP_VAR_DOUBLE, { 0 }  },
+    { "ist_send_eta",             WSREP_VAR_INT64,  { 0 }  },
+    { "ist_compression_raw_bytes",WSREP_VAR_INT64,  { 0 }  },
+    { "ist_compression_bytes",    WSREP_VAR_INT64,  { 0 }  },
+    { "ist_compression_ratio",    WSREP_VAR_DOUBLE, { 0 }  },
+    { "ist_compression_rate",     WSREP_VAR_DOUBLE, { 0 }  },
     { "incoming_addresses",       WSREP_VAR_STRING, { 0 }  },
     { 0,                          WSREP_VAR_STRING, { 0 }  }
 };
@@ -268,6 +363,53 @@ galera::ReplicatorSMM::stats_get()
 
     sv[STATS_GCACHE_POOL_SIZE    ].value._int64 = gcache_.allocated_pool_size();
 
+    // ring buffer pages not yet resident will fault on access, pages
+    // not mapped with huge pages cost TLB entries
+    gu::MMap::Stats rb_st;
+    gcache_.rb_mmap_stats(rb_st);
+    sv[STATS_GCACHE_RB_RESIDENT  ].value._int64 = rb_st.resident;
+    sv[STATS_GCACHE_RB_HUGEPAGES ].value._int64 = rb_st.hugepages;
+    sv[STATS_GCACHE_RB_LOCKED    ].value._int64 = rb_st.locked;
+
+    // history needed to serve IST requests seen lately and what it takes
+    // to keep it, see gcache::Advisor
+    gcache::GCache::Advice advice;
+    gcache_.advice(advice);
+    sv[STATS_GCACHE_WRITE_RATE         ].value._double = advice.write_rate;
+    sv[STATS_GCACHE_HISTORY_SECONDS    ].value._double = advice.history_time;
+    sv[STATS_GCACHE_IST_REQUESTS       ].value._int64  = advice.ist_requests;
+    sv[STATS_GCACHE_IST_MISSES         ].value._int64  = advice.ist_misses;
+    sv[STATS_GCACHE_IST_DEMAND_SECONDS ].value._double = advice.demand_time;
+    sv[STATS_GCACHE_RECOMMENDED_SIZE   ].value._int64  =
+        advice.recommended_size;
+    sv[STATS_GCACHE_RECOMMENDED_HISTORY].value._double =
+        advice.recommended_time;
+
+    // allocations by store and size, ring buffer fragmentation (space
+    // neither used nor free holds released history), page turnover and
+    // history lookups
+    gcache::GCache::Stats gc_st;
+    gcache_.stats(gc_st);
+    sv[STATS_GCACHE_MALLOCS        ].value._int64 = gc_st.mallocs;
+    sv[STATS_GCACHE_REALLOCS       ].value._int64 = gc_st.reallocs;
+    sv[STATS_GCACHE_MALLOCS_MEM    ].value._int64 = gc_st.mallocs_mem;
+    sv[STATS_GCACHE_MALLOCS_RB     ].value._int64 = gc_st.mallocs_rb;
+    sv[STATS_GCACHE_MALLOCS_PAGE   ].value._int64 = gc_st.mallocs_page;
+    strncpy(gcache_alloc_sizes_, gc_st.alloc_sizes.c_str(),
+            sizeof(gcache_alloc_sizes_) - 1);
+    gcache_alloc_sizes_[sizeof(gcache_alloc_sizes_) - 1] = '\0';
+    sv[STATS_GCACHE_ALLOC_SIZES    ].value._string = gcache_alloc_sizes_;
+    sv[STATS_GCACHE_RB_USED        ].value._int64 = gc_st.rb_used;
+    sv[STATS_GCACHE_RB_FREE        ].value._int64 = gc_st.rb_free;
+    sv[STATS_GCACHE_RB_TRAIL       ].value._int64 = gc_st.rb_trail;
+    sv[STATS_GCACHE_RB_WRAPS       ].value._int64 = gc_st.rb_wraps;
+    sv[STATS_GCACHE_PAGES          ].value._int64 = gc_st.pages;
+    sv[STATS_GCACHE_PAGES_CREATED  ].value._int64 = gc_st.pages_created;
+    sv[STATS_GCACHE_PAGES_DELETED  ].value._int64 = gc_st.pages_deleted;
+    sv[STATS_GCACHE_SEQNO_HITS     ].value._int64 = gc_st.seqno_hits;
+    sv[STATS_GCACHE_SEQNO_COLD_HITS].value._int64 = gc_st.seqno_cold_hits;
+    sv[STATS_GCACHE_SEQNO_MISSES   ].value._int64 = gc_st.seqno_misses;
+
     double oooe;
     double oool;
     double win;
@@ -317,6 +459,22 @@ galera::ReplicatorSMM::stats_get()
         sv[STATS_IST_RECEIVE_SEQNO_START].value._int64 = first;
         sv[STATS_IST_RECEIVE_SEQNO_CURRENT].value._int64 = current;
         sv[STATS_IST_RECEIVE_SEQNO_END].value._int64 = last;
+
+        size_t queue_len, queue_bytes;
+        ist_receiver_.queue_stats(queue_len, queue_bytes);
+        sv[STATS_IST_RECEIVE_QUEUE_LEN].value._int64 = queue_len;
+        sv[STATS_IST_RECEIVE_QUEUE_BYTES].value._int64 = queue_bytes;
+
+        ist::ProgressMeter::Status st;
+        ist_receiver_.progress(st);
+        sv[STATS_IST_RECEIVE_WRITE_SETS].value._int64 = st.write_sets;
+        sv[STATS_IST_RECEIVE_BYTES].value._int64 = st.bytes;
+        sv[STATS_IST_RECEIVE_RATE].value._double = st.rate;
+        sv[STATS_IST_RECEIVE_RATE_AVG].value._double = st.rate_avg;
+        // received but not yet applied
+        sv[STATS_IST_RECEIVE_APPLY_LAG].value._int64 =
+            std::max(current - apply_monitor_.last_left(), wsrep_seqno_t(0));
+        sv[STATS_IST_RECEIVE_ETA].value._int64 = st.eta;
     }
     else
     {
@@ -324,8 +482,45 @@ galera::ReplicatorSMM::stats_get()
         sv[STATS_IST_RECEIVE_SEQNO_START].value._int64 = 0;
         sv[STATS_IST_RECEIVE_SEQNO_CURRENT].value._int64 = 0;
         sv[STATS_IST_RECEIVE_SEQNO_END].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_QUEUE_LEN].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_QUEUE_BYTES].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_WRITE_SETS].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_BYTES].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_RATE].value._double = 0;
+        sv[STATS_IST_RECEIVE_RATE_AVG].value._double = 0;
+        sv[STATS_IST_RECEIVE_APPLY_LAG].value._int64 = 0;
+        sv[STATS_IST_RECEIVE_ETA].value._int64 = 0;
+    }
+
+    // IST donor side: totals over all joiners and stripes being served
+    {
+        ist::ProgressMeter::Status st;
+        int const active(ist_senders_.progress(st));
+        sv[STATS_IST_SEND_ACTIVE].value._int64 = active;
+        sv[STATS_IST_SEND_SEQNO_START].value._int64 = st.first;
+        sv[STATS_IST_SEND_SEQNO_CURRENT].value._int64 = st.current;
+        sv[STATS_IST_SEND_SEQNO_END].value._int64 = st.last;
+        sv[STATS_IST_SEND_WRITE_SETS].value._int64 = st.write_sets;
+        sv[STATS_IST_SEND_BYTES].value._int64 = st.bytes;
+        sv[STATS_IST_SEND_RATE].value._double = st.rate;
+        sv[STATS_IST_SEND_RATE_AVG].value._double = st.rate_avg;
+        sv[STATS_IST_SEND_ETA].value._int64 = active > 0 ? st.eta : 0;
     }
 
+    // IST (de)compression totals, ratio is raw to compressed and rate is
+    // raw bytes (de)compressed per second
+    const ist::Compressor::Stats& ist_cs(ist_senders_.compression_stats());
+    const ist::Compressor::Stats& ist_ds(ist_receiver_.compression_stats());
+    long long const ist_raw(ist_cs.raw() + ist_ds.raw());
+    long long const ist_compressed(ist_cs.compressed() + ist_ds.compressed());
+    long long const ist_nsec(ist_cs.nsec() + ist_ds.nsec());
+    sv[STATS_IST_COMPRESSION_RAW  ].value._int64  = ist_raw;
+    sv[STATS_IST_COMPRESSION_BYTES].value._int64  = ist_compressed;
+    sv[STATS_IST_COMPRESSION_RATIO].value._double = ist_compressed > 0 ?
+        double(ist_raw) / ist_compressed : 0.;
+    sv[STATS_IST_COMPRESSION_RATE ].value._double = ist_nsec > 0 ?
+        double(ist_raw) * 1.0e9 / ist_nsec : 0.;
+
     // Get gcs backend status
     gu::Status status;
     gcs_.get_status(status);
@@ -489,6 +489,9 @@ void ReplicatorSMM::process_state_req(void*       recv_ctx,
                     log_error << "Failed to bypass SST";
                 }
 
+                // senders hold their own locks by now
+                gcache_.seqno_unlock();
+
                 goto out;
             }
         }
@@ -952,6 +955,12 @@ ReplicatorSMM::request_state_transfer (void* recv_ctx,
             // provide actions that have already been applied.
             apply_monitor_.drain(sst_seqno_);
             log_info << "IST received: " << state_uuid_ << ":" << sst_seqno_;
+
+            // fragments of streaming trxs that were not committed before
+            // the configuration change are discarded by the rest of the group
+            TrxHandle::Fragments frags;
+            fragments_.clear(frags);
+            release_fragments(frags);
         }
         else
         {
@@ -984,6 +993,36 @@ ReplicatorSMM::request_state_transfer (void* recv_ctx,
 }
 
 
+/* IST stream broke before all write sets were received. Instead of marking
+ * the state corrupt (which would require SST on restart), let appliers finish
+ * with write sets already delivered and save the position reached, so that
+ * after restart only the rest of the range is requested in IST from any
+ * donor which still has it in gcache. Several applier threads may get here
+ * at the same time, they all save the same position. */
+void ReplicatorSMM::IST_interrupted(int const err)
+{
+    wsrep_seqno_t const last(ist_receiver_.delivered_seqno());
+
+    log_error << "receiving IST failed: " << err << " (" << strerror(err)
+              << "). Waiting for received write sets up to " << last
+              << " to be applied.";
+
+    apply_monitor_.drain(last);
+    if (co_mode_ != CommitOrder::BYPASS) commit_monitor_.drain(last);
+
+    st_.set(state_uuid_, last, safe_to_bootstrap_);
+
+    log_fatal << "IST was interrupted, node restart required. State saved at "
+              << state_uuid_ << ':' << last << ", IST will resume from "
+              << last + 1 << " after restart.";
+    abort();
+}
+
+
+/* Called by the thread which requested state transfer and by all other slave
+ * threads which find their GCS receive cancelled by the configuration change
+ * (see async_recv()). So IST write sets are parsed and applied in parallel,
+ * ordered by apply_monitor_ according to dependencies computed by donor. */
 void ReplicatorSMM::recv_IST(void* recv_ctx)
 {
     bool first= true;
@@ -1041,10 +1080,20 @@ void ReplicatorSMM::recv_IST(void* recv_ctx)
                     // processed on donor, just adjust states here
                     trx->set_state(TrxHandle::S_REPLICATING);
                     trx->set_state(TrxHandle::S_CERTIFYING);
+                    if (trx->is_streaming())
+                    {
+                        // fragments must be collected in order
+                        trx->set_depends_seqno(trx->global_seqno() - 1);
+                    }
                     apply_trx(recv_ctx, trx);
                     GU_DBUG_SYNC_WAIT("recv_IST_after_apply_trx");
                 }
             }
+            else if (err != EINTR)
+            {
+                // the stream broke, write sets handed over so far are fine
+                IST_interrupted(err);
+            }
             else
             {
                 // IST completed after applying n transactions where n can be 0.
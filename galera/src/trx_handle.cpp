@@ -303,6 +303,12 @@ galera::TrxHandle::apply (void*                   recv_ctx,
 {
     wsrep_cb_status_t err(WSREP_CB_SUCCESS);
 
+    /* data of the preceding fragments of streaming trx goes first */
+    for (size_t i(0); i < fragments_.size(); ++i)
+    {
+        fragments_[i]->apply(recv_ctx, apply_cb, meta);
+    }
+
     if (new_version())
     {
         const DataSetIn& ws(write_set_in_.dataset());
@@ -363,6 +369,11 @@ void
 galera::TrxHandle::unordered(void*                recv_ctx,
                              wsrep_unordered_cb_t cb) const
 {
+    for (size_t i(0); i < fragments_.size(); ++i)
+    {
+        fragments_[i]->unordered(recv_ctx, cb);
+    }
+
     if (new_version() && NULL != cb && write_set_in_.unrdset().count() > 0)
     {
         const DataSetIn& unrd(write_set_in_.unrdset());
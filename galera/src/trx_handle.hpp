@@ -24,6 +24,7 @@
 #include "gu_limits.h" // page size stuff
 
 #include <set>
+#include <vector>
 
 namespace galera
 {
@@ -77,7 +78,10 @@ namespace galera
             F_ANNOTATION  = 1 << 5,
             F_ISOLATION   = 1 << 6,
             F_PA_UNSAFE   = 1 << 7,
-            F_PREORDERED  = 1 << 8
+            F_PREORDERED  = 1 << 8,
+            F_BEGIN       = 1 << 9,
+            F_STREAMING   = 1 << 10,
+            F_COMMUTATIVE = 1 << 11
         };
 
         static inline uint32_t wsrep_flags_to_trx_flags (uint32_t flags)
@@ -91,6 +95,7 @@ namespace galera
 
             if (flags & WSREP_FLAG_ISOLATION)   ret |= F_ISOLATION;
             if (flags & WSREP_FLAG_PA_UNSAFE)   ret |= F_PA_UNSAFE;
+            if (flags & WSREP_FLAG_COMMUTATIVE) ret |= F_COMMUTATIVE;
 
             return ret;
         }
@@ -106,6 +111,7 @@ namespace galera
 
             if (flags & F_ISOLATION)   ret |= WSREP_FLAG_ISOLATION;
             if (flags & F_PA_UNSAFE)   ret |= WSREP_FLAG_PA_UNSAFE;
+            if (flags & F_COMMUTATIVE) ret |= WSREP_FLAG_COMMUTATIVE;
 
             return ret;
         }
@@ -121,6 +127,9 @@ namespace galera
 
             if (flags & WriteSetNG::F_TOI)       ret |= F_ISOLATION;
             if (flags & WriteSetNG::F_PA_UNSAFE) ret |= F_PA_UNSAFE;
+            if (flags & WriteSetNG::F_BEGIN)     ret |= F_BEGIN;
+            if (flags & WriteSetNG::F_STREAMING) ret |= F_STREAMING;
+            if (flags & WriteSetNG::F_COMMUTATIVE) ret |= F_COMMUTATIVE;
 
             return ret;
         }
@@ -150,6 +159,27 @@ namespace galera
             return ((write_set_flags_ & F_PREORDERED) != 0);
         }
 
+        bool is_streaming() const
+        {
+            return ((write_set_flags_ & F_STREAMING) != 0);
+        }
+
+        /* changes of the trx commute with changes of other commutative trxs
+         * (e.g. counter increments), TOI is never commutative */
+        bool is_commutative() const
+        {
+            return ((write_set_flags_ & (F_COMMUTATIVE | F_ISOLATION)) ==
+                    F_COMMUTATIVE);
+        }
+
+        /* intermediate fragment of a streaming trx, carries no commit
+         * or rollback decision */
+        bool is_fragment() const
+        {
+            return (is_streaming() &&
+                    (write_set_flags_ & (F_COMMIT | F_ROLLBACK)) == 0);
+        }
+
         typedef enum
         {
             S_EXECUTING,
@@ -361,6 +391,10 @@ namespace galera
                 uint16_t ws_flags(flags & COMMON_FLAGS_MASK);
                 if (flags & F_ISOLATION) ws_flags |= WriteSetNG::F_TOI;
                 if (flags & F_PA_UNSAFE) ws_flags |= WriteSetNG::F_PA_UNSAFE;
+                if (flags & F_BEGIN)     ws_flags |= WriteSetNG::F_BEGIN;
+                if (flags & F_STREAMING) ws_flags |= WriteSetNG::F_STREAMING;
+                if (flags & F_COMMUTATIVE)
+                    ws_flags |= WriteSetNG::F_COMMUTATIVE;
                 write_set_out().set_flags(ws_flags);
             }
         }
@@ -642,6 +676,32 @@ namespace galera
             }
         }
 
+        /* Slave handles of the already replicated fragments of a streaming
+         * trx. On the originator these are the fragments it has sent, on
+         * the receivers they are attached to the committing write set. In
+         * both cases the references are owned by this handle. */
+        typedef std::vector<TrxHandle*> Fragments;
+
+        Fragments&       fragments()       { return fragments_; }
+        const Fragments& fragments() const { return fragments_; }
+
+        /* Starts a new fragment: replaces the contents of the replicated
+         * WriteSetOut with an empty one. Local trx only. */
+        void next_fragment(const Params& params)
+        {
+            assert(local_);
+            assert(new_version());
+            assert(params.version_ == version_);
+
+            release_write_set_out();
+            wso_ = true;
+
+            gu::byte_t* const store(reinterpret_cast<gu::byte_t*>(this + 1));
+            init_write_set_out(params, store,
+                               mem_pool_.buf_size() - sizeof(TrxHandle));
+            set_flags(write_set_flags_ & ~(F_BEGIN | F_STREAMING));
+        }
+
     private:
 
         static uint32_t const COMMON_FLAGS_MASK = 0x03;
@@ -682,7 +742,8 @@ namespace galera
             interim_committed_ (false),
             exit_loop_         (false),
             wso_               (false),
-            mac_               ()
+            mac_               (),
+            fragments_         ()
         {}
 
         /* local trx ctor */
@@ -726,12 +787,21 @@ namespace galera
             interim_committed_ (false),
             exit_loop_         (false),
             wso_               (new_version()),
-            mac_               ()
+            mac_               (),
+            fragments_         ()
         {
             init_write_set_out(params, reserved, reserved_size);
         }
 
-        ~TrxHandle() { if (wso_) release_write_set_out(); }
+        ~TrxHandle()
+        {
+            if (wso_) release_write_set_out();
+
+            for (size_t i(0); i < fragments_.size(); ++i)
+            {
+                fragments_[i]->unref();
+            }
+        }
 
         void
         init_write_set_out(const Params& params,
@@ -801,6 +871,7 @@ namespace galera
         bool                   exit_loop_;
         bool                   wso_;
         Mac                    mac_;
+        Fragments              fragments_;
 
         friend class Wsdb;
         friend class Certification;
@@ -209,7 +209,16 @@ WriteSetIn::init (ssize_t const st)
 
     if (gu_likely(st > 0)) /* checksum enforced */
     {
+        bool located(false);
+
         if (size_ >= st)
+        {
+            /* locate the sets in foreground so that the checksum thread does
+             * not race with accessors, failure is reported by checksum() */
+            try { parse_sets(); located = true; } catch (std::exception&) {}
+        }
+
+        if (located)
         {
             /* buffer too big, start checksumming in background */
             int const err(gu_thread_create (&check_thr_id_, NULL,
@@ -238,62 +247,85 @@ WriteSetIn::init (ssize_t const st)
 
 
 void
-WriteSetIn::checksum()
+WriteSetIn::parse_sets() const
 {
+    if (parsed_) return;
+
     const gu::byte_t* pptr (header_.payload());
     ssize_t           psize(size_ - header_.size());
 
     assert (psize >= 0);
 
-    try
+    if (keys_.size() > 0)
     {
-        if (keys_.size() > 0)
+        size_t const tmpsize(keys_.serial_size());
+        psize -= tmpsize;
+        pptr  += tmpsize;
+        assert (psize >= 0);
+    }
+
+    DataSet::Version const dver(header_.dataset_ver());
+
+    if (gu_likely(dver != DataSet::EMPTY))
+    {
+        assert (psize > 0);
+        gu_trace(data_.init(dver, pptr, psize));
+        size_t const tmpsize(data_.serial_size());
+        psize -= tmpsize;
+        pptr  += tmpsize;
+        assert (psize >= 0);
+
+        if (header_.has_unrd())
         {
-            gu_trace(keys_.checksum());
-            size_t const tmpsize(keys_.serial_size());
+            gu_trace(unrd_.init(dver, pptr, psize));
+            size_t const tmpsize(unrd_.serial_size());
             psize -= tmpsize;
             pptr  += tmpsize;
             assert (psize >= 0);
         }
 
-        DataSet::Version const dver(header_.dataset_ver());
+        if (header_.has_annt())
+        {
+            if (NULL == annt_) annt_ = new DataSetIn();
+            gu_trace(annt_->init(dver, pptr, psize));
+#ifndef NDEBUG
+            psize -= annt_->serial_size();
+#endif
+        }
+    }
+#ifndef NDEBUG
+    assert (psize >= 0);
+    assert (size_t(psize) < gcache::MemOps::ALIGNMENT);
+#endif
+    parsed_ = true;
+}
+
+
+void
+WriteSetIn::checksum()
+{
+    try
+    {
+        if (keys_.size() > 0)
+        {
+            gu_trace(keys_.checksum());
+        }
+
+        gu_trace(parse_sets());
 
-        if (gu_likely(dver != DataSet::EMPTY))
+        if (gu_likely(header_.dataset_ver() != DataSet::EMPTY))
         {
-            assert (psize > 0);
-            gu_trace(data_.init(dver, pptr, psize));
             gu_trace(data_.checksum());
-            size_t const tmpsize(data_.serial_size());
-            psize -= tmpsize;
-            pptr  += tmpsize;
-            assert (psize >= 0);
 
             if (header_.has_unrd())
             {
-                gu_trace(unrd_.init(dver, pptr, psize));
                 gu_trace(unrd_.checksum());
-                size_t const tmpsize(unrd_.serial_size());
-                psize -= tmpsize;
-                pptr  += tmpsize;
-                assert (psize >= 0);
             }
 
-            if (header_.has_annt())
-            {
-                annt_ = new DataSetIn();
-                gu_trace(annt_->init(dver, pptr, psize));
-                // we don't care for annotation checksum - it is not a reason
-                // to throw an exception and abort execution
-                // gu_trace(annt_->checksum());
-#ifndef NDEBUG
-                psize -= annt_->serial_size();
-#endif
-            }
+            // we don't care for annotation checksum - it is not a reason
+            // to throw an exception and abort execution
         }
-#ifndef NDEBUG
-        assert (psize >= 0);
-        assert (size_t(psize) < gcache::MemOps::ALIGNMENT);
-#endif
+
         check_ = true;
     }
     catch (std::exception& e)
@@ -310,6 +342,9 @@ WriteSetIn::checksum()
 void
 WriteSetIn::write_annotation(std::ostream& os) const
 {
+    parse_sets();
+    assert (annt_ != NULL);
+
     annt_->rewind();
     ssize_t const count(annt_->count());
 
@@ -334,6 +369,8 @@ WriteSetIn::gather(GatherVector& out,
     }
     else
     {
+        parse_sets();
+
         out->reserve(out->size() + 4);
 
         gu::Buf buf(header_.copy(include_keys, include_unrd));
@@ -104,7 +104,10 @@ namespace galera
             F_TOI         = 1 << 2,
             F_PA_UNSAFE   = 1 << 3,
             F_COMMUTATIVE = 1 << 4,
-            F_NATIVE      = 1 << 5
+            F_NATIVE      = 1 << 5,
+            /* not exposed to wsrep API: fragments of streaming trx */
+            F_BEGIN       = 1 << 6, // first fragment of a streaming trx
+            F_STREAMING   = 1 << 7  // write set is a part of streaming trx
         };
 
         /* this takes care of converting wsrep API flags to on-the-wire flags */
@@ -558,6 +561,13 @@ namespace galera
                      (annt_ ? annt_->count() : 0)) == 0);
         }
 
+        /* approximate size of the serialized writeset payload */
+        size_t size() const
+        {
+            return (keys_.size() + data_.size() + unrd_.size() +
+                    (annt_ ? annt_->size() : 0));
+        }
+
 
         /* !!! This returns header without checksum! *
          *     Use set_last_seen() to finalize it.   */
@@ -572,8 +582,17 @@ namespace galera
                           + unrd_.page_count() + 1 /* global header */);
 
 
-            size_t out_size (header_.gather (keys_.version(),
-                                             data_.version(),
+            /* empty record sets are not gathered, so they must not be
+             * advertised in the header either (e.g. streaming trx rollback
+             * write set carries neither keys nor data) */
+            KeySet::Version const kver
+                (keys_.count() > 0 ? keys_.version() : KeySet::EMPTY);
+            DataSet::Version const dver
+                ((data_.count() > 0 || unrd_.count() > 0 || NULL != annt_) ?
+                 data_.version() : DataSet::EMPTY);
+
+            size_t out_size (header_.gather (kver,
+                                             dver,
                                              unrd_.version() != DataSet::EMPTY,
                                              NULL != annt_,
                                              flags_, source, conn, trx,
@@ -681,6 +700,7 @@ namespace galera
               data_  (),
               unrd_  (),
               annt_  (NULL),
+              parsed_(false),
               check_thr_id_(),
               check_thr_(false),
               check_ (false)
@@ -695,6 +715,7 @@ namespace galera
               data_  (),
               unrd_  (),
               annt_  (NULL),
+              parsed_(false),
               check_thr_id_(),
               check_thr_(false),
               check_ (false)
@@ -746,11 +767,14 @@ namespace galera
         wsrep_conn_id_t     conn_id()   const { return header_.conn_id();   }
         wsrep_trx_id_t      trx_id()    const { return header_.trx_id();    }
 
+        /* keyset is parsed right away for certification, the rest of the
+         * sections are located on first access */
         const KeySetIn&  keyset()  const { return keys_; }
-        const DataSetIn& dataset() const { return data_; }
-        const DataSetIn& unrdset() const { return unrd_; }
+        const DataSetIn& dataset() const { parse_sets(); return data_; }
+        const DataSetIn& unrdset() const { parse_sets(); return unrd_; }
 
-        bool annotated() const { return (annt_ != NULL); }
+        bool annotated() const
+        { return (size_ > 0 && header_.anntset_ver() != DataSet::EMPTY); }
         void write_annotation(std::ostream& os) const;
 
         /* This should be called right after certification verdict is obtained
@@ -770,6 +794,7 @@ namespace galera
         {
             /* since data segment is the only thing that definitely stays
              * unchanged through WS lifetime, it is the WS signature */
+            parse_sets();
             return (data_.get_checksum());
         }
 
@@ -797,9 +822,10 @@ namespace galera
         WriteSetNG::Header header_;
         ssize_t            size_;
         KeySetIn           keys_;
-        DataSetIn          data_;
-        DataSetIn          unrd_;
-        DataSetIn*         annt_;
+        DataSetIn mutable  data_;
+        DataSetIn mutable  unrd_;
+        DataSetIn mutable* annt_;
+        bool mutable       parsed_;  // data_, unrd_ and annt_ are located
         gu_thread_t        check_thr_id_;
         bool mutable       check_thr_;
         bool               check_;
@@ -808,6 +834,10 @@ namespace galera
 
         void checksum (); /* checksums writeset, stores result in check_ */
 
+        /* locates sections following the keyset in the buffer, nothing
+         * is copied or checksummed */
+        void parse_sets () const;
+
         void checksum_fin() const
         {
             if (gu_unlikely(!check_))
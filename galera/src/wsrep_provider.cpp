@@ -816,7 +816,7 @@ wsrep_status_t galera_append_data(wsrep_t*                const wsrep,
         TrxHandleLock lock(*trx);
         if (WSREP_DATA_ORDERED == type)
             append_data_array(trx, data, count, type, copy);
-        retval = WSREP_OK;
+        retval = repl->flush_fragment(trx);
     }
     catch (std::exception& e)
     {
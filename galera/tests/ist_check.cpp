@@ -5,11 +5,14 @@
 
 #include "ist.hpp"
 #include "ist_proto.hpp"
+#include "ist_progress.hpp"
+#include "ist_rate_limiter.hpp"
 #include "trx_handle.hpp"
 #include "uuid.hpp"
 #include "monitor.hpp"
 #include "GCache.hpp"
 #include "gu_arch.h"
+#include "gu_time.h"
 #include "replicator_smm.hpp"
 #include <check.h>
 
@@ -66,6 +69,10 @@ END_TEST
 
 static gu_barrier_t start_barrier;
 
+// (de)compression totals of senders and receivers
+static galera::ist::Compressor::Stats send_comp_stats;
+static galera::ist::Compressor::Stats recv_comp_stats;
+
 class TestOrder
 {
 public:
@@ -92,16 +99,20 @@ struct sender_args
     wsrep_seqno_t first_;
     wsrep_seqno_t last_;
     int version_;
+    int stripe_;
+    int stripes_;
     sender_args(gcache::GCache& gcache,
                 const std::string& peer,
                 wsrep_seqno_t first, wsrep_seqno_t last,
-                int version)
+                int version, int stripes = 1)
         :
         gcache_(gcache),
         peer_  (peer),
         first_ (first),
         last_  (last),
-        version_(version)
+        version_(version),
+        stripe_ (0),
+        stripes_(stripes)
     { }
 };
 
@@ -114,17 +125,26 @@ struct receiver_args
     size_t        n_receivers_;
     TrxHandle::SlavePool& trx_pool_;
     int           version_;
+    int           stripes_;
+    bool          compress_;
+    wsrep_seqno_t sent_last_; // donor stops after it
+    wsrep_seqno_t delivered_; // set by receiver_thd()
 
     receiver_args(const std::string listen_addr,
                   wsrep_seqno_t first, wsrep_seqno_t last,
-                  size_t n_receivers, TrxHandle::SlavePool& sp, int version)
+                  size_t n_receivers, TrxHandle::SlavePool& sp, int version,
+                  int stripes = 1, bool compress = false)
         :
         listen_addr_(listen_addr),
         first_      (first),
         last_       (last),
         n_receivers_(n_receivers),
         trx_pool_   (sp),
-        version_    (version)
+        version_    (version),
+        stripes_    (stripes),
+        compress_   (compress),
+        sent_last_  (last),
+        delivered_  (-1)
     { }
 };
 
@@ -144,22 +164,46 @@ struct trx_thread_args
     { }
 };
 
-extern "C" void* sender_thd(void* arg)
+extern "C" void* stripe_sender_thd(void* arg)
 {
-    mark_point();
-
     const sender_args* sargs(reinterpret_cast<const sender_args*>(arg));
 
     gu::Config conf;
     galera::ReplicatorSMM::InitConfig(conf, NULL, NULL);
-    gu_barrier_wait(&start_barrier);
+    sargs->gcache_.seqno_lock(sargs->first_ + sargs->stripe_);
     galera::ist::Sender sender(conf, sargs->gcache_, sargs->peer_,
-                               sargs->version_);
+                               sargs->version_, sargs->stripe_,
+                               sargs->stripes_, 0, &send_comp_stats);
     mark_point();
     sender.send(sargs->first_, sargs->last_);
     return 0;
 }
 
+extern "C" void* sender_thd(void* arg)
+{
+    mark_point();
+
+    const sender_args* sargs(reinterpret_cast<const sender_args*>(arg));
+
+    gu_barrier_wait(&start_barrier);
+
+    std::vector<sender_args> stripes(sargs->stripes_, *sargs);
+    std::vector<gu_thread_t> threads(stripes.size());
+
+    for (size_t i(0); i < stripes.size(); ++i)
+    {
+        stripes[i].stripe_ = i;
+        gu_thread_create(&threads[i], 0, &stripe_sender_thd, &stripes[i]);
+    }
+
+    for (size_t i(0); i < threads.size(); ++i)
+    {
+        gu_thread_join(threads[i], 0);
+    }
+
+    return 0;
+}
+
 extern "C" void* trx_thread(void* arg)
 {
     trx_thread_args* targs(reinterpret_cast<trx_thread_args*>(arg));
@@ -196,6 +240,10 @@ extern "C" void* receiver_thd(void* arg)
     mark_point();
 
     conf.set(galera::ist::Receiver::RECV_ADDR, rargs->listen_addr_);
+    conf.set("ist.stripes", gu::to_string(rargs->stripes_));
+    conf.set("ist.compress", rargs->compress_ ? "yes" : "no");
+    // small enough for the reader to wait for consumers in some tests
+    conf.set("ist.recv_queue_size", "64K");
     galera::ist::Receiver receiver(conf, rargs->trx_pool_, 0);
     rargs->listen_addr_ = receiver.prepare(rargs->first_, rargs->last_,
                                            rargs->version_);
@@ -212,14 +260,47 @@ extern "C" void* receiver_thd(void* arg)
 
     trx_thd_args.monitor_.set_initial_position(rargs->first_ - 1);
     gu_barrier_wait(&start_barrier);
-    trx_thd_args.monitor_.wait(rargs->last_);
+    trx_thd_args.monitor_.wait(rargs->sent_last_);
 
+    bool const complete(rargs->sent_last_ == rargs->last_);
+
+    // all write sets sent must have been handed over, and the stream
+    // must have broken if it was cut short
     for (size_t i(0); i < threads.size(); ++i)
     {
         log_info << "joining trx thread " << i;
         gu_thread_join(threads[i], 0);
     }
 
+    rargs->delivered_ = receiver.delivered_seqno();
+    fail_if(rargs->delivered_ != rargs->sent_last_,
+            "delivered %lld, expected %lld",
+            static_cast<long long>(rargs->delivered_),
+            static_cast<long long>(rargs->sent_last_));
+    fail_if((receiver.error() == 0) != complete, "error %d",
+            receiver.error());
+
+    if (!complete)
+    {
+        receiver.finished();
+        return 0;
+    }
+
+    size_t queue_len, queue_bytes;
+    receiver.queue_stats(queue_len, queue_bytes);
+    fail_if(queue_len != 0 || queue_bytes != 0);
+
+    galera::ist::ProgressMeter::Status st;
+    receiver.progress(st);
+    fail_if(st.write_sets != rargs->last_ - rargs->first_ + 1,
+            "received %lld write sets", st.write_sets);
+    fail_if(st.current != rargs->last_);
+    fail_if(st.bytes <= 0);
+    fail_if(st.eta != 0, "eta %lld", st.eta);
+
+    const galera::ist::Compressor::Stats& cs(receiver.compression_stats());
+    recv_comp_stats.record(cs.raw(), cs.compressed(), cs.nsec());
+
     receiver.finished();
     return 0;
 }
@@ -244,7 +325,13 @@ static int select_trx_version(int protocol_version)
 }
 
 
-static void test_ist_common(int const version)
+/* Sends seqnos first to sent_last out of 1-10 from donor gcache, returns the
+ * last seqno delivered by the receiver. */
+static wsrep_seqno_t test_ist_common(int const version, int const stripes = 1,
+                                     bool const compress = false,
+                                     size_t const data_size = 3,
+                                     wsrep_seqno_t const first = 1,
+                                     wsrep_seqno_t const sent_last = 10)
 {
     using galera::KeyData;
     using galera::TrxHandle;
@@ -281,7 +368,8 @@ static void test_ist_common(int const version)
         };
 
         trx->append_key(KeyData(trx_version, key, 2, WSREP_KEY_EXCLUSIVE,true));
-        trx->append_data("bar", 3, WSREP_DATA_ORDERED, true);
+        std::vector<char> const data(data_size, 'b');
+        trx->append_data(&data[0], data.size(), WSREP_DATA_ORDERED, true);
         assert (i > 0);
         int last_seen(i - 1);
         int pa_range(i);
@@ -328,8 +416,11 @@ static void test_ist_common(int const version)
 
     mark_point();
 
-    receiver_args rargs(receiver_addr, 1, 10, 1, sp, version);
-    sender_args sargs(*gcache, rargs.listen_addr_, 1, 10, version);
+    receiver_args rargs(receiver_addr, first, 10, stripes, sp, version,
+                        stripes, compress);
+    rargs.sent_last_ = sent_last;
+    sender_args sargs(*gcache, rargs.listen_addr_, first, sent_last, version,
+                      stripes);
 
     gu_barrier_init(&start_barrier, 0, 1 + 1 + rargs.n_receivers_);
 
@@ -350,6 +441,9 @@ static void test_ist_common(int const version)
 
     mark_point();
     unlink(gcache_file.c_str());
+    unlink((gcache_file + ".index").c_str());
+
+    return rargs.delivered_;
 }
 
 
@@ -386,6 +480,118 @@ START_TEST(test_ist_v5)
 }
 END_TEST
 
+START_TEST(test_ist_striped)
+{
+    test_ist_common(5, 3);
+}
+END_TEST
+
+// big enough write sets to be sent with sendfile()
+START_TEST(test_ist_sendfile)
+{
+    test_ist_common(5, 1, false, 1 << 15);
+}
+END_TEST
+
+START_TEST(test_ist_compressed)
+{
+    using galera::ist::Compressor;
+
+    long long const sraw0(send_comp_stats.raw());
+    long long const scomp0(send_comp_stats.compressed());
+    long long const rraw0(recv_comp_stats.raw());
+
+    test_ist_common(5, 2, true);
+
+    long long const sraw(send_comp_stats.raw() - sraw0);
+    long long const scomp(send_comp_stats.compressed() - scomp0);
+    long long const rraw(recv_comp_stats.raw() - rraw0);
+
+    if (Compressor::supported() != Compressor::A_NONE)
+    {
+        // both compression and decompression are accounted
+        fail_if(sraw <= 0);
+        fail_if(scomp <= 0);
+        fail_if(scomp >= sraw, "compressed %lld >= raw %lld", scomp, sraw);
+        fail_if(rraw != sraw, "decompressed %lld, compressed %lld",
+                rraw, sraw);
+    }
+    else
+    {
+        // compression must not be negotiated
+        fail_if(sraw != 0 || rraw != 0);
+    }
+}
+END_TEST
+
+// donor stops half way, the rest is received in another IST as after
+// the joiner restart
+START_TEST(test_ist_interrupted)
+{
+    wsrep_seqno_t const delivered(test_ist_common(5, 1, false, 3, 1, 5));
+    fail_if(delivered != 5, "delivered %lld",
+            static_cast<long long>(delivered));
+
+    fail_if(test_ist_common(5, 1, false, 3, delivered + 1) != 10);
+}
+END_TEST
+
+START_TEST(test_ist_rate_limiter)
+{
+    galera::ist::RateLimiter rl;
+
+    fail_if(rl.effective_rate() != 0);
+    fail_if(rl.burst() != 0); // batches are not split
+
+    // unlimited: must not sleep
+    long long start(gu_time_monotonic());
+    for (int i(0); i < 1024; ++i) rl.consume(1 << 20);
+    fail_if(gu_time_monotonic() - start > 100000000LL);
+
+    // 1MB at 4MB/s should take ~250ms
+    rl.rate(4 << 20);
+    fail_if(rl.effective_rate() != 4 << 20);
+    fail_if(rl.burst() > (4 << 20) / 10);
+
+    start = gu_time_monotonic();
+    for (int i(0); i < 16; ++i) rl.consume(1 << 16);
+    long long const elapsed(gu_time_monotonic() - start);
+    fail_if(elapsed < 200000000LL, "elapsed only %lld ns", elapsed);
+
+    // adaptive mode without gcs has nothing to adapt to
+    rl.adaptive(true);
+    fail_if(rl.effective_rate() != 4 << 20);
+}
+END_TEST
+
+START_TEST(test_ist_progress_meter)
+{
+    galera::ist::ProgressMeter pm;
+    galera::ist::ProgressMeter::Status st;
+
+    pm.status(st);
+    fail_if(st.write_sets != 0 || st.bytes != 0 || st.eta != -1);
+
+    // two stripes, this one transfers odd seqnos
+    pm.start(1, 100, 2);
+    pm.update(1, 100);
+    usleep(10000);
+    pm.update(49, 2400, 24);
+
+    pm.status(st);
+    fail_if(st.first != 1 || st.last != 100 || st.current != 49);
+    fail_if(st.write_sets != 25, "write sets %lld", st.write_sets);
+    fail_if(st.bytes != 2500, "bytes %lld", st.bytes);
+    fail_if(st.rate_avg <= 0);
+    // 25 more to go at ~25 per 10ms
+    fail_if(st.eta < 0 || st.eta > 1, "eta %lld", st.eta);
+
+    pm.update(99, 2500, 25);
+    pm.status(st);
+    fail_if(st.eta != 0, "eta %lld", st.eta);
+}
+END_TEST
+
 Suite* ist_suite()
 {
     Suite* s  = suite_create("ist");
@@ -420,5 +626,33 @@ Suite* ist_suite()
     tcase_add_test(tc, test_ist_v5);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_ist_striped");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_striped);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_sendfile");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_sendfile);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_compressed");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_compressed);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_interrupted");
+    tcase_set_timeout(tc, 60);
+    tcase_add_test(tc, test_ist_interrupted);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_rate_limiter");
+    tcase_add_test(tc, test_ist_rate_limiter);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("test_ist_progress_meter");
+    tcase_add_test(tc, test_ist_progress_meter);
+    suite_add_tcase(s, tc);
+
     return s;
 }
@@ -13,6 +13,8 @@
 
 #include <check.h>
 
+#include <sstream>
+
 using namespace galera;
 
 class TestBaseName : public gu::Allocator::BaseName
@@ -31,6 +33,7 @@ static size_t version_to_hash_size (KeySet::Version const ver)
     {
     case KeySet::FLAT16:  fail("FLAT16 is not supported by test");
     case KeySet::FLAT16A: return 16;
+    case KeySet::FLAT16AC: return 16;
     case KeySet::FLAT8:   fail ("FLAT8 is not supported by test");
     case KeySet::FLAT8A:  return 8;
     default:              fail ("Unsupported KeySet verison: %d", ver);
@@ -300,6 +303,113 @@ static void test_ver(gu::RecordSet::Version const rsv, int ws_ver)
     fail_if(0 == shared);
 }
 
+/* FLAT16AC key parts reference parents and must be identical to FLAT16A
+ * key parts for the purpose of certification */
+static void test_compact(gu::RecordSet::Version const rsv, int ws_ver)
+{
+    int const alignment
+        (rsv >= gu::RecordSet::VER2 ? gu::RecordSet::VER2_ALIGNMENT : 1);
+    size_t const base_size(version_to_hash_size(KeySet::FLAT16AC));
+
+    union { gu::byte_t buf[1024]; gu_word_t align; } reserved_c, reserved_a;
+    TestBaseName const str("key_set_test");
+    KeySetOut ksc (reserved_c.buf, sizeof(reserved_c.buf), str,
+                   KeySet::FLAT16AC, rsv, ws_ver);
+    KeySetOut ksa (reserved_a.buf, sizeof(reserved_a.buf), str,
+                   KeySet::FLAT16A, rsv, ws_ver);
+
+    size_t total_size(ksc.size());
+
+    const char* const keys[][3] =
+    {
+        { "a0", "a1", "a2" }, /* 3 new parts: root + 2 referencing parent */
+        { "a0", "b1", "a2" }, /* 2 new parts referencing parent */
+        { "a0", "a1", "b2" }  /* parent is found in the set, not previous */
+    };
+    int const new_parts[] = { 3, 2, 1 };
+
+    for (size_t k(0); k < sizeof(keys)/sizeof(keys[0]); ++k)
+    {
+        TestKey tkc(KeySet::FLAT16AC, WSREP_KEY_EXCLUSIVE, false,
+                    keys[k][0], keys[k][1], keys[k][2]);
+        TestKey tka(KeySet::FLAT16A, WSREP_KEY_EXCLUSIVE, false,
+                    keys[k][0], keys[k][1], keys[k][2]);
+        ksc.append(tkc());
+        ksa.append(tka());
+
+        /* every part carries own part only: 2 + 2 + 1*4 */
+        for (int i(0); i < new_parts[k]; ++i)
+        {
+            total_size += base_size + 2 + 2 + 1*4;
+            total_size = GU_ALIGN(total_size, alignment);
+        }
+
+        fail_if (total_size != ksc.size(), "Size: %zu, expected: %zu",
+                 ksc.size(), total_size);
+    }
+
+    fail_if (ksc.count() != ksa.count(), "key count: expected %d, got %d",
+             ksa.count(), ksc.count());
+    fail_if (ksc.size() >= ksa.size(), "Compact size %zu >= %zu",
+             ksc.size(), ksa.size());
+
+    KeySetOut::GatherVector out_c, out_a;
+    out_c->reserve(ksc.page_count());
+    out_a->reserve(ksa.page_count());
+    size_t const size_c(ksc.gather(out_c));
+    size_t const size_a(ksa.gather(out_a));
+
+    std::vector<gu::byte_t> in_c, in_a;
+    for (size_t i(0); i < out_c->size(); ++i)
+    {
+        const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out_c[i].ptr));
+        in_c.insert (in_c.end(), ptr, ptr + out_c[i].size);
+    }
+    for (size_t i(0); i < out_a->size(); ++i)
+    {
+        const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out_a[i].ptr));
+        in_a.insert (in_a.end(), ptr, ptr + out_a[i].size);
+    }
+    fail_if (in_c.size() != size_c);
+    fail_if (in_a.size() != size_a);
+
+    KeySetIn ksic (ksc.version(), in_c.data(), in_c.size());
+    KeySetIn ksia (ksa.version(), in_a.data(), in_a.size());
+
+    try
+    {
+        ksic.checksum();
+    }
+    catch (std::exception& e)
+    {
+        fail("%s", e.what());
+    }
+
+    fail_if (ksic.count() != ksia.count());
+
+    for (int i(0); i < ksic.count(); ++i)
+    {
+        KeySet::KeyPart const kc(ksic.next());
+        KeySet::KeyPart const ka(ksia.next());
+
+        fail_if (kc.version() != KeySet::FLAT16AC);
+        fail_if (!kc.matches(ka), "Key part %d mismatch", i);
+        fail_if (kc.prefix() != ka.prefix());
+
+        std::ostringstream os;
+        os << kc;
+        /* only root part is annotated without a parent reference */
+        fail_if ((i > 0) != (os.str().find('^') != std::string::npos),
+                 "Unexpected annotation of part %d: %s", i, os.str().c_str());
+    }
+}
+
+START_TEST (compact2_4)
+{
+    test_compact(gu::RecordSet::VER2, 4);
+}
+END_TEST
+
 START_TEST (ver1_3)
 {
     test_ver(gu::RecordSet::VER1, 3);
@@ -324,6 +434,7 @@ Suite* key_set_suite ()
     tcase_add_test (t, ver1_3);
     tcase_add_test (t, ver2_3);
     tcase_add_test (t, ver2_4);
+    tcase_add_test (t, compact2_4);
     tcase_set_timeout(t, 60);
 
     Suite* s = suite_create ("KeySet");
@@ -3,6 +3,7 @@
 //
 
 #include "trx_handle.hpp"
+#include "fragment_map.hpp"
 #include "uuid.hpp"
 
 #include <check.h>
@@ -190,6 +191,109 @@ START_TEST(test_serialization)
 }
 END_TEST
 
+static TrxHandle*
+replicate_fragment(TrxHandle* const trx, TrxHandle::SlavePool& sp,
+                   uint32_t const flags, std::vector<gu::byte_t>& buf)
+{
+    trx->set_flags(flags);
+
+    WriteSetNG::GatherVector out;
+    size_t const out_size(trx->write_set_out().gather(trx->source_id(),
+                                                      trx->conn_id(),
+                                                      trx->trx_id(), out));
+    trx->set_last_seen_seqno(0);
+
+    buf.clear();
+    buf.reserve(out_size);
+    for (size_t i(0); i < out->size(); ++i)
+    {
+        const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out[i].ptr));
+        buf.insert(buf.end(), ptr, ptr + out[i].size);
+    }
+
+    TrxHandle* const frag(TrxHandle::New(sp));
+    fail_unless(frag->unserialize(&buf[0], buf.size(), 0) > 0);
+
+    return frag;
+}
+
+START_TEST(test_fragments)
+{
+    TrxHandle::LocalPool lp(TrxHandle::LOCAL_STORAGE_SIZE(), 4, "fragments_lp");
+    TrxHandle::SlavePool sp(sizeof(TrxHandle), 4, "fragments_sp");
+
+    galera::TrxHandle::Params const trx_params("", 3, KeySet::FLAT16);
+    wsrep_uuid_t uuid;
+    gu_uuid_generate(reinterpret_cast<gu_uuid_t*>(&uuid), 0, 0);
+    TrxHandle* trx(TrxHandle::New(lp, trx_params, uuid, 4567, 8910));
+
+    static char const data[] = "fragment data";
+    trx->append_data(data, sizeof(data), WSREP_DATA_ORDERED, true);
+    fail_unless(trx->write_set_out().size() >= sizeof(data));
+
+    std::vector<gu::byte_t> buf1;
+    TrxHandle* const frag1(replicate_fragment(trx, sp,
+                                              TrxHandle::F_STREAMING |
+                                              TrxHandle::F_BEGIN, buf1));
+    fail_unless(frag1->is_streaming());
+    fail_unless(frag1->is_fragment());
+    fail_unless(frag1->flags() & TrxHandle::F_BEGIN);
+    fail_unless(frag1->trx_id() == trx->trx_id());
+    fail_unless(frag1->write_set_in().dataset().count() == 1);
+
+    trx->fragments().push_back(frag1);
+    trx->next_fragment(trx_params);
+    fail_unless(trx->write_set_out().is_empty());
+    fail_if(trx->flags() & (TrxHandle::F_STREAMING | TrxHandle::F_BEGIN));
+
+    trx->append_data(data, sizeof(data), WSREP_DATA_ORDERED, true);
+
+    std::vector<gu::byte_t> buf2;
+    TrxHandle* const frag2(replicate_fragment(trx, sp,
+                                              TrxHandle::F_STREAMING, buf2));
+    fail_unless(frag2->is_fragment());
+    fail_if(frag2->flags() & TrxHandle::F_BEGIN);
+
+    trx->fragments().push_back(frag2);
+    frag2->ref();
+    trx->next_fragment(trx_params);
+
+    // committing write set may carry neither keys nor data
+    std::vector<gu::byte_t> buf3;
+    TrxHandle* const commit(replicate_fragment(trx, sp,
+                                               TrxHandle::F_STREAMING |
+                                               TrxHandle::F_COMMIT, buf3));
+    fail_unless(commit->is_streaming());
+    fail_if(commit->is_fragment());
+    fail_unless(commit->write_set_in().dataset().count() == 0);
+
+    {
+        FragmentMap fm;
+
+        fail_unless(fm.insert(frag1));
+        fail_unless(fm.insert(frag2));
+        fail_unless(fm.size() == 1);
+        fail_unless(frag1->refcnt() == 2);
+
+        fail_unless(fm.remove(*commit, commit->fragments()));
+        fail_unless(commit->fragments().size() == 2);
+        fail_unless(commit->fragments()[0] == frag1);
+        fail_unless(fm.size() == 0);
+
+        // fragment without beginning is not collected
+        fail_if(fm.insert(frag2));
+        fail_if(fm.remove(*commit, commit->fragments()));
+    }
+
+    commit->unref(); // releases references to fragments
+    fail_unless(frag1->refcnt() == 1);
+    fail_unless(frag2->refcnt() == 2);
+
+    frag2->unref();
+    trx->unref(); // releases the rest
+}
+END_TEST
+
 Suite* trx_handle_suite()
 {
     Suite* s = suite_create("trx_handle");
@@ -204,5 +308,9 @@ Suite* trx_handle_suite()
     tcase_add_test(tc, test_serialization);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_fragments");
+    tcase_add_test(tc, test_fragments);
+    suite_add_tcase(s, tc);
+
     return s;
 }
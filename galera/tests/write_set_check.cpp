@@ -644,6 +644,100 @@ START_TEST(test_trac_726)
 END_TEST
 
 
+START_TEST(test_cert_commutative)
+{
+    log_info << "test_cert_commutative";
+
+    const int version(4);
+    struct wsinfo_ {
+        int              node;
+        wsrep_seqno_t    global_seqno;
+        wsrep_seqno_t    last_seen_seqno;
+        bool             commutative;
+        wsrep_seqno_t    expected_depends_seqno;
+        Certification::TestResult result;
+    } wsi[] = {
+        // 1: non-commutative writer
+        { 1, 1, 0, false,  0, Certification::TEST_OK },
+        // 2: commutative, ordered after 1
+        { 2, 2, 1, true,   1, Certification::TEST_OK },
+        // 3: commutative, does not conflict with or depend on 2
+        { 3, 3, 1, true,   1, Certification::TEST_OK },
+        // 4: non-commutative, conflicts with 3
+        { 1, 4, 1, false, -1, Certification::TEST_FAILED },
+        // 5: non-commutative, ordered after 3
+        { 1, 5, 3, false,  3, Certification::TEST_OK },
+        // 6: commutative, conflicts with 5
+        { 2, 6, 3, true,  -1, Certification::TEST_FAILED },
+        // 7: commutative, ordered after 5
+        { 2, 7, 5, true,   5, Certification::TEST_OK },
+        // 8: commutative from node 1, depends on 5 only
+        { 1, 8, 7, true,   5, Certification::TEST_OK },
+        // 9: commutative from node 2 replaces 8 as the newest one
+        { 2, 9, 7, true,   5, Certification::TEST_OK },
+        // 10: non-commutative from node 2, 9 is its own, but it conflicts
+        //     with 8
+        { 2, 10, 7, false, -1, Certification::TEST_FAILED },
+        // 11: non-commutative from node 2, has seen 8
+        { 2, 11, 8, false,  9, Certification::TEST_OK },
+    };
+
+    size_t const nws(sizeof(wsi)/sizeof(wsi[0]));
+
+    TestEnv env;
+    galera::Certification cert(env.conf(), env.thd(), env.gcache());
+
+    cert.assign_initial_position(0, version);
+    galera::TrxHandle::Params const trx_params("", version,
+                                               KeySet::MAX_VERSION);
+    wsrep_buf_t const key[2] = { { void_cast("1"), 1 },
+                                 { void_cast("2"), 1 } };
+
+    mark_point();
+
+    for (size_t i(0); i < nws; ++i)
+    {
+        wsrep_uuid_t uuid = {{ static_cast<uint8_t>(wsi[i].node), }};
+        TrxHandle* trx(TrxHandle::New(lp, trx_params, uuid, 1, i + 1));
+        trx->append_key(KeyData(version, key, 2, WSREP_KEY_EXCLUSIVE, true));
+        trx->set_flags(TrxHandle::F_COMMIT |
+                       (wsi[i].commutative ? TrxHandle::F_COMMUTATIVE : 0));
+
+        WriteSetNG::GatherVector out;
+        size_t const out_size(trx->write_set_out().gather(trx->source_id(),
+                                                          trx->conn_id(),
+                                                          trx->trx_id(),
+                                                          out));
+        trx->set_last_seen_seqno(wsi[i].last_seen_seqno);
+
+        std::vector<gu::byte_t> buf;
+        buf.reserve(out_size);
+        for (size_t j(0); j < out->size(); ++j)
+        {
+            const gu::byte_t* ptr(static_cast<const gu::byte_t*>(out[j].ptr));
+            buf.insert(buf.end(), ptr, ptr + out[j].size);
+        }
+        trx->unref();
+
+        trx = TrxHandle::New(sp);
+        trx->unserialize(&buf[0], buf.size(), 0);
+        fail_unless(trx->is_commutative() == wsi[i].commutative);
+
+        trx->set_received(0, wsi[i].global_seqno, wsi[i].global_seqno);
+        Certification::TestResult result(cert.append_trx(trx));
+        fail_unless(result == wsi[i].result, "g: %lld res: %d exp: %d",
+                    trx->global_seqno(), result, wsi[i].result);
+        fail_unless(trx->depends_seqno() == wsi[i].expected_depends_seqno,
+                    "wsi: %zu g: %lld ld: %lld eld: %lld",
+                    i, trx->global_seqno(), trx->depends_seqno(),
+                    wsi[i].expected_depends_seqno);
+        cert.set_trx_committed(trx);
+        trx->unref();
+    }
+}
+END_TEST
+
+
 Suite* write_set_suite()
 {
     Suite* s = suite_create("write_set");
@@ -684,5 +778,10 @@ Suite* write_set_suite()
     tcase_set_timeout(tc, 20);
     suite_add_tcase(s, tc);
 
+    tc = tcase_create("test_cert_commutative");
+    tcase_add_test(tc, test_cert_commutative);
+    tcase_set_timeout(tc, 20);
+    suite_add_tcase(s, tc);
+
     return s;
 }
@@ -221,6 +221,28 @@ static void ver3_basic(gu::RecordSet::Version const rsv,
         fail_if (e.get_errno() != EINVAL);
     }
 
+    mark_point();
+
+    /* this is to test that sets are located on demand when checksum is
+     * skipped (as done by IST sender) */
+    {
+        WriteSetIn ref_wsi(in_buf);
+        WriteSetIn::GatherVector ref_out;
+        size_t const ref_size(ref_wsi.gather(ref_out, false, false));
+
+        WriteSetIn wsi;
+        wsi.read_buf(in_buf, 0);
+        WriteSetIn::GatherVector out;
+        size_t const size(wsi.gather(out, false, false));
+
+        fail_if (size != ref_size, "Gather size: %zu, expected: %zu",
+                 size, ref_size);
+        fail_if (out->size() != ref_out->size());
+        fail_if (wsi.dataset().count() != ref_wsi.dataset().count());
+        fail_if (wsi.unrdset().count() != ref_wsi.unrdset().count());
+        fail_if (wsi.get_checksum() != ref_wsi.get_checksum());
+    }
+
     in[in.size() - 1] ^= 1; // corrupted the last byte (payload)
 
     mark_point();
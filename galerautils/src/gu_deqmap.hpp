@@ -0,0 +1,337 @@
+// Copyright (C) 2018 Codership Oy <info@codership.com>
+
+/*!
+ * @file map-like container for dense integer keys:
+ *
+ *       gu::DeqMap<int64_t, const void*> m;
+ *       m.insert(std::make_pair(5, ptr)); // m.begin()->first == 5
+ *       m.find(5)->second;                // O(1)
+ *
+ * Values are stored in a std::deque indexed by (key - first key), so lookup
+ * is O(1), there is no per-entry allocation and an entry takes just
+ * sizeof(V) bytes instead of a whole tree node. This suits sequence numbers
+ * which are allocated (and purged) mostly in order.
+ *
+ * Default-constructed V (null) marks a missing key, so it can't be stored.
+ * Gaps are allowed but every missing key inside the range costs a slot, and
+ * iteration, upper_bound() and lower_bound() step over them. The first and
+ * the last slots are always occupied.
+ *
+ * Iterators are read-only: they remember the key and a copy of the value,
+ * so they stay valid when other elements are inserted or erased. End
+ * iterators are not bound to a key and remain end iterators.
+ *
+ * $Id$
+ */
+
+#ifndef _GU_DEQMAP_HPP_
+#define _GU_DEQMAP_HPP_
+
+#include <deque>
+#include <limits>
+#include <utility>
+#include <cassert>
+#include <cstddef>
+
+namespace gu
+{
+
+template <typename K, typename V, class A = std::allocator<V> >
+class DeqMap
+{
+    typedef std::deque<V, A> base_type;
+
+public:
+
+    typedef K                   key_type;
+    typedef V                   mapped_type;
+    typedef std::pair<K, V>     value_type;
+    typedef typename base_type::size_type size_type;
+
+    class iterator
+    {
+    public:
+
+        iterator() : map_(0), val_(end_key(), V()) {}
+
+        const value_type& operator*()  const { return  val_; }
+        const value_type* operator->() const { return &val_; }
+
+        iterator& operator++()
+        {
+            assert(map_);
+            val_.first = map_->next_key(val_.first);
+            val_.second = map_->value(val_.first);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator const ret(*this);
+            ++(*this);
+            return ret;
+        }
+
+        iterator& operator--()
+        {
+            assert(map_);
+            val_.first = map_->prev_key(val_.first);
+            val_.second = map_->value(val_.first);
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            iterator const ret(*this);
+            --(*this);
+            return ret;
+        }
+
+        bool operator==(const iterator& o) const
+        {
+            return val_.first == o.val_.first;
+        }
+
+        bool operator!=(const iterator& o) const { return !(*this == o); }
+
+    private:
+
+        friend class DeqMap;
+
+        iterator(const DeqMap* m, K k) : map_(m), val_(k, m->value(k)) {}
+
+        const DeqMap* map_;
+        value_type    val_;
+    };
+
+    class reverse_iterator
+    {
+    public:
+
+        reverse_iterator() : map_(0), val_(begin_key(), V()) {}
+
+        const value_type& operator*()  const { return  val_; }
+        const value_type* operator->() const { return &val_; }
+
+        reverse_iterator& operator++()
+        {
+            assert(map_);
+            val_.first = map_->prev_key(val_.first);
+            val_.second = map_->value(val_.first);
+            return *this;
+        }
+
+        reverse_iterator operator++(int)
+        {
+            reverse_iterator const ret(*this);
+            ++(*this);
+            return ret;
+        }
+
+        bool operator==(const reverse_iterator& o) const
+        {
+            return val_.first == o.val_.first;
+        }
+
+        bool operator!=(const reverse_iterator& o) const
+        {
+            return !(*this == o);
+        }
+
+    private:
+
+        friend class DeqMap;
+
+        reverse_iterator(const DeqMap* m, K k) : map_(m), val_(k, m->value(k))
+        {}
+
+        const DeqMap* map_;
+        value_type    val_;
+    };
+
+    typedef iterator         const_iterator;
+    typedef reverse_iterator const_reverse_iterator;
+
+    explicit
+    DeqMap(const A& alloc = A()) : base_(alloc), begin_(0), size_(0) {}
+
+    bool      empty() const { return 0 == size_; }
+    size_type size()  const { return size_; } // number of present keys
+
+    /* range of keys [index_begin(), index_end()) covered by storage,
+     * gaps included */
+    K index_begin() const { return begin_; }
+    K index_end()   const { return begin_ + K(base_.size()); }
+
+    iterator begin() const
+    {
+        return empty() ? end() : iterator(this, begin_);
+    }
+
+    iterator end() const { return iterator(this, end_key()); }
+
+    reverse_iterator rbegin() const
+    {
+        return empty() ? rend() : reverse_iterator(this, back_key());
+    }
+
+    reverse_iterator rend() const
+    {
+        return reverse_iterator(this, begin_key());
+    }
+
+    iterator find(K const k) const
+    {
+        return (value(k) != V() ? iterator(this, k) : end());
+    }
+
+    /* first present key not less than k */
+    iterator lower_bound(K const k) const
+    {
+        if (empty() || k >= index_end()) return end();
+        if (k <= begin_)                 return begin();
+        return (value(k) != V() ? iterator(this, k) : iterator(this,
+                                                           next_key(k)));
+    }
+
+    /* first present key greater than k */
+    iterator upper_bound(K const k) const
+    {
+        if (empty() || k >= back_key()) return end();
+        if (k <  begin_)                return begin();
+        return iterator(this, next_key(k));
+    }
+
+    /* returns false in second if the key is already present */
+    std::pair<iterator, bool> insert(const value_type& v)
+    {
+        K const k(v.first);
+
+        assert(v.second != V());
+        assert(k != begin_key() && k != end_key());
+
+        if (empty())
+        {
+            base_.clear();
+            base_.push_back(v.second);
+            begin_ = k;
+        }
+        else if (k >= index_end())
+        {
+            base_.resize(k - begin_);
+            base_.push_back(v.second);
+        }
+        else if (k < begin_)
+        {
+            base_.insert(base_.begin(), begin_ - k, V());
+            base_.front() = v.second;
+            begin_ = k;
+        }
+        else if (base_[k - begin_] == V())
+        {
+            base_[k - begin_] = v.second;
+        }
+        else
+        {
+            return std::pair<iterator, bool>(iterator(this, k), false);
+        }
+
+        ++size_;
+        return std::pair<iterator, bool>(iterator(this, k), true);
+    }
+
+    /* hint is ignored: keys are positioned by value anyway */
+    iterator insert(iterator, const value_type& v)
+    {
+        return insert(v).first;
+    }
+
+    void erase(iterator const i)
+    {
+        K const k(i->first);
+
+        assert(i.map_ == this);
+        assert(value(k) != V());
+
+        base_[k - begin_] = V();
+        --size_;
+
+        if (k == begin_)
+        {
+            while (!base_.empty() && base_.front() == V())
+            {
+                base_.pop_front();
+                ++begin_;
+            }
+        }
+        else if (k == back_key())
+        {
+            while (base_.back() == V()) base_.pop_back();
+        }
+
+        assert(empty() == base_.empty());
+    }
+
+    /* erases present keys in [first, last) */
+    void erase(iterator first, iterator const last)
+    {
+        while (first != last) erase(first++);
+    }
+
+    void clear()
+    {
+        base_.clear();
+        begin_ = 0;
+        size_  = 0;
+    }
+
+    void swap(DeqMap& other)
+    {
+        base_.swap(other.base_);
+        std::swap(begin_, other.begin_);
+        std::swap(size_,  other.size_);
+    }
+
+private:
+
+    base_type base_;
+    K         begin_;  // key of base_.front()
+    size_type size_;
+
+    /* iterator positions past either end */
+    static K begin_key() { return std::numeric_limits<K>::min(); }
+    static K end_key()   { return std::numeric_limits<K>::max(); }
+
+    K back_key() const { return index_end() - 1; }
+
+    V value(K const k) const
+    {
+        return (k >= begin_ && k < index_end() ? base_[k - begin_] : V());
+    }
+
+    /* next present key after k */
+    K next_key(K k) const
+    {
+        K const e(index_end());
+
+        if (empty() || k >= e - 1) return end_key();
+        if (k < begin_)            return begin_;
+
+        for (++k; k < e; ++k) if (base_[k - begin_] != V()) return k;
+        return end_key();
+    }
+
+    /* previous present key before k */
+    K prev_key(K k) const
+    {
+        if (empty() || k <= begin_) return begin_key();
+        if (k > back_key())         return back_key();
+
+        for (--k; k >= begin_; --k) if (base_[k - begin_] != V()) return k;
+        return begin_key();
+    }
+};
+
+} /* namespace gu */
+
+#endif /* _GU_DEQMAP_HPP_ */
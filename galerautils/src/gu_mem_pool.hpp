@@ -15,7 +15,9 @@
 
 #include "gu_lock.hpp"
 #include "gu_macros.hpp"
+#include "gu_throw.hpp"
 
+#include <pthread.h>
 #include <assert.h>
 
 #include <vector>
@@ -169,7 +171,27 @@ namespace gu
     /* Thread-safe MemPool specialization.
      * Even though MemPool<true> technically IS-A MemPool<false>, the need to
      * overload nearly all public methods and practical uselessness of
-     * polymorphism in this case make inheritance undesirable. */
+     * polymorphism in this case make inheritance undesirable.
+     *
+     * To reduce contention on the pool mutex each thread keeps a small cache
+     * ("magazine") of free buffers. Buffers are taken from and returned to
+     * the magazine without locking, the shared pool ("depot") is locked only
+     * to refill an empty magazine or to flush a full one, MAG_SIZE/2 buffers
+     * at a time. Since the buffers in the magazine were last touched by the
+     * owning thread, they tend to be local to its NUMA node.
+     *
+     * Buffers cached in magazines count as neither in use nor in the depot,
+     * so self-adjustment of the depot is not affected by them. Magazine
+     * contents are returned to the depot when the thread exits. Magazine
+     * counters are accounted in the pool only when the owner takes the
+     * depot mutex, so statistics are as of the last depot access.
+     *
+     * A magazine is deleted only by its owner thread. The pool destructor
+     * takes over the buffers of the remaining magazines and detaches them
+     * from the pool under exit_mtx(), which thread exit callbacks take
+     * before touching the pool: a callback racing with the destructor
+     * either finishes first or finds its magazine detached. Magazines of
+     * threads which outlive the pool are not freed. */
     template <>
     class MemPool<true>
     {
@@ -180,21 +202,74 @@ namespace gu
             :
             base_(buf_size, reserve, name),
 #ifdef HAVE_PSI_INTERFACE
-            mtx_ (WSREP_PFS_INSTR_TAG_MEMPOOL_MUTEX)
+            mtx_ (WSREP_PFS_INSTR_TAG_MEMPOOL_MUTEX),
 #else
-            mtx_ ()
+            mtx_ (),
 #endif /* HAVE_PSI_INTERFACE */
-        {}
+            key_ (),
+            mags_(),
+            locks_   (0),
+            stats_   ()
+        {
+            int const err(pthread_key_create(&key_, magazine_release));
+
+            if (gu_unlikely(err != 0))
+            {
+                gu_throw_error(err) << "Failed to create MemPool(" << name
+                                    << ") thread key";
+            }
+        }
 
-        ~MemPool() {}
+        ~MemPool()
+        {
+            /* no new thread exit callbacks after this, but some may be
+             * running already */
+            pthread_key_delete(key_);
+
+            ExitLock exit_lock;
+            Lock     lock(mtx_);
+
+            for (size_t i(0); i < mags_.size(); ++i)
+            {
+                Magazine* const mag(mags_[i]);
+
+                /* all buffers must be returned before destruction, so
+                 * bypass self-adjustment and let base_ free them */
+                for (int j(0); j < mag->count; ++j)
+                {
+                    base_.pool_.push_back(mag->bufs[j]);
+                }
+
+                mag->count = 0;
+                mag->pool  = NULL; // the owner thread deletes it
+            }
+        }
 
         void* acquire()
         {
+            Magazine* const mag(magazine());
+
+            if (gu_likely(mag->count > 0))
+            {
+                ++mag->hits;
+                return mag->bufs[--mag->count];
+            }
+
             void* ret;
 
             {
                 Lock lock(mtx_);
+                ++locks_;
+
                 ret = base_.from_pool();
+
+                while (mag->count < MAG_SIZE/2 && base_.pool_.size() > 0)
+                {
+                    mag->bufs[mag->count++] = base_.pool_.back();
+                    base_.pool_.pop_back();
+                }
+
+                account(mag);
             }
 
             if (!ret) ret = base_.alloc();
@@ -204,32 +279,202 @@ namespace gu
 
         void recycle(void* buf)
         {
-            bool pooled;
+            assert(buf);
+
+            Magazine* const mag(magazine());
+
+            if (gu_likely(mag->count < MAG_SIZE))
+            {
+                mag->bufs[mag->count++] = buf;
+                return;
+            }
+
+            /* magazine full: flush half of it to depot */
+            void* excess[MAG_SIZE/2 + 1];
+            int   n_excess(0);
+
+            mag->bufs[mag->count++] = buf; // MAG_SIZE + 1 slots
 
             {
                 Lock lock(mtx_);
-                pooled = base_.to_pool(buf);
+                ++locks_;
+
+                while (mag->count > MAG_SIZE/2)
+                {
+                    void* const b(mag->bufs[--mag->count]);
+                    if (!base_.to_pool(b)) excess[n_excess++] = b;
+                }
+
+                account(mag);
             }
 
-            if (!pooled) base_.free(buf);
+            for (int i(0); i < n_excess; ++i) base_.free(excess[i]);
         }
 
         void print(std::ostream& os) const
         {
             Lock lock(mtx_);
-            base_.print(os);
+
+            Stats const s(stats_);
+
+            size_t const depot(base_.pool_.size());
+            size_t const calls(s.hits + locks_);
+            double const chr(calls > 0 ? double(s.hits)/calls : 0.0);
+            double hr(base_.hits_);
+
+            if (hr > 0)
+            {
+                hr /= base_.hits_ + base_.misses_;
+            }
+
+            os << "MemPool("       << base_.name_
+               << "): hit ratio: " << hr
+               << ", misses: "     << base_.misses_
+               << ", in use: "     << base_.allocd_ - depot - s.cached
+               << ", in pool: "    << depot
+               << ", in thread caches: " << s.cached
+               << ", thread cache hit ratio: " << chr
+               << ", depot locks: " << locks_
+               << ", threads: "    << mags_.size();
         }
 
         size_t buf_size() const { return base_.buf_size(); }
 
+        /* number of times the shared depot mutex was taken: a measure of
+         * contention */
+        size_t depot_locks() const { Lock lock(mtx_); return locks_; }
+
     private:
 
+        static int const MAG_SIZE = 16;
+
+        struct Magazine
+        {
+            MemPool* pool;      // NULL when detached by ~MemPool()
+            size_t   hits;      // since the last account()
+            int      count;
+            int      accounted; // count as of the last account()
+            void*    bufs[MAG_SIZE + 1]; // + 1 for overflow in recycle()
+
+            explicit Magazine(MemPool* p)
+                : pool(p), hits(0), count(0), accounted(0) {}
+
+        private:
+
+            Magazine (const Magazine&);
+            Magazine& operator= (const Magazine&);
+        };
+
+        struct Stats
+        {
+            size_t hits;
+            size_t cached;
+            Stats() : hits(0), cached(0) {}
+        };
+
+        /* serializes thread exit callbacks with pool destruction, shared by
+         * all pools: both are rare */
+        static pthread_mutex_t& exit_mtx()
+        {
+            static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+            return mtx;
+        }
+
+        class ExitLock
+        {
+        public:
+            ExitLock()  { pthread_mutex_lock  (&exit_mtx()); }
+            ~ExitLock() { pthread_mutex_unlock(&exit_mtx()); }
+        private:
+            ExitLock (const ExitLock&);
+            ExitLock& operator= (const ExitLock&);
+        };
+
+        /* folds magazine counters into stats_, must be called under mtx_ */
+        void account(Magazine* const mag)
+        {
+            stats_.hits   += mag->hits;
+            stats_.cached += mag->count;
+            stats_.cached -= mag->accounted;
+            mag->hits      = 0;
+            mag->accounted = mag->count;
+        }
+
+        Magazine* magazine()
+        {
+            Magazine* mag(static_cast<Magazine*>(pthread_getspecific(key_)));
+
+            if (gu_unlikely(NULL == mag))
+            {
+                mag = new Magazine(this);
+
+                {
+                    Lock lock(mtx_);
+                    mags_.push_back(mag);
+                }
+
+                pthread_setspecific(key_, mag);
+            }
+
+            return mag;
+        }
+
+        /* thread exit callback: return cached buffers to depot */
+        static void magazine_release(void* arg)
+        {
+            Magazine* const mag(static_cast<Magazine*>(arg));
+
+            void* excess[MAG_SIZE + 1];
+            int   n_excess(0);
+
+            {
+                ExitLock exit_lock;
+
+                MemPool* const mp(mag->pool);
+
+                if (mp) // not detached, the pool can't go away meanwhile
+                {
+                    Lock lock(mp->mtx_);
+
+                    while (mag->count > 0)
+                    {
+                        void* const b(mag->bufs[--mag->count]);
+                        if (!mp->base_.to_pool(b)) excess[n_excess++] = b;
+                    }
+
+                    mp->account(mag);
+
+                    for (size_t i(0); i < mp->mags_.size(); ++i)
+                    {
+                        if (mp->mags_[i] == mag)
+                        {
+                            mp->mags_[i] = mp->mags_.back();
+                            mp->mags_.pop_back();
+                            break;
+                        }
+                    }
+                }
+            }
+
+            /* buffers in excess are plain operator new() allocations */
+            for (int i(0); i < n_excess; ++i) operator delete(excess[i]);
+
+            delete mag;
+        }
+
         MemPool<false> base_;
 #ifdef HAVE_PSI_INTERFACE
         gu::MutexWithPFS mtx_;
 #else
         gu::Mutex      mtx_;
 #endif /* HAVE_PSI_INTERFACE */
+        pthread_key_t          key_;
+        std::vector<Magazine*> mags_;
+        size_t                 locks_;
+        Stats                  stats_;   // thread caches, see account()
+
+        MemPool (const MemPool&);
+        MemPool operator= (const MemPool&);
 
     }; /* class MemPool<true>: thread-safe */
 
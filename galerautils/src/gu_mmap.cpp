@@ -12,7 +12,11 @@
 
 #include "gu_limits.h" // GU_PAGE_SIZE
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <sys/mman.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -84,6 +88,166 @@ namespace gu
         }
     }
 
+    bool
+    MMap::hugepages() const
+    {
+#if defined(MADV_HUGEPAGE)
+        if (::madvise(ptr, size, MADV_HUGEPAGE))
+        {
+            int const err(errno);
+            log_warn << "Failed to set MADV_HUGEPAGE on " << ptr << ": "
+                     << err << " (" << strerror(err) << "). Transparent huge "
+                     "pages must be enabled in 'madvise' or 'always' mode "
+                     "and supported by the file system.";
+            return false;
+        }
+
+        return true;
+#else
+        log_warn << "Huge pages are not supported on this platform.";
+        return false;
+#endif /* MADV_HUGEPAGE */
+    }
+
+    bool
+    MMap::populate() const
+    {
+#if defined(__linux__)
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23 /* since Linux 5.14 */
+#endif
+        if (0 == ::madvise(ptr, size, MADV_POPULATE_WRITE)) return true;
+
+        if (EINVAL != errno) // EINVAL: not supported by kernel
+        {
+            int const err(errno);
+            log_warn << "Failed to prefault " << ptr << ": " << err << " ("
+                     << strerror(err) << ")";
+            return false;
+        }
+#endif /* __linux__ */
+        /* MAP_POPULATE/MADV_WILLNEED would only read the pages in, so do it
+         * the old way: rewrite a byte on every page */
+        volatile uint8_t* const p(static_cast<uint8_t*>(ptr));
+
+        for (size_t off(0); off < size; off += GU_PAGE_SIZE)
+        {
+            p[off] = p[off];
+        }
+
+        return true;
+    }
+
+    bool
+    MMap::lock() const
+    {
+        if (::mlock(ptr, size))
+        {
+            int const err(errno);
+            log_warn << "Failed to lock " << size << " bytes at " << ptr
+                     << " in memory: " << err << " (" << strerror(err)
+                     << "). Check RLIMIT_MEMLOCK (ulimit -l) or "
+                     "CAP_IPC_LOCK.";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool
+    MMap::stats(Stats& st) const
+    {
+        st = Stats();
+
+        std::ifstream smaps("/proc/self/smaps");
+        if (!smaps) return false;
+
+        uintptr_t const begin(reinterpret_cast<uintptr_t>(ptr));
+        uintptr_t const end  (begin + size);
+
+        bool        inside(false);
+        std::string line;
+
+        /* the mapping may be split into several VMAs by madvise()/mlock() */
+        while (std::getline(smaps, line))
+        {
+            std::istringstream is(line);
+            std::string        key;
+            is >> key;
+
+            if (key.empty()) continue;
+
+            if (key[key.length() - 1] != ':') // VMA header: "start-end ..."
+            {
+                char* e;
+                uintptr_t const start(strtoull(key.c_str(), &e, 16));
+                inside = ('-' == *e && start >= begin && start < end);
+                continue;
+            }
+
+            if (!inside) continue;
+
+            size_t kb(0);
+            is >> kb;
+            size_t const bytes(kb << 10);
+
+            if ("Rss:" == key)
+            {
+                st.resident += bytes;
+            }
+            else if ("Locked:" == key)
+            {
+                st.locked += bytes;
+            }
+            else if ("AnonHugePages:"  == key || "ShmemPmdMapped:" == key ||
+                     "FilePmdMapped:"  == key || "Shared_Hugetlb:" == key ||
+                     "Private_Hugetlb:" == key)
+            {
+                st.hugepages += bytes;
+            }
+        }
+
+        return true;
+    }
+
+    bool
+    MMap::resident(size_t& bytes) const
+    {
+        bytes = 0;
+
+#if defined(__linux__)
+        /* one byte per page, a chunk at a time to keep the vector small */
+        static size_t const CHUNK_PAGES(4096);
+        unsigned char vec[CHUNK_PAGES];
+
+        uint8_t* const begin(static_cast<uint8_t*>(ptr));
+
+        for (size_t off(0); off < size; off += CHUNK_PAGES * GU_PAGE_SIZE)
+        {
+            size_t const len(std::min(size - off, CHUNK_PAGES * GU_PAGE_SIZE));
+
+            if (::mincore(begin + off, len, vec))
+            {
+                int const err(errno);
+                log_warn << "Failed to query residency of " << ptr << ": "
+                         << err << " (" << strerror(err) << ")";
+                return false;
+            }
+
+            size_t const pages((len + GU_PAGE_SIZE - 1) / GU_PAGE_SIZE);
+
+            for (size_t i(0); i < pages; ++i)
+            {
+                if (vec[i] & 1) bytes += GU_PAGE_SIZE;
+            }
+        }
+
+        return true;
+#else
+        return false;
+#endif /* __linux__ */
+    }
+
     void
     MMap::sync(void* const addr, size_t const length) const
     {
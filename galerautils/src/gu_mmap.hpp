@@ -29,6 +29,38 @@ public:
     void sync() const;
     void unmap();
 
+    /* The following are best effort: they return false and log a warning
+     * if the operation is not supported or failed */
+
+    /* advises the kernel to back the mapping with (transparent) huge pages,
+     * should be called before the mapping is accessed */
+    bool hugepages() const;
+
+    /* faults in the whole mapping for writing, so that page faults are not
+     * taken on the first write */
+    bool populate() const;
+
+    /* locks the mapping in RAM, subject to RLIMIT_MEMLOCK */
+    bool lock() const;
+
+    struct Stats
+    {
+        Stats() : resident(0), hugepages(0), locked(0) {}
+
+        size_t resident;  // bytes in RAM
+        size_t hugepages; // bytes mapped with huge pages
+        size_t locked;    // bytes locked in RAM
+    };
+
+    /* memory usage of the mapping, returns false if not supported.
+     * Parses /proc/self/smaps, which takes time proportional to the number
+     * of mappings in the process, see resident() for a cheaper check */
+    bool stats(Stats& st) const;
+
+    /* bytes of the mapping in RAM as reported by mincore(),
+     * returns false if not supported */
+    bool resident(size_t& bytes) const;
+
 private:
 
     bool mapped;
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+#include "../src/gu_deqmap.hpp"
+
+#include "gu_deqmap_test.hpp"
+
+#include <stdint.h>
+
+typedef gu::DeqMap<int64_t, const void*> Map;
+
+static const void* ptr(int64_t k)
+{
+    return reinterpret_cast<const void*>(intptr_t(k) << 4);
+}
+
+START_TEST(test_deqmap_basic)
+{
+    Map m;
+
+    fail_if(!m.empty());
+    fail_if(m.begin() != m.end());
+    fail_if(m.rbegin() != m.rend());
+    fail_if(m.find(0) != m.end());
+    fail_if(m.upper_bound(0) != m.end());
+
+    for (int64_t k(100); k < 110; ++k)
+    {
+        Map::iterator const i(m.insert(m.end(), Map::value_type(k, ptr(k))));
+        fail_if(i->first != k || i->second != ptr(k));
+    }
+
+    fail_if(m.size() != 10);
+    fail_if(m.begin()->first != 100);
+    fail_if(m.rbegin()->first != 109);
+    fail_if(m.find(105)->second != ptr(105));
+    fail_if(m.find(99)  != m.end());
+    fail_if(m.find(110) != m.end());
+
+    // duplicate
+    std::pair<Map::iterator, bool> const res
+        (m.insert(Map::value_type(105, ptr(1))));
+    fail_if(res.second);
+    fail_if(res.first->second != ptr(105));
+
+    fail_if(m.upper_bound(0)->first   != 100);
+    fail_if(m.upper_bound(104)->first != 105);
+    fail_if(m.upper_bound(109) != m.end());
+    fail_if(m.lower_bound(104)->first != 104);
+
+    int64_t k(100);
+    for (Map::iterator i(m.begin()); i != m.end(); ++i, ++k)
+    {
+        fail_if(i->first != k || i->second != ptr(k));
+    }
+    fail_if(k != 110);
+
+    for (Map::reverse_iterator r(m.rbegin()); r != m.rend(); ++r)
+    {
+        fail_if(r->first != --k);
+    }
+    fail_if(k != 100);
+
+    fail_if((--m.end())->first != 109);
+}
+END_TEST
+
+START_TEST(test_deqmap_gaps)
+{
+    Map m;
+
+    m.insert(Map::value_type(10, ptr(10)));
+    m.insert(Map::value_type(15, ptr(15)));  // gap after
+    m.insert(Map::value_type(5,  ptr(5)));   // gap before
+    m.insert(Map::value_type(12, ptr(12)));  // fill in
+
+    fail_if(m.size() != 4);
+    fail_if(m.index_begin() != 5 || m.index_end() != 16);
+    fail_if(m.find(11) != m.end());
+    fail_if(m.upper_bound(10)->first != 12);
+    fail_if(m.lower_bound(13)->first != 15);
+
+    int64_t const keys[] = { 5, 10, 12, 15 };
+    size_t n(0);
+    for (Map::iterator i(m.begin()); i != m.end(); ++i, ++n)
+    {
+        fail_if(i->first != keys[n], "%lld != %lld",
+                static_cast<long long>(i->first),
+                static_cast<long long>(keys[n]));
+    }
+    fail_if(n != 4);
+
+    for (Map::reverse_iterator r(m.rbegin()); r != m.rend(); ++r)
+    {
+        fail_if(r->first != keys[--n]);
+    }
+
+    // erasing the ends trims storage up to the next present keys
+    m.erase(m.begin());
+    fail_if(m.index_begin() != 10);
+    m.erase(m.find(15));
+    fail_if(m.index_end() != 13);
+    fail_if(m.rbegin()->first != 12);
+
+    // erase while iterating, including the last element
+    for (Map::iterator i(m.begin()); i != m.end();) m.erase(i++);
+
+    fail_if(!m.empty());
+    fail_if(m.begin() != m.end());
+
+    // reuse after being emptied
+    m.insert(Map::value_type(1000, ptr(1000)));
+    fail_if(m.begin()->first != 1000 || m.size() != 1);
+
+    m.clear();
+    fail_if(!m.empty());
+}
+END_TEST
+
+START_TEST(test_deqmap_erase_range)
+{
+    Map m;
+
+    for (int64_t k(1); k <= 100; ++k) m.insert(Map::value_type(k, ptr(k)));
+
+    m.erase(m.begin(), m.find(51));
+    fail_if(m.size() != 50);
+    fail_if(m.begin()->first != 51);
+
+    m.erase(m.find(60), m.end());
+    fail_if(m.size() != 9);
+    fail_if(m.rbegin()->first != 59);
+}
+END_TEST
+
+Suite* gu_deqmap_suite()
+{
+    TCase* t = tcase_create ("test_deqmap");
+    tcase_add_test (t, test_deqmap_basic);
+    tcase_add_test (t, test_deqmap_gaps);
+    tcase_add_test (t, test_deqmap_erase_range);
+
+    Suite* s = suite_create ("gu::DeqMap");
+    suite_add_tcase (s, t);
+
+    return s;
+}
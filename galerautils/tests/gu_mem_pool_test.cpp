@@ -8,6 +8,9 @@
 
 #include "gu_mem_pool_test.hpp"
 
+#include <pthread.h>
+#include <cstring>
+
 START_TEST (unsafe)
 {
     gu::MemPoolUnsafe mp(10, 1, "unsafe");
@@ -56,6 +59,103 @@ START_TEST (safe)
 }
 END_TEST
 
+static void* safe_thread(void* arg)
+{
+    gu::MemPoolSafe& mp(*static_cast<gu::MemPoolSafe*>(arg));
+    void* bufs[TEST_SIZE/32];
+
+    for (int i(0); i < TEST_SIZE; ++i)
+    {
+        int const n((i % (TEST_SIZE/32)) + 1);
+
+        for (int j(0); j < n; ++j)
+        {
+            bufs[j] = mp.acquire();
+            fail_if(NULL == bufs[j]);
+            ::memset(bufs[j], j, mp.buf_size());
+        }
+
+        for (int j(0); j < n; ++j) mp.recycle(bufs[j]);
+    }
+
+    return NULL;
+}
+
+START_TEST (safe_threads)
+{
+    gu::MemPoolSafe mp(10, 1, "safe_threads");
+    pthread_t thr[8];
+    size_t const n_thr(sizeof(thr)/sizeof(thr[0]));
+
+    for (size_t i(0); i < n_thr; ++i)
+    {
+        fail_if(pthread_create(&thr[i], NULL, safe_thread, &mp));
+    }
+
+    for (size_t i(0); i < n_thr; ++i) pthread_join(thr[i], NULL);
+
+    log_info << mp;
+
+    /* thread caches should absorb most of the acquire/recycle calls */
+    size_t calls(0);
+    for (int i(0); i < TEST_SIZE; ++i) calls += 2*((i % (TEST_SIZE/32)) + 1);
+    calls *= n_thr;
+
+    fail_if(mp.depot_locks() * 4 >= calls,
+            "depot locks: %zu, calls: %zu", mp.depot_locks(), calls);
+
+    /* buffers cached by this thread must be released by destructor */
+    void* const buf(mp.acquire());
+    mp.recycle(buf);
+}
+END_TEST
+
+struct destroy_args
+{
+    gu::MemPoolSafe*  mp;
+    pthread_barrier_t barrier;
+};
+
+static void* destroy_thread(void* arg)
+{
+    destroy_args& args(*static_cast<destroy_args*>(arg));
+
+    void* const buf(args.mp->acquire());
+    fail_if(NULL == buf);
+    args.mp->recycle(buf);
+
+    /* exit (and release the thread cache) while the pool is destroyed */
+    pthread_barrier_wait(&args.barrier);
+
+    return NULL;
+}
+
+START_TEST (safe_destroy)
+{
+    pthread_t thr[8];
+    size_t const n_thr(sizeof(thr)/sizeof(thr[0]));
+
+    for (int round(0); round < 100; ++round)
+    {
+        destroy_args args;
+        args.mp = new gu::MemPoolSafe(10, 1, "safe_destroy");
+        fail_if(pthread_barrier_init(&args.barrier, NULL, n_thr + 1));
+
+        for (size_t i(0); i < n_thr; ++i)
+        {
+            fail_if(pthread_create(&thr[i], NULL, destroy_thread, &args));
+        }
+
+        pthread_barrier_wait(&args.barrier);
+        delete args.mp;
+
+        for (size_t i(0); i < n_thr; ++i) pthread_join(thr[i], NULL);
+
+        pthread_barrier_destroy(&args.barrier);
+    }
+}
+END_TEST
+
 Suite *gu_mem_pool_suite(void)
 {
     Suite *s = suite_create("gu::MemPool");
@@ -64,6 +164,8 @@ Suite *gu_mem_pool_suite(void)
     suite_add_tcase (s, tc_mem);
     tcase_add_test(tc_mem, unsafe);
     tcase_add_test(tc_mem, safe);
+    tcase_add_test(tc_mem, safe_threads);
+    tcase_add_test(tc_mem, safe_destroy);
 
     return s;
 }
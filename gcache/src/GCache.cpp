@@ -6,22 +6,39 @@
 #include "gcache_bh.hpp"
 
 #include <gu_logger.hpp>
+#include <gu_time.h>
 
 #include <cerrno>
 #include <unistd.h>
 
 namespace gcache
 {
+    /* allocation size histogram bins, buffer header included */
+    static std::string const ALLOC_SIZES("0,128,256,512,1024,4096,16384,"
+                                         "65536,262144,1048576,4194304,"
+                                         "16777216,67108864");
+
     void
     GCache::reset()
     {
+        discard_page_buffers();
+
         mem.reset();
         rb.reset();
         ps.reset();
 
+        cold_discard(SEQNO_NONE);
+
         mallocs  = 0;
         reallocs = 0;
         frees    = 0;
+        mallocs_mem  = 0;
+        mallocs_rb   = 0;
+        mallocs_page = 0;
+        alloc_sizes.clear();
+        seqno_hits      = 0;
+        seqno_cold_hits = 0;
+        seqno_misses    = 0;
 
         seqno_locked   = SEQNO_NONE;
         seqno_max      = SEQNO_NONE;
@@ -29,6 +46,7 @@ namespace gcache
         gid            = gu::UUID();
 
         seqno2ptr.clear();
+        seqno_spilled.clear();
 
 #ifndef NDEBUG
         buf_tracker.clear();
@@ -42,37 +60,90 @@ namespace gcache
 #ifdef HAVE_PSI_INTERFACE
         mtx       (WSREP_PFS_INSTR_TAG_GCACHE_MUTEX),
         cond      (WSREP_PFS_INSTR_TAG_GCACHE_CONDVAR),
+        free_mtx  (WSREP_PFS_INSTR_TAG_GCACHE_MUTEX),
 #else
         mtx       (),
         cond      (),
+        free_mtx  (),
 #endif /* HAVE_PSI_INTERFACE */
+        free_queue(),
+        free_batch(),
         seqno2ptr (),
         gid       (),
         mem       (params.mem_size(), seqno2ptr),
-        rb        (params.rb_name(), params.rb_size(), seqno2ptr, gid,
-                   params.recover()),
         ps        (params.dir_name(),
                    params.keep_pages_size(),
                    params.page_size(),
                    /* keep last page if PS is the only storage */
                    params.keep_pages_count() ?
                    params.keep_pages_count() :
-                   !((params.mem_size() + params.rb_size()) > 0)),
+                   !((params.mem_size() + params.rb_size()) > 0),
+                   seqno2ptr, gid, params.recover(), params.page_reserve()),
+        rb        (params.rb_name(), params.rb_size(), seqno2ptr, gid,
+                   params.recover(), params.rb_mmap_opts(),
+                   params.recover_threads()),
         mallocs   (0),
         reallocs  (0),
         frees     (0),
+        mallocs_mem (0),
+        mallocs_rb  (0),
+        mallocs_page(0),
+        alloc_sizes (ALLOC_SIZES),
+        seqno_hits  (0),
+        seqno_cold_hits(0),
+        seqno_misses(0),
         seqno_locked(SEQNO_NONE),
+        seqno_lock_count(0),
         seqno_max   (seqno2ptr.empty() ?
                      SEQNO_NONE : seqno2ptr.rbegin()->first),
-        seqno_released(seqno_max)
+        seqno_released(seqno_max),
+        seqno_spilled(),
+        cold      (params.dir_name(), params.cold_size()),
+#ifdef HAVE_PSI_INTERFACE
+        cold_cond (WSREP_PFS_INSTR_TAG_GCACHE_CONDVAR),
+#else
+        cold_cond (),
+#endif /* HAVE_PSI_INTERFACE */
+        cold_next (SEQNO_NONE),
+        cold_gen  (0),
+        cold_exit (false),
+        cold_thr  (),
+        advisor   (gu_time_monotonic()),
+        rb_stats  (),
+        rb_stats_ok  (false),
+        rb_stats_time(0)
 #ifndef NDEBUG
         ,buf_tracker()
 #endif
-    {}
+    {
+        rb.seqno_release(seqno_released);
+
+        if (cold.enabled())
+        {
+            int const err(gu_thread_create(&cold_thr, NULL, cold_thread,
+                                           this));
+            if (0 != err)
+            {
+                gu_throw_error(err) << "Failed to start cold history thread";
+            }
+        }
+    }
 
     GCache::~GCache ()
     {
+        if (cold.enabled())
+        {
+            {
+                gu::Lock lock(mtx);
+                cold_exit = true;
+                cold_cond.signal();
+            }
+
+            gu_thread_join(cold_thr, NULL);
+        }
+
         gu::Lock lock(mtx);
+        free_queued();
         log_debug << "\n" << "GCache mallocs : " << mallocs
                   << "\n" << "GCache reallocs: " << reallocs
                   << "\n" << "GCache frees   : " << frees;
@@ -81,11 +152,92 @@ namespace gcache
     size_t GCache::allocated_pool_size ()
     {
         gu::Lock lock(mtx);
+        free_queued();
         return mem.allocated_pool_size() +
                rb.allocated_pool_size() +
                ps.allocated_pool_size();
     }
 
+    void
+    GCache::stats (Stats& st)
+    {
+        gu::Lock lock(mtx);
+        free_queued();
+
+        st.mallocs      = mallocs;
+        st.reallocs     = reallocs;
+        st.frees        = frees;
+        st.mallocs_mem  = mallocs_mem;
+        st.mallocs_rb   = mallocs_rb;
+        st.mallocs_page = mallocs_page;
+        /* histogram of nothing is all NaNs */
+        st.alloc_sizes  = mallocs > 0 ? alloc_sizes.to_string() : "";
+
+        st.rb_size  = rb.size();
+        st.rb_used  = rb.size_used();
+        st.rb_free  = rb.size_free();
+        st.rb_trail = rb.size_trail();
+        st.rb_wraps = rb.wraps();
+
+        st.pages         = ps.total_pages();
+        st.pages_size    = ps.total_size();
+        st.pages_created = ps.pages_created();
+        st.pages_deleted = ps.pages_deleted();
+
+        st.seqno_hits      = seqno_hits;
+        st.seqno_cold_hits = seqno_cold_hits;
+        st.seqno_misses    = seqno_misses;
+    }
+
+    bool
+    GCache::rb_mmap_stats (gu::MMap::Stats& st)
+    {
+        if (0 == params.rb_mmap_opts())
+        {
+            /* nothing to report but residency, mincore() is enough */
+            st = gu::MMap::Stats();
+            return rb.mmap_resident(st.resident);
+        }
+
+        long long const now(gu_time_monotonic());
+
+        {
+            gu::Lock lock(mtx);
+
+            if (rb_stats_time > 0 && now - rb_stats_time < RB_STATS_INTERVAL)
+            {
+                st = rb_stats;
+                return rb_stats_ok;
+            }
+        }
+
+        /* smaps is read without mtx, concurrent readers just repeat it */
+        bool const ok(rb.mmap_stats(st));
+
+        gu::Lock lock(mtx);
+
+        rb_stats      = st;
+        rb_stats_ok   = ok;
+        rb_stats_time = now;
+
+        return ok;
+    }
+
+    void
+    GCache::advice_locked (Advice& a)
+    {
+        int64_t const min(seqno_min_locked());
+
+        advisor.advice(a, min > 0 ? seqno_max - min + 1 : 0,
+                       gu_time_monotonic());
+    }
+
+    void GCache::advice (Advice& a)
+    {
+        gu::Lock lock(mtx);
+        advice_locked(a);
+    }
+
     /*! prints object properties */
     void print (std::ostream& os) {}
 }
@@ -8,13 +8,18 @@
 #include "gcache_mem_store.hpp"
 #include "gcache_rb_store.hpp"
 #include "gcache_page_store.hpp"
+#include "gcache_cold_store.hpp"
+#include "gcache_advisor.hpp"
 #include "gcache_types.hpp"
 
 #include <gu_types.hpp>
 #include <gu_lock.hpp> // for gu::Mutex and gu::Cond
 #include <gu_config.hpp>
+#include <gu_histogram.hpp>
 
 #include <string>
+#include <vector>
+#include <deque>
 #include <iostream>
 #ifndef NDEBUG
 #include <set>
@@ -78,17 +83,18 @@ namespace gcache
         int64_t seqno_min() const
         {
             gu::Lock lock(mtx);
-            if (gu_likely(!seqno2ptr.empty()))
-                return seqno2ptr.begin()->first;
-            else
-                return -1;
+            return seqno_min_locked();
         }
 
         /*!
-         * Move lock to a given seqno.
+         * Add a history lock at a given seqno. Every successful call must be
+         * paired with seqno_unlock(). While several locks are held, history
+         * is kept from the oldest of them on. Unless ist_request is false,
+         * the call is counted as an IST request, see Advisor: additional
+         * locks taken for the same IST should pass false.
          * @throws gu::NotFound if seqno is not in the cache.
          */
-        void  seqno_lock (int64_t const seqno_g);
+        void  seqno_lock (int64_t const seqno_g, bool ist_request = true);
 
         /*!          DEPRECATED
          * Get pointer to buffer identified by seqno.
@@ -104,6 +110,77 @@ namespace gcache
          */
         size_t allocated_pool_size ();
 
+        /*!
+         * Returns ring buffer memory residency, see gu::MMap::stats().
+         * Huge pages and locked memory are reported only if the ring buffer
+         * is set up to use them, and then at most every RB_STATS_INTERVAL.
+         */
+        bool rb_mmap_stats (gu::MMap::Stats& st);
+
+
+        struct ColdStats
+        {
+            ColdStats() : seqno_min(-1), seqno_max(-1), segments(0), size(0),
+                          raw_size(0) {}
+
+            int64_t seqno_min;
+            int64_t seqno_max;
+            size_t  segments;
+            size_t  size;     // of segment files
+            size_t  raw_size; // of buffers in them
+        };
+
+        /*!
+         * Returns cold history tier usage, see ColdStore.
+         */
+        void cold_stats (ColdStats& st) const;
+
+        struct Stats
+        {
+            Stats() : mallocs(0), reallocs(0), frees(0), mallocs_mem(0),
+                      mallocs_rb(0), mallocs_page(0), alloc_sizes(),
+                      rb_size(0), rb_used(0), rb_free(0), rb_trail(0),
+                      rb_wraps(0), pages(0), pages_size(0),
+                      pages_created(0), pages_deleted(0), seqno_hits(0),
+                      seqno_cold_hits(0), seqno_misses(0) {}
+
+            long long   mallocs;
+            long long   reallocs;
+            long long   frees;
+            /* stores the buffers were allocated in */
+            long long   mallocs_mem;
+            long long   mallocs_rb;
+            long long   mallocs_page;
+            /* distribution of allocation sizes, see gu::Histogram */
+            std::string alloc_sizes;
+            /* ring buffer fragmentation: the rest of it is released history */
+            size_t      rb_size;
+            size_t      rb_used;  // by unreleased buffers
+            size_t      rb_free;
+            size_t      rb_trail; // part of free space unusable at the end
+            long long   rb_wraps;
+            size_t      pages;
+            size_t      pages_size;
+            long long   pages_created;
+            long long   pages_deleted;
+            /* seqno lookups by IST and such */
+            long long   seqno_hits;
+            long long   seqno_cold_hits;
+            long long   seqno_misses;
+        };
+
+        /*!
+         * Returns allocation, store and lookup statistics.
+         */
+        void stats (Stats& st);
+
+        typedef Advisor::Advice Advice;
+
+        /*!
+         * Returns write rate, IST demand and recommended history size,
+         * see Advisor.
+         */
+        void advice (Advice& a);
 
         /*!
          * Implements the cleanup policy test.
@@ -119,14 +196,15 @@ namespace gcache
         {
         public:
 
-            Buffer() : seqno_g_(), seqno_d_(), ptr_(), size_() { }
+            Buffer() : seqno_g_(), seqno_d_(), ptr_(), size_(), thawed_() { }
 
             Buffer (const Buffer& other)
                 :
                 seqno_g_(other.seqno_g_),
                 seqno_d_(other.seqno_d_),
                 ptr_    (other.ptr_),
-                size_   (other.size_)
+                size_   (other.size_),
+                thawed_ (other.thawed_)
             { }
 
             Buffer& operator= (const Buffer& other)
@@ -135,6 +213,7 @@ namespace gcache
                 seqno_d_ = other.seqno_d_;
                 ptr_     = other.ptr_;
                 size_    = other.size_;
+                thawed_  = other.thawed_;
                 return *this;
             }
 
@@ -148,6 +227,13 @@ namespace gcache
             void set_ptr   (const void* p)
             {
                 ptr_ = reinterpret_cast<const gu::byte_t*>(p);
+                thawed_.reset();
+            }
+
+            void set_ptr   (const void* p, const ColdStore::ThawedPtr& t)
+            {
+                ptr_    = reinterpret_cast<const gu::byte_t*>(p);
+                thawed_ = t;
             }
 
             void set_other (int64_t g, int64_t d, ssize_type s)
@@ -162,21 +248,44 @@ namespace gcache
             int64_t           seqno_d_;
             const gu::byte_t* ptr_;
             ssize_type        size_; /* same type as passed to malloc() */
+            ColdStore::ThawedPtr thawed_; /* holds cold history buffer */
 
             friend class GCache;
         };
 
         /*!
-         * Fills a vector with Buffer objects starting with seqno start
-         * until either vector length or seqno map is exhausted.
+         * Fills a vector with Buffer objects for seqnos start,
+         * start + stride, start + 2*stride, ... until either vector length
+         * or seqno map is exhausted.
          * Moves seqno lock to start.
          *
          * @retval number of buffers filled (<= v.size())
          */
-        size_t seqno_get_buffers (std::vector<Buffer>& v, int64_t start);
+        size_t seqno_get_buffers (std::vector<Buffer>& v, int64_t start,
+                                  size_t stride = 1);
 
         /*!
-         * Releases any seqno locks present.
+         * Advises the kernel that buffers of up to count seqnos starting
+         * with start and stride apart will be needed soon, so that they can
+         * be read in from disk in the background. Does not move seqno lock
+         * and does not block on IO.
+         */
+        void seqno_prefetch (int64_t start, size_t count, size_t stride = 1);
+
+        /*!
+         * Locates the file which backs a buffer returned by
+         * seqno_get_buffers(), so that it can be sent straight from the
+         * file. The buffer must stay locked while the file is used.
+         *
+         * @retval true with descriptor and offset of ptr in the file, or
+         *         false if the buffer is not backed by a file
+         */
+        bool seqno_file_location (const void* ptr, int& fd,
+                                  off_t& offset) const;
+
+        /*!
+         * Releases a lock taken by seqno_lock(), or any lock moved by
+         * seqno_get_buffers() if none was taken.
          */
         void seqno_unlock ();
 
@@ -189,7 +298,44 @@ namespace gcache
 
         typedef MemOps::size_type size_type;
 
-        void free_common (BufferHeader*);
+        /* number of queued free() calls that makes the caller return them
+         * to the stores itself instead of waiting for the next malloc() */
+        static size_t const FREE_BATCH = 32;
+
+        void* malloc_common (size_type size);
+        void  free_common   (BufferHeader*);
+
+        /* returns buffers queued by free() to their stores, must be called
+         * with mtx locked */
+        void  free_queued   ();
+
+        /* cold history: seqnos are compressed in runs of at least
+         * COLD_BATCH, into segments of up to COLD_SEGMENT bytes, copying
+         * at most COLD_STEP bytes at a time under mtx */
+        static int64_t const COLD_BATCH   = 256;
+        static size_t  const COLD_SEGMENT = 4 << 20;
+        static size_t  const COLD_STEP    = 1 << 20;
+
+        /* nanoseconds between ring buffer smaps readings */
+        static long long const RB_STATS_INTERVAL = 1000000000LL;
+
+        static void* cold_thread (void* arg);
+        void  cold_loop ();
+
+        /* the following must be called with mtx locked */
+        int64_t cold_end () const; /* last seqno which can be compressed */
+        bool  cold_ready ();
+        bool  cold_collect (std::vector<uint8_t>& image,
+                            int64_t& first, int64_t& last);
+        void  cold_notify ()
+        {
+            if (gu_unlikely(cold.enabled()) && cold_ready()) cold_cond.signal();
+        }
+        void  cold_discard (int64_t s); /* cold history after s */
+        void  cold_skip    (int64_t s); /* continue compression from s */
+
+        size_t seqno_get_cold (std::vector<Buffer>& v, int64_t start,
+                               size_t stride = 1);
 
         gu::Config&     config;
 
@@ -209,7 +355,13 @@ namespace gcache
             size_t page_size()           const { return page_size_;        }
             size_t keep_pages_size()     const { return keep_pages_size_;  }
             size_t keep_pages_count()    const { return keep_pages_count_; }
+            size_t page_reserve()        const { return page_reserve_;     }
+            int    rb_mmap_opts()        const { return rb_mmap_opts_;     }
             bool   recover()             const { return recover_;         }
+            int    recover_threads()     const { return recover_threads_;  }
+            size_t cold_size()           const { return cold_size_;        }
+            size_t keep_pages_budget()   const { return keep_pages_budget_; }
+            int64_t cold_age()           const { return cold_age_;         }
 
             bool skip_purge(seqno_t seqno)
             {
@@ -221,6 +373,8 @@ namespace gcache
             void page_size        (size_t s) { page_size_        = s; }
             void keep_pages_size  (size_t s) { keep_pages_size_  = s; }
             void keep_pages_count (size_t c) { keep_pages_count_ = c; }
+            void cold_age         (int64_t a){ cold_age_         = a; }
+            void keep_pages_budget(size_t s) { keep_pages_budget_ = s; }
             void freeze_purge_at_seqno(seqno_t s) { freeze_purge_at_seqno_ = s; }
 
         private:
@@ -232,7 +386,13 @@ namespace gcache
             size_t            page_size_;
             size_t            keep_pages_size_;
             size_t            keep_pages_count_;
+            size_t      const page_reserve_;
+            int         const rb_mmap_opts_;
             bool        const recover_;
+            int         const recover_threads_;
+            size_t      const cold_size_;
+            int64_t           cold_age_;
+            size_t            keep_pages_budget_;
             seqno_t           freeze_purge_at_seqno_;
         }
             params;
@@ -245,26 +405,105 @@ namespace gcache
         gu::Cond        cond;
 #endif /* HAVE_PSI_INTERFACE */
 
+        /* free() only queues buffers under free_mtx, they are returned to
+         * the stores in batches under mtx, mostly by the allocating thread,
+         * so that releasing threads don't serialize with allocation.
+         * Lock order: mtx, free_mtx. */
+#ifdef HAVE_PSI_INTERFACE
+        gu::MutexWithPFS free_mtx;
+#else
+        gu::Mutex        free_mtx;
+#endif /* HAVE_PSI_INTERFACE */
+        std::vector<BufferHeader*> free_queue; // protected by free_mtx
+        std::vector<BufferHeader*> free_batch; // protected by mtx
 
         seqno2ptr_t     seqno2ptr;
         gu::UUID        gid;
 
         MemStore        mem;
+        PageStore       ps;  /* recovers before rb, see RingBuffer::recover() */
         RingBuffer      rb;
-        PageStore       ps;
 
         long long       mallocs;
         long long       reallocs;
         long long       frees;
+        long long       mallocs_mem;
+        long long       mallocs_rb;
+        long long       mallocs_page;
+        gu::Histogram   alloc_sizes;
+        long long       seqno_hits;
+        long long       seqno_cold_hits;
+        long long       seqno_misses;
 
         int64_t         seqno_locked;
+        long            seqno_lock_count; /* locks held by seqno_lock() */
         int64_t         seqno_max;
         int64_t         seqno_released;
 
+        /* seqnos of buffers outside of the ring buffer: unlike RB buffers
+         * they must be marked released and their pages discarded one by one
+         * in seqno_release() */
+        std::deque<int64_t> seqno_spilled;
+
+        /* cold history tier, filled by cold_thr */
+        ColdStore       cold;
+#ifdef HAVE_PSI_INTERFACE
+        gu::CondWithPFS cold_cond;
+#else
+        gu::Cond        cold_cond;
+#endif /* HAVE_PSI_INTERFACE */
+        int64_t         cold_next; /* next seqno to compress */
+        long            cold_gen;  /* changes when cold history is discarded */
+        bool            cold_exit;
+        pthread_t       cold_thr;
+
+        Advisor         advisor;
+
+        /* last ring buffer smaps reading, protected by mtx */
+        gu::MMap::Stats rb_stats;
+        bool            rb_stats_ok;
+        long long       rb_stats_time; /* 0 if never read */
+
+        /* the following must be called with mtx locked */
+
+        /* moves the lock to seqno s, unless other locks are held as well:
+         * one holder can't tell how far the others are */
+        void seqno_lock_move (int64_t const s)
+        {
+            if (seqno_lock_count > 1) return;
+
+            if (seqno_locked != SEQNO_NONE) cond.signal();
+
+            seqno_locked = s;
+        }
+
+        int64_t seqno_min_locked () const
+        {
+            /* cold history counts if it continues into the hot one */
+            if (gu_unlikely(cold.count() > 0) &&
+                (seqno2ptr.empty() ||
+                 cold.seqno_max() + 1 >= seqno2ptr.begin()->first))
+                return cold.seqno_min();
+            else if (gu_likely(!seqno2ptr.empty()))
+                return seqno2ptr.begin()->first;
+            else
+                return -1;
+        }
+        void    advice_locked  (Advice& a);
+        /* grows keep_pages_size up to keep_pages_budget to hold the
+         * recommended history */
+        void    keep_pages_grow ();
+
 #ifndef NDEBUG
         std::set<const void*> buf_tracker;
 #endif
 
+        /* ordered buffers are released in bulk, see RingBuffer */
+        bool released (const BufferHeader* bh) const
+        {
+            return rb.released(bh);
+        }
+
         void discard_buffer (BufferHeader* bh);
 
         /* returns true when successfully discards all seqnos up to s */
@@ -273,6 +512,13 @@ namespace gcache
         /* discards all seqnos greater than s */
         void discard_tail (int64_t s);
 
+        /* discards history from the oldest pages while page store exceeds
+         * keep_pages_size/keep_pages_count */
+        void discard_pages ();
+
+        /* discards all released buffers held in pages */
+        void discard_page_buffers ();
+
         // disable copying
         GCache (const GCache&);
         GCache& operator = (const GCache&);
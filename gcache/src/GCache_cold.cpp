@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file cold history tier: compression of old history in background and
+ *        serving it to IST, see ColdStore */
+
+#include "GCache.hpp"
+#include "gcache_bh.hpp"
+#include "gcache_limits.hpp"
+
+#include <gu_logger.hpp>
+
+#include <algorithm>
+
+namespace gcache
+{
+    int64_t
+    GCache::cold_end () const
+    {
+        return std::min(seqno_released, seqno_max - params.cold_age());
+    }
+
+    bool
+    GCache::cold_ready ()
+    {
+        if (seqno2ptr.empty()) return false;
+
+        /* history discarded before it could be compressed is lost */
+        cold_skip(seqno2ptr.begin()->first);
+
+        return (cold_end() - cold_next + 1 >= COLD_BATCH);
+    }
+
+    /* Copies up to COLD_STEP bytes of consecutive buffers starting with
+     * cold_next to the image. Returns true if the segment is complete. */
+    bool
+    GCache::cold_collect (std::vector<uint8_t>& image,
+                          int64_t& first, int64_t& last)
+    {
+        int64_t const end(cold_end());
+        size_t  const limit(std::min(image.size() + COLD_STEP, COLD_SEGMENT));
+
+        seqno2ptr_iter_t p(seqno2ptr.lower_bound(cold_next));
+
+        if (image.empty())
+        {
+            /* skip the gap in history */
+            if (p != seqno2ptr.end()) cold_skip(p->first);
+
+            if (p == seqno2ptr.end() || p->first > end) return true;
+
+            first = p->first;
+            last  = first - 1;
+        }
+
+        while (p != seqno2ptr.end() && p->first == last + 1 &&
+               p->first <= end && image.size() < limit)
+        {
+            const BufferHeader* const bh(ptr2BH(p->second));
+
+            assert(bh->seqno_g == p->first);
+            assert(released(bh));
+
+            ColdStore::image_append(image, bh);
+            last = p->first;
+            ++p;
+        }
+
+        cold_next = last + 1;
+
+        return (image.size() >= COLD_SEGMENT || p == seqno2ptr.end() ||
+                p->first != last + 1 || p->first > end);
+    }
+
+    void
+    GCache::cold_discard (int64_t const s)
+    {
+        if (SEQNO_NONE == s)
+            cold.reset();
+        else
+            cold.discard_tail(s);
+
+        cold_next = cold.count() > 0 ? cold.seqno_max() + 1 : SEQNO_NONE;
+        cold_gen++;
+    }
+
+    /* Cold history must be gapless to be served together with the hot one,
+     * so what precedes a gap is dropped, together with a segment being
+     * collected */
+    void
+    GCache::cold_skip (int64_t const s)
+    {
+        if (s <= cold_next) return;
+
+        if (SEQNO_NONE != cold_next)
+        {
+            if (cold.count() > 0)
+            {
+                log_info << "Discarding cold history " << cold.seqno_min()
+                         << '-' << cold.seqno_max() << ": seqnos "
+                         << cold_next << '-' << s - 1 << " were discarded "
+                         << "before they could be compressed";
+                cold.reset();
+            }
+
+            cold_gen++;
+        }
+
+        cold_next = s;
+    }
+
+    void*
+    GCache::cold_thread (void* arg)
+    {
+        static_cast<GCache*>(arg)->cold_loop();
+        return NULL;
+    }
+
+    void
+    GCache::cold_loop ()
+    {
+        std::vector<uint8_t> image;
+        int64_t first(SEQNO_NONE), last(SEQNO_NONE);
+        long    gen(0);
+
+        for (;;)
+        {
+            bool complete;
+
+            {
+                gu::Lock lock(mtx);
+
+                if (!image.empty() && (gen != cold_gen || cold_exit))
+                {
+                    image.clear(); // history changed under us
+                }
+
+                bool const start(image.empty());
+
+                if (start)
+                {
+                    while (!cold_exit && !cold_ready()) lock.wait(cold_cond);
+
+                    if (cold_exit) break;
+                }
+
+                complete = cold_collect(image, first, last);
+
+                /* starting a segment may skip a gap, see cold_skip() */
+                if (start) gen = cold_gen;
+            }
+
+            if (!complete || image.empty()) continue;
+
+            try
+            {
+                ColdStore::Segment const seg(cold.write(image, first, last));
+
+                gu::Lock lock(mtx);
+
+                if (gen == cold_gen)
+                {
+                    cold.add(seg, seqno_locked);
+
+                    log_debug << "Compressed seqnos " << first << '-' << last
+                              << ": " << seg.raw_size << " -> " << seg.size
+                              << " bytes, cold history " << cold.seqno_min()
+                              << '-' << cold.seqno_max() << ", "
+                              << cold.size() << " bytes";
+                }
+                else
+                {
+                    ColdStore::remove(seg);
+                }
+            }
+            catch (gu::Exception& e)
+            {
+                log_warn << "Failed to compress seqnos " << first << '-'
+                         << last << " to cold history: " << e.what();
+            }
+
+            image.clear();
+        }
+    }
+
+    /* Serves buffers from start on, stride apart, from the cold history,
+     * thawing segments outside of the lock. Thawed segments are cached until
+     * seqno lock moves past them, and the returned buffers hold them in
+     * memory. */
+    size_t
+    GCache::seqno_get_cold (std::vector<Buffer>& v, int64_t const start,
+                            size_t const stride)
+    {
+        size_t const max(v.size());
+        size_t       found(0);
+
+        for (;;)
+        {
+            ColdStore::Segment seg;
+            long               gen;
+
+            {
+                gu::Lock lock(mtx);
+
+                if (0 == found)
+                {
+                    if (0 == cold.find(start))
+                    {
+                        seqno_misses++;
+                        break;
+                    }
+
+                    seqno_cold_hits++;
+
+                    seqno_lock_move(start);
+                    cold.release_thawed(seqno_locked);
+                }
+
+                ColdStore::ThawedPtr holder;
+                const void*          ptr;
+
+                while (found < max &&
+                       (ptr = cold.thawed_ptr(start + found * stride,
+                                              holder)) != 0)
+                {
+                    v[found].set_ptr(ptr, holder);
+                    ++found;
+                }
+
+                if (found == max) break;
+
+                const ColdStore::Segment* const s(
+                    cold.find(start + found * stride));
+
+                if (0 == s) break;
+
+                seg = *s;
+                gen = cold_gen;
+            }
+
+            ColdStore::ThawedPtr t;
+
+            try
+            {
+                t = ColdStore::thaw(seg);
+            }
+            catch (gu::Exception& e)
+            {
+                log_warn << "Failed to read cold history segment: "
+                         << e.what();
+                break;
+            }
+
+            gu::Lock lock(mtx);
+
+            if (gen != cold_gen) break;
+
+            cold.add_thawed(t);
+        }
+
+        for (size_t i(0); i < found; ++i)
+        {
+            const BufferHeader* const bh (ptr2BH(v[i].ptr()));
+
+            assert (bh->seqno_g == int64_t(start + i * stride));
+            Limits::assert_size(bh->size);
+
+            v[i].set_other (bh->seqno_g,
+                            bh->seqno_d,
+                            bh->size - sizeof(BufferHeader));
+        }
+
+        return found;
+    }
+
+    void
+    GCache::cold_stats (ColdStats& st) const
+    {
+        gu::Lock lock(mtx);
+
+        st.seqno_min = cold.count() > 0 ? cold.seqno_min() : -1;
+        st.seqno_max = cold.count() > 0 ? cold.seqno_max() : -1;
+        st.segments  = cold.count();
+        st.size      = cold.size();
+        st.raw_size  = cold.raw_size();
+    }
+}
@@ -4,6 +4,7 @@
 
 #include "GCache.hpp"
 
+#include <algorithm>
 #include <cassert>
 
 namespace gcache
@@ -11,6 +12,7 @@ namespace gcache
     void
     GCache::discard_buffer (BufferHeader* bh)
     {
+        if (!BH_is_released(bh)) BH_release(bh); // released in bulk
         bh->seqno_g = SEQNO_ILL; // will never be reused
         switch (bh->store)
         {
@@ -35,7 +37,7 @@ namespace gcache
 
             BufferHeader* bh(ptr2BH (i->second));
 
-            if (gu_likely(BH_is_released(bh)))
+            if (gu_likely(released(bh)))
             {
                 assert (bh->seqno_g == i->first);
                 assert (bh->seqno_g <= seqno);
@@ -62,7 +64,7 @@ namespace gcache
         {
             BufferHeader* bh(ptr2BH(r->second));
 
-            assert(BH_is_released(bh));
+            assert(released(bh));
             assert(bh->seqno_g == r->first);
             assert(bh->seqno_g > seqno);
 
@@ -71,6 +73,62 @@ namespace gcache
         }
     }
 
+    void
+    GCache::discard_pages ()
+    {
+        while (cleanup_required())
+        {
+            size_t  const pages(ps.total_pages());
+            int64_t const seqno(std::min(ps.oldest_seqno_max(),
+                                         seqno_released));
+
+            if (seqno <= 0 || !discard_seqno(seqno) ||
+                ps.total_pages() == pages) break;
+        }
+    }
+
+    void
+    GCache::discard_page_buffers ()
+    {
+        for (seqno2ptr_t::iterator i(seqno2ptr.begin()); i != seqno2ptr.end();)
+        {
+            BufferHeader* const bh(ptr2BH(i->second));
+
+            if (BUFFER_IN_PAGE == bh->store && released(bh))
+            {
+                seqno2ptr.erase(i++);
+                discard_buffer(bh);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    void*
+    GCache::malloc_common (size_type const size)
+    {
+        free_queued(); // make room for the new buffer first
+
+        mallocs++;
+        alloc_sizes.insert(size);
+
+        void* ptr(mem.malloc(size));
+
+        if (0 != ptr)
+            mallocs_mem++;
+        else if (0 != (ptr = rb.malloc(size)))
+            mallocs_rb++;
+        else if (0 != (ptr = ps.malloc(size)))
+            mallocs_page++;
+
+#ifndef NDEBUG
+        if (0 != ptr) buf_tracker.insert (ptr);
+#endif
+        return ptr;
+    }
+
     void*
     GCache::malloc (ssize_type const s)
     {
@@ -84,17 +142,7 @@ namespace gcache
 
             gu::Lock lock(mtx);
 
-            mallocs++;
-
-            ptr = mem.malloc(size);
-
-            if (0 == ptr) ptr = rb.malloc(size);
-
-            if (0 == ptr) ptr = ps.malloc(size);
-
-#ifndef NDEBUG
-            if (0 != ptr) buf_tracker.insert (ptr);
-#endif
+            ptr = malloc_common(size);
         }
 
         assert((uintptr_t(ptr) % MemOps::ALIGNMENT) == 0);
@@ -108,7 +156,9 @@ namespace gcache
         assert(bh->seqno_g != SEQNO_ILL);
         BH_release(bh);
 
-        if (gu_likely(SEQNO_NONE != bh->seqno_g))
+        /* ordered buffer freed ahead of seqno_release() */
+        if (gu_likely(SEQNO_NONE != bh->seqno_g) &&
+            bh->seqno_g > seqno_released)
         {
 #ifndef NDEBUG
             if (!(seqno_released + 1 == bh->seqno_g ||
@@ -121,6 +171,8 @@ namespace gcache
                    SEQNO_NONE == seqno_released);
 #endif
             seqno_released = bh->seqno_g;
+            rb.seqno_release(seqno_released);
+            cold_notify();
         }
 #ifndef NDEBUG
         void* const ptr(bh + 1);
@@ -141,7 +193,24 @@ namespace gcache
         case BUFFER_IN_PAGE:
             if (gu_likely(bh->seqno_g > 0))
             {
-                discard_seqno (bh->seqno_g);
+                seqno2ptr_t::iterator const i(seqno2ptr.find(bh->seqno_g));
+
+                if (gu_unlikely(i == seqno2ptr.end() || i->second != bh + 1))
+                {
+                    /* history was reset while the buffer was in use */
+                    bh->seqno_g = SEQNO_ILL;
+                    ps.discard (bh);
+                }
+                else if (params.keep_pages_size() || params.keep_pages_count())
+                {
+                    /* keep page buffers in history while the page store
+                     * is within limits, they can be served by IST */
+                    discard_pages();
+                }
+                else
+                {
+                    discard_seqno (bh->seqno_g);
+                }
             }
             else
             {
@@ -154,15 +223,48 @@ namespace gcache
         rb.assert_size_free();
     }
 
+    void
+    GCache::free_queued ()
+    {
+        {
+            gu::Lock lock(free_mtx);
+
+            if (free_queue.empty()) return;
+
+            free_batch.swap(free_queue);
+        }
+
+        for (size_t i(0); i < free_batch.size(); ++i)
+        {
+            free_common (free_batch[i]);
+        }
+
+        free_batch.clear();
+    }
+
     void
     GCache::free (void* ptr)
     {
         if (gu_likely(0 != ptr))
         {
             BufferHeader* const bh(ptr2BH(ptr));
-            gu::Lock      lock(mtx);
+            size_t              queued;
+
+            {
+                gu::Lock lock(free_mtx);
+
+                free_queue.push_back(bh);
+                queued = free_queue.size();
+            }
 
-            free_common (bh);
+            /* normally the queue is drained by the next malloc(), but
+             * don't let it grow if nothing is being allocated */
+            if (gu_unlikely(queued >= FREE_BATCH))
+            {
+                gu::Lock lock(mtx);
+
+                free_queued();
+            }
         }
         else {
             log_warn << "Attempt to free a null pointer";
@@ -201,6 +303,8 @@ namespace gcache
 
         gu::Lock      lock(mtx);
 
+        free_queued();
+
         reallocs++;
 
         MemOps* store(0);
@@ -220,7 +324,7 @@ namespace gcache
 
         if (0 == new_ptr)
         {
-            new_ptr = malloc (size);
+            new_ptr = malloc_common (size);
 
             if (0 != new_ptr)
             {
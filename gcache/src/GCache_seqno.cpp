@@ -5,10 +5,14 @@
 #include "gcache_bh.hpp"
 #include "GCache.hpp"
 
+#include "gu_limits.h"
+#include "gu_time.h"
+
+#include <algorithm>
 #include <cerrno>
 #include <cassert>
 
-#include <sched.h> // sched_yeild()
+#include <sys/mman.h> // posix_madvise()
 
 namespace gcache
 {
@@ -21,6 +25,8 @@ namespace gcache
     {
         gu::Lock lock(mtx);
 
+        free_queued();
+
         assert(seqno2ptr.empty() || seqno_max == seqno2ptr.rbegin()->first);
 
         if (g == gid && s != SEQNO_ILL && seqno_max >= s)
@@ -30,6 +36,14 @@ namespace gcache
                 discard_tail(s);
                 seqno_max = s;
                 seqno_released = s;
+                rb.seqno_release(s);
+
+                while (!seqno_spilled.empty() && seqno_spilled.back() > s)
+                {
+                    seqno_spilled.pop_back();
+                }
+
+                cold_discard(s);
             }
             return;
         }
@@ -41,11 +55,16 @@ namespace gcache
         gid = g;
 
         /* order is significant here */
+        discard_page_buffers();
         rb.seqno_reset();
         mem.seqno_reset();
+        ps.seqno_reset();
 
         seqno2ptr.clear();
+        seqno_spilled.clear();
         seqno_max = SEQNO_NONE;
+
+        cold_discard(SEQNO_NONE);
     }
 
     /*!
@@ -85,112 +104,140 @@ namespace gcache
 
         bh->seqno_g = seqno_g;
         bh->seqno_d = seqno_d;
+
+        advisor.written(bh->size);
+
+        rb.seqno_assigned(seqno_g, bh);
+
+        if (gu_unlikely(BUFFER_IN_RB != bh->store))
+        {
+            if (BUFFER_IN_PAGE == bh->store)
+            {
+                static_cast<Page*>(bh->ctx)->seqno_assigned(seqno_g);
+            }
+
+            if (gu_likely(seqno_spilled.empty() ||
+                          seqno_spilled.back() < seqno_g))
+            {
+                seqno_spilled.push_back(seqno_g);
+            }
+            else
+            {
+                seqno_spilled.insert(std::lower_bound(seqno_spilled.begin(),
+                                                      seqno_spilled.end(),
+                                                      seqno_g), seqno_g);
+            }
+        }
     }
 
     void
     GCache::seqno_release (int64_t const seqno)
     {
         assert (seqno > 0);
-        /* The number of buffers scheduled for release is unpredictable, so
-         * we want to allow some concurrency in cache access by releasing
-         * buffers in small batches */
-        static int const min_batch_size(32);
 
-        /* Although extremely unlikely, theoretically concurrent access may
-         * lead to elements being added faster than released. The following is
-         * to control and possibly disable concurrency in that case. We start
-         * with min_batch_size and increase it if necessary. */
-        size_t old_gap(-1);
-        int    batch_size(min_batch_size);
+        gu::Lock lock(mtx);
+
+        /* queued buffers look unreleased, don't free them twice */
+        free_queued();
 
-        bool   loop(false);
+        /* seqnos can be released before they are assigned, but only
+         * present history can be released */
+        int64_t const end(std::min(seqno, seqno_max));
 
-        do
+        if (gu_unlikely(end <= seqno_released))
         {
-            /* if we're doing this loop repeatedly, allow other threads to run*/
-            if (loop) sched_yield();
+            if (seqno > seqno_released && SEQNO_NONE != seqno_released)
+            {
+                log_debug << "Releasing seqno " << seqno << " before "
+                          << seqno_released + 1 << " was assigned.";
+            }
+            return;
+        }
 
-            gu::Lock lock(mtx);
+#ifndef NDEBUG
+        for (seqno2ptr_iter_t i(seqno2ptr.upper_bound(seqno_released));
+             i != seqno2ptr.end() && i->first <= end; ++i)
+        {
+            buf_tracker.erase(i->second);
+        }
+#endif
+
+        /* Buffers in the ring buffer are released all at once, without
+         * touching them: RingBuffer accounts for the released space and
+         * treats buffers up to seqno_released as released when it gets
+         * to discard them. */
+        seqno_released = end;
+        rb.seqno_release(seqno_released);
+        cold_notify();
+
+        /* The rest must be marked released explicitly, and released page
+         * buffers are discarded right away together with the preceding
+         * history, as in free_common() */
+        int64_t page_seqno(SEQNO_NONE);
+
+        while (!seqno_spilled.empty() && seqno_spilled.front() <= end)
+        {
+            int64_t const s(seqno_spilled.front());
+            seqno_spilled.pop_front();
+
+            seqno2ptr_iter_t const i(seqno2ptr.find(s));
+
+            if (i == seqno2ptr.end()) continue; // discarded already
+
+            BufferHeader* const bh(ptr2BH(i->second));
 
-            assert(seqno >= seqno_released);
+            if (BH_is_released(bh)) continue; // released by free()
 
-            seqno2ptr_iter_t it(seqno2ptr.upper_bound(seqno_released));
+            BH_release(bh);
+            frees++;
 
-            if (gu_unlikely(it == seqno2ptr.end()))
+            if (BUFFER_IN_PAGE == bh->store) page_seqno = s;
+        }
+
+        if (page_seqno > 0)
+        {
+            if (params.keep_pages_size() || params.keep_pages_count())
             {
-                /* This means that there are no element with
-                 * seqno following seqno_released - and this should not
-                 * generally happen. But it looks like stopcont test does it. */
-                if (SEQNO_NONE != seqno_released)
-                {
-                    log_debug << "Releasing seqno " << seqno << " before "
-                              << seqno_released + 1 << " was assigned.";
-                }
-                return;
+                discard_pages();
             }
-
-            assert(seqno_max >= seqno_released);
-
-            /* here we check if (seqno_max - seqno_released) is decreasing
-             * and if not - increase the batch_size (linearly) */
-            size_t const new_gap(seqno_max - seqno_released);
-            batch_size += (new_gap >= old_gap) * min_batch_size;
-            old_gap = new_gap;
-
-            int64_t const start(it->first - 1);
-            int64_t const end  (seqno - start >= 2*batch_size ?
-                                start + batch_size : seqno);
-#if 0
-            log_info << "############ releasing " << (seqno - start)
-                     << " buffers, batch_size: " << batch_size
-                     << ", end: " << end;
-#endif
-            for (;(loop = (it != seqno2ptr.end())) && it->first <= end;)
+            else
             {
-                assert(it->first != SEQNO_NONE);
-                BufferHeader* const bh(ptr2BH(it->second));
-                assert (bh->seqno_g == it->first);
-#ifndef NDEBUG
-                if (!(seqno_released + 1 == it->first ||
-                      seqno_released == SEQNO_NONE))
-                {
-                    log_info << "seqno_released: " << seqno_released
-                             << "; it->first: " << it->first
-                             << "; seqno2ptr.begin: " <<seqno2ptr.begin()->first
-                             << "\nstart: " << start << "; end: " << end
-                             << " batch_size: " << batch_size << "; gap: "
-                             << new_gap << "; seqno_max: " << seqno_max;
-                    assert(seqno_released + 1 == it->first ||
-                           seqno_released == SEQNO_NONE);
-                }
-#endif
-                ++it; /* free_common() below may erase current element,
-                       * so advance iterator before calling free_common()*/
-                if (gu_likely(!BH_is_released(bh))) free_common(bh);
+                discard_seqno(page_seqno);
             }
-
-            assert (loop || seqno == seqno_released);
-
-            loop = (end < seqno) && loop;
         }
-        while(loop);
     }
 
     /*!
-     * Move lock to a given seqno. Throw gu::NotFound if seqno is not in cache.
+     * Add lock at a given seqno. Throw gu::NotFound if seqno is not in cache.
      * @throws NotFound
      */
-    void GCache::seqno_lock (int64_t const seqno_g)
+    void GCache::seqno_lock (int64_t const seqno_g, bool const ist_request)
     {
         gu::Lock lock(mtx);
 
-        if (seqno2ptr.find(seqno_g) == seqno2ptr.end()) throw gu::NotFound();
+        bool const found(seqno2ptr.find(seqno_g) != seqno2ptr.end() ||
+                         0 != cold.find(seqno_g));
 
-        if (seqno_locked != SEQNO_NONE)
+        /* this is where IST requests come, see Advisor */
+        if (ist_request)
         {
-            cond.signal();
+            advisor.ist_request(seqno_max - seqno_g + 1, found,
+                                gu_time_monotonic());
+
+            if (params.keep_pages_budget() > 0) keep_pages_grow();
+        }
+
+        if (!found) throw gu::NotFound();
+
+        if (0 == seqno_lock_count++ || seqno_locked == SEQNO_NONE ||
+            seqno_g < seqno_locked)
+        {
+            if (seqno_locked != SEQNO_NONE)
+            {
+                cond.signal();
+            }
+            seqno_locked = seqno_g;
         }
-        seqno_locked = seqno_g;
     }
 
     /*!
@@ -211,20 +258,22 @@ namespace gcache
 
             if (p != seqno2ptr.end())
             {
-                if (seqno_locked != SEQNO_NONE)
-                {
-                    cond.signal();
-                }
-                seqno_locked = seqno_g;
+                seqno_lock_move(seqno_g);
 
                 ptr = p->second;
-            }
-            else
-            {
-                throw gu::NotFound();
+                seqno_hits++;
             }
         }
 
+        if (0 == ptr)
+        {
+            std::vector<Buffer> v(1);
+
+            if (0 == seqno_get_cold(v, seqno_g)) throw gu::NotFound();
+
+            ptr = v[0].ptr();
+        }
+
         assert (ptr);
 
         const BufferHeader* const bh (ptr2BH(ptr)); // this can result in IO
@@ -236,7 +285,8 @@ namespace gcache
 
     size_t
     GCache::seqno_get_buffers (std::vector<Buffer>& v,
-                               int64_t const start)
+                               int64_t const start,
+                               size_t  const stride)
     {
         size_t const max(v.size());
 
@@ -251,30 +301,40 @@ namespace gcache
 
             if (p != seqno2ptr.end())
             {
-                if (seqno_locked != SEQNO_NONE)
-                {
-                    cond.signal();
-                }
+                seqno_lock_move(start);
 
-                seqno_locked = start;
+                if (gu_unlikely(cold.enabled()))
+                    cold.release_thawed(seqno_locked);
 
                 do {
-                    assert (p->first == int64_t(start + found));
+                    assert (p->first == int64_t(start + found * stride));
                     assert (p->second);
                     v[found].set_ptr(p->second);
                 }
-                while (++found < max && ++p != seqno2ptr.end() &&
-                       p->first == int64_t(start + found));
+                while (++found < max &&
+                       (p = seqno2ptr.find(start + found * stride)) !=
+                       seqno2ptr.end());
                 /* the latter condition ensures seqno continuty, #643 */
+
+                seqno_hits++;
+            }
+            else if (!cold.enabled())
+            {
+                seqno_misses++;
             }
         }
 
+        if (0 == found && gu_unlikely(cold.enabled()))
+        {
+            return seqno_get_cold(v, start, stride);
+        }
+
         // the following may cause IO
         for (size_t i(0); i < found; ++i)
         {
             const BufferHeader* const bh (ptr2BH(v[i].ptr()));
 
-            assert (bh->seqno_g == int64_t(start + i));
+            assert (bh->seqno_g == int64_t(start + i * stride));
             Limits::assert_size(bh->size);
 
             v[i].set_other (bh->seqno_g,
@@ -285,13 +345,118 @@ namespace gcache
         return found;
     }
 
+    void
+    GCache::seqno_prefetch (int64_t const start, size_t const count,
+                            size_t  const stride)
+    {
+        /* buffers to be read and the buffers which follow them */
+        std::vector<const void*> ptrs;
+        std::vector<const void*> nexts;
+        ptrs.reserve(count);
+        nexts.reserve(count);
+
+        {
+            gu::Lock lock(mtx);
+
+            seqno2ptr_iter_t p;
+
+            while (ptrs.size() < count &&
+                   (p = seqno2ptr.find(start + ptrs.size() * stride)) !=
+                   seqno2ptr.end())
+            {
+                ptrs.push_back(p->second);
+
+                seqno2ptr_iter_t const n(seqno2ptr.find(p->first + 1));
+                nexts.push_back(n != seqno2ptr.end() ? n->second : 0);
+            }
+        }
+
+        /* Buffers are not locked and may be discarded by now, so they must
+         * not be dereferenced here. Instead, consecutive buffers are assumed
+         * to be adjacent (which is normally the case in RB and page stores)
+         * and the distance between them is taken for buffer size. madvise()
+         * on a no longer mapped region is harmless. */
+        static uintptr_t const max_gap(1 << 20);
+        uintptr_t const page_size(gu_page_size());
+        uintptr_t const page_mask(~(page_size - 1));
+        uintptr_t region_begin(0), region_end(0);
+
+        for (size_t i(0); i < ptrs.size(); ++i)
+        {
+            uintptr_t const ptr(reinterpret_cast<uintptr_t>(ptrs[i]));
+            uintptr_t const begin(reinterpret_cast<uintptr_t>(ptr2BH(ptrs[i]))
+                                  & page_mask);
+            uintptr_t end(ptr + page_size);
+
+            if (nexts[i])
+            {
+                uintptr_t const next(reinterpret_cast<uintptr_t>(nexts[i]));
+                if (next > ptr && next - ptr < max_gap) end = next;
+            }
+
+            if (begin >= region_begin && begin <= region_end)
+            {
+                region_end = std::max(region_end, end); // coalesce
+                continue;
+            }
+
+            if (region_end > region_begin)
+            {
+                (void)posix_madvise(reinterpret_cast<void*>(region_begin),
+                                    region_end - region_begin,
+                                    POSIX_MADV_WILLNEED);
+            }
+
+            region_begin = begin;
+            region_end   = end;
+        }
+
+        if (region_end > region_begin)
+        {
+            (void)posix_madvise(reinterpret_cast<void*>(region_begin),
+                                region_end - region_begin,
+                                POSIX_MADV_WILLNEED);
+        }
+    }
+
+    bool
+    GCache::seqno_file_location (const void* const ptr,
+                                 int&              fd,
+                                 off_t&            offset) const
+    {
+        const BufferHeader* const bh(ptr2BH(ptr));
+
+        switch (bh->store)
+        {
+        case BUFFER_IN_RB:
+            fd     = rb.rb_fd();
+            offset = rb.rb_offset(ptr);
+            return true;
+        case BUFFER_IN_PAGE:
+        {
+            const Page* const page(static_cast<const Page*>(bh->ctx));
+            fd     = page->fd();
+            offset = page->offset(ptr);
+            return true;
+        }
+        case BUFFER_IN_MEM:
+            break;
+        }
+
+        return false;
+    }
+
     /*!
-     * Releases any history locks present.
+     * Releases a history lock, history is unlocked with the last one.
      */
     void GCache::seqno_unlock ()
     {
         gu::Lock lock(mtx);
+
+        if (seqno_lock_count > 0 && --seqno_lock_count > 0) return;
+
         seqno_locked = SEQNO_NONE;
+        cold.release_thawed(SEQNO_NONE);
         cond.signal();
     }
 }
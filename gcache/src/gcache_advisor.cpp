@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file gcache size advisor implementation */
+
+#include "gcache_advisor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gcache
+{
+    double    const Advisor::RATE_TAU      = 300.0;
+    double    const Advisor::RATE_INTERVAL = 1.0;
+    long long const Advisor::DEMAND_WINDOW = 7 * 24 * 3600 * 1000000000LL;
+    size_t    const Advisor::DEMAND_MAX    = 1024;
+    double    const Advisor::HEADROOM      = 1.25;
+
+    Advisor::Advisor (long long const now)
+        :
+        bytes_        (0),
+        seqnos_       (0),
+        sample_bytes_ (0),
+        sample_seqnos_(0),
+        sample_time_  (now),
+        sampled_      (false),
+        write_rate_   (0),
+        seqno_rate_   (0),
+        ist_requests_ (0),
+        ist_misses_   (0),
+        demand_       ()
+    {}
+
+    void
+    Advisor::update (long long const now)
+    {
+        double const dt((now - sample_time_) * 1.0e-9);
+
+        if (dt < RATE_INTERVAL) return;
+
+        double const write_rate((bytes_  - sample_bytes_)  / dt);
+        double const seqno_rate((seqnos_ - sample_seqnos_) / dt);
+
+        if (sampled_)
+        {
+            /* weight of the sample grows with the time it covers */
+            double const w(1.0 - ::exp(-dt / RATE_TAU));
+
+            write_rate_ += w * (write_rate - write_rate_);
+            seqno_rate_ += w * (seqno_rate - seqno_rate_);
+        }
+        else
+        {
+            write_rate_ = write_rate;
+            seqno_rate_ = seqno_rate;
+            sampled_    = true;
+        }
+
+        sample_bytes_  = bytes_;
+        sample_seqnos_ = seqnos_;
+        sample_time_   = now;
+    }
+
+    void
+    Advisor::ist_request (int64_t const behind, bool const hit,
+                          long long const now)
+    {
+        ++ist_requests_;
+        if (!hit) ++ist_misses_;
+
+        if (behind <= 0) return;
+
+        update(now);
+
+        Demand d;
+        d.time    = now;
+        d.seconds = seqno_rate_ > 0 ? behind / seqno_rate_ : 0;
+        d.size    = seqnos_ > 0 ? behind * (double(bytes_) / seqnos_) : 0;
+
+        if (demand_.size() >= DEMAND_MAX) demand_.pop_front();
+
+        demand_.push_back(d);
+    }
+
+    void
+    Advisor::advice (Advice& a, int64_t const history, long long const now)
+    {
+        update(now);
+
+        while (!demand_.empty() && now - demand_.front().time > DEMAND_WINDOW)
+        {
+            demand_.pop_front();
+        }
+
+        a.write_rate   = write_rate_;
+        a.seqno_rate   = seqno_rate_;
+        a.history_time = (seqno_rate_ > 0 && history > 0) ?
+            history / seqno_rate_ : 0;
+        a.ist_requests = ist_requests_;
+        a.ist_misses   = ist_misses_;
+        a.demand_time  = 0;
+        a.demand_size  = 0;
+
+        for (std::deque<Demand>::const_iterator i(demand_.begin());
+             i != demand_.end(); ++i)
+        {
+            a.demand_time = std::max(a.demand_time, i->seconds);
+            a.demand_size = std::max(a.demand_size, i->size);
+        }
+
+        /* the same time span may take more bytes now than when it was
+         * requested, recommend what covers both */
+        a.recommended_time = a.demand_time * HEADROOM;
+        a.recommended_size = std::max(a.write_rate * a.recommended_time,
+                                      a.demand_size * HEADROOM);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file gcache size advisor class */
+
+#ifndef _gcache_advisor_hpp_
+#define _gcache_advisor_hpp_
+
+#include <deque>
+#include <cstddef>
+#include <stdint.h>
+
+namespace gcache
+{
+    /*
+     * Estimates how much history gcache needs to keep to serve IST requests.
+     * Write rates are exponentially weighted moving averages with time
+     * constant RATE_TAU, IST demand is the farthest request seen within
+     * DEMAND_WINDOW. Recommendations are the demand with HEADROOM, 0 until
+     * the first IST request. Time is passed in nanoseconds of a monotonic
+     * clock. Not thread safe.
+     */
+    class Advisor
+    {
+    public:
+
+        struct Advice
+        {
+            Advice() : write_rate(0), seqno_rate(0), history_time(0),
+                       ist_requests(0), ist_misses(0), demand_time(0),
+                       demand_size(0), recommended_time(0),
+                       recommended_size(0) {}
+
+            double    write_rate;       /* bytes per second */
+            double    seqno_rate;       /* seqnos per second */
+            double    history_time;     /* seconds of writes held in cache */
+            long long ist_requests;
+            long long ist_misses;       /* requests not found in cache */
+            double    demand_time;      /* seconds of writes IST asked for */
+            size_t    demand_size;      /* bytes of them */
+            double    recommended_time;
+            size_t    recommended_size;
+        };
+
+        explicit Advisor (long long now);
+
+        /* a buffer of size bytes was assigned a seqno */
+        void written (size_t const size) { bytes_ += size; ++seqnos_; }
+
+        /* IST requested seqnos from the behind-th newest on, hit is false if
+         * they were not in cache */
+        void ist_request (int64_t behind, bool hit, long long now);
+
+        /* history is the number of seqnos held in cache */
+        void advice (Advice& a, int64_t history, long long now);
+
+    private:
+
+        static double    const RATE_TAU;      /* seconds */
+        static double    const RATE_INTERVAL; /* min seconds between samples */
+        static long long const DEMAND_WINDOW; /* nanoseconds */
+        static size_t    const DEMAND_MAX;    /* requests remembered */
+        static double    const HEADROOM;
+
+        struct Demand
+        {
+            long long time;
+            double    seconds;
+            size_t    size;
+        };
+
+        void update (long long now);
+
+        unsigned long long bytes_;
+        unsigned long long seqnos_;
+        unsigned long long sample_bytes_;
+        unsigned long long sample_seqnos_;
+        long long          sample_time_;
+        bool               sampled_;
+        double             write_rate_;
+        double             seqno_rate_;
+        long long          ist_requests_;
+        long long          ist_misses_;
+        std::deque<Demand> demand_;
+    };
+}
+
+#endif /* _gcache_advisor_hpp_ */
@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file cold history store implementation */
+
+#include "gcache_cold_store.hpp"
+#include "gcache_memops.hpp"
+
+#include <gu_fdesc.hpp>
+#include <gu_mmap.hpp>
+#include <gu_logger.hpp>
+#include <gu_throw.hpp>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+
+#include <iomanip>
+#include <sstream>
+
+static const std::string base_name ("gcache.cold.");
+
+static std::string
+make_base_name (const std::string& dir_name)
+{
+    if (dir_name.empty())
+    {
+        return base_name;
+    }
+    else if (dir_name[dir_name.length() - 1] == '/')
+    {
+        return (dir_name + base_name);
+    }
+    else
+    {
+        return (dir_name + '/' + base_name);
+    }
+}
+
+/* Segment file: header followed by the compressed image */
+namespace
+{
+    static const char   SEG_MAGIC[8] = { 'G','C','O','L','D','0','1','\0' };
+    static size_t const SEG_HEADER_LEN = 64;
+
+    struct SegmentHeader
+    {
+        char     magic[sizeof(SEG_MAGIC)];
+        int64_t  first;
+        int64_t  last;
+        uint64_t raw_size;
+        uint64_t size;     /* of compressed image */
+    }__attribute__((__packed__));
+
+    GU_COMPILE_ASSERT(sizeof(SegmentHeader) <= SEG_HEADER_LEN,
+                      segment_header_size_check);
+}
+
+gcache::ColdStore::ColdStore (const std::string& dir_name,
+                              size_t const       max_size)
+    :
+    base_name_(make_base_name(dir_name)),
+    max_size_ (supported() ? max_size : 0),
+    seg_count_(0),
+    segments_ (),
+    size_     (0),
+    raw_size_ (0),
+    thawed_   ()
+{
+    if (max_size > 0 && !enabled())
+    {
+        log_warn << "GCache cold history store requires compression "
+                 << "support which is not available in this build.";
+    }
+
+    cleanup_dir();
+}
+
+gcache::ColdStore::~ColdStore ()
+{
+    release_thawed(SEQNO_NONE);
+    reset();
+}
+
+bool
+gcache::ColdStore::supported()
+{
+#ifdef HAVE_ZLIB_H
+    return true;
+#else
+    return false;
+#endif
+}
+
+void
+gcache::ColdStore::cleanup_dir ()
+{
+    std::string::size_type const slash(base_name_.rfind('/'));
+    std::string const dir_name(std::string::npos == slash ?
+                               "." : base_name_.substr(0, slash + 1));
+    std::string const prefix(std::string::npos == slash ?
+                             base_name_ : base_name_.substr(slash + 1));
+
+    DIR* const dir(opendir(dir_name.c_str()));
+
+    if (0 == dir) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0)
+    {
+        std::string const name(entry->d_name);
+
+        if (name.compare(0, prefix.length(), prefix)) continue;
+
+        std::string const num(name.substr(prefix.length()));
+
+        if (num.empty() || num.find_first_not_of("0123456789") !=
+            std::string::npos) continue;
+
+        std::string const path(base_name_ + num);
+
+        if (::remove(path.c_str()))
+        {
+            int const err(errno);
+            log_warn << "Failed to remove cold segment '" << path << "': "
+                     << err << " (" << strerror(err) << ')';
+        }
+    }
+
+    closedir(dir);
+}
+
+void
+gcache::ColdStore::image_append (std::vector<uint8_t>& image,
+                                 const BufferHeader* const bh)
+{
+    size_t const off(image.size());
+
+    image.resize(off + MemOps::align_size(bh->size));
+    ::memcpy(&image[off], bh, bh->size);
+
+    BufferHeader* const copy(reinterpret_cast<BufferHeader*>(&image[off]));
+    copy->ctx   = 0;
+    copy->flags = BUFFER_RELEASED;
+    copy->store = BUFFER_IN_MEM;
+}
+
+gcache::ColdStore::Segment
+gcache::ColdStore::write (const std::vector<uint8_t>& image,
+                          seqno_t const first, seqno_t const last)
+{
+    assert(!image.empty());
+    assert(last >= first);
+
+    Segment seg;
+
+#ifdef HAVE_ZLIB_H
+    uLongf csize(compressBound(image.size()));
+    std::vector<uint8_t> out(SEG_HEADER_LEN + csize);
+
+    int const ret(compress2(&out[SEG_HEADER_LEN], &csize, &image[0],
+                            image.size(), Z_DEFAULT_COMPRESSION));
+    if (Z_OK != ret)
+    {
+        gu_throw_error(ENOMEM) << "Failed to compress cold segment: "
+                               << ret;
+    }
+
+    SegmentHeader hdr;
+    ::memcpy(hdr.magic, SEG_MAGIC, sizeof(hdr.magic));
+    hdr.first    = first;
+    hdr.last     = last;
+    hdr.raw_size = image.size();
+    hdr.size     = csize;
+
+    ::memset(&out[0], 0, SEG_HEADER_LEN);
+    ::memcpy(&out[0], &hdr, sizeof(hdr));
+
+    std::ostringstream os;
+    os << base_name_ << std::setfill('0') << std::setw(6) << seg_count_++;
+
+    seg.name     = os.str();
+    seg.first    = first;
+    seg.last     = last;
+    seg.raw_size = image.size();
+    seg.size     = SEG_HEADER_LEN + csize;
+
+    try
+    {
+#ifdef HAVE_PSI_INTERFACE
+        gu::FileDescriptor fd(seg.name, WSREP_PFS_INSTR_TAG_GCACHE_PAGE_FILE,
+                              seg.size, true, false);
+#else
+        gu::FileDescriptor fd(seg.name, seg.size, true, false);
+#endif /* HAVE_PSI_INTERFACE */
+        gu::MMap mmap(fd);
+
+        ::memcpy(mmap.ptr, &out[0], seg.size);
+    }
+    catch (gu::Exception&)
+    {
+        ::remove(seg.name.c_str());
+        throw;
+    }
+#else
+    gu_throw_error(ENOTSUP) << "Compression is not supported";
+#endif /* HAVE_ZLIB_H */
+
+    return seg;
+}
+
+void
+gcache::ColdStore::remove (const Segment& seg)
+{
+    if (::remove(seg.name.c_str()))
+    {
+        int const err(errno);
+        log_warn << "Failed to remove cold segment '" << seg.name << "': "
+                 << err << " (" << strerror(err) << ')';
+    }
+}
+
+void
+gcache::ColdStore::add (const Segment& seg, seqno_t const locked)
+{
+    assert(segments_.empty() || segments_.back().last + 1 == seg.first);
+
+    segments_.push_back(seg);
+    size_     += seg.size;
+    raw_size_ += seg.raw_size;
+
+    while (size_ > max_size_ && !segments_.empty() &&
+           (SEQNO_NONE == locked || segments_.front().last < locked))
+    {
+        remove_front();
+    }
+}
+
+void
+gcache::ColdStore::remove_front ()
+{
+    remove(segments_.front());
+    size_     -= segments_.front().size;
+    raw_size_ -= segments_.front().raw_size;
+    segments_.pop_front();
+}
+
+void
+gcache::ColdStore::remove_back ()
+{
+    remove(segments_.back());
+    size_     -= segments_.back().size;
+    raw_size_ -= segments_.back().raw_size;
+    segments_.pop_back();
+}
+
+const gcache::ColdStore::Segment*
+gcache::ColdStore::find (seqno_t const s) const
+{
+    if (segments_.empty() || s < segments_.front().first ||
+        s > segments_.back().last) return 0;
+
+    /* segments are ordered and don't overlap */
+    size_t lo(0), hi(segments_.size());
+
+    while (lo < hi)
+    {
+        size_t const mid((lo + hi) / 2);
+
+        if (segments_[mid].last < s) lo = mid + 1; else hi = mid;
+    }
+
+    assert(lo < segments_.size());
+
+    return (segments_[lo].first <= s ? &segments_[lo] : 0);
+}
+
+gcache::ColdStore::ThawedPtr
+gcache::ColdStore::thaw (const Segment& seg)
+{
+#ifdef HAVE_ZLIB_H
+#ifdef HAVE_PSI_INTERFACE
+    gu::FileDescriptor fd(seg.name, WSREP_PFS_INSTR_TAG_GCACHE_PAGE_FILE,
+                          false);
+#else
+    gu::FileDescriptor fd(seg.name, false);
+#endif /* HAVE_PSI_INTERFACE */
+    gu::MMap mmap(fd, true);
+
+    SegmentHeader hdr;
+
+    if (mmap.size < SEG_HEADER_LEN)
+    {
+        gu_throw_error(EINVAL) << "Cold segment '" << seg.name
+                               << "' is truncated";
+    }
+
+    ::memcpy(&hdr, mmap.ptr, sizeof(hdr));
+
+    if (::memcmp(hdr.magic, SEG_MAGIC, sizeof(hdr.magic)) ||
+        hdr.first != seg.first || hdr.last != seg.last ||
+        hdr.raw_size != seg.raw_size ||
+        hdr.size > mmap.size - SEG_HEADER_LEN)
+    {
+        gu_throw_error(EINVAL) << "Corrupt cold segment '" << seg.name
+                               << "' header";
+    }
+
+    ThawedPtr t(new Thawed);
+    t->first = seg.first;
+    t->last  = seg.last;
+    t->image.resize(hdr.raw_size);
+
+    uLongf size(hdr.raw_size);
+    int const ret(uncompress(&t->image[0], &size,
+                             static_cast<const uint8_t*>(mmap.ptr) +
+                             SEG_HEADER_LEN, hdr.size));
+
+    if (Z_OK != ret || size != hdr.raw_size)
+    {
+        gu_throw_error(EINVAL) << "Failed to decompress cold segment '"
+                               << seg.name << "': " << ret;
+    }
+
+    size_t const count(seg.last - seg.first + 1);
+    t->index.reserve(count);
+
+    for (size_t off(0); off + sizeof(BufferHeader) <= size; )
+    {
+        const BufferHeader* const bh(
+            reinterpret_cast<const BufferHeader*>(&t->image[off]));
+
+        if (bh->seqno_g != seg.first + seqno_t(t->index.size()) ||
+            bh->size < sizeof(BufferHeader) || bh->size > size - off)
+        {
+            break;
+        }
+
+        t->index.push_back(bh);
+        off += MemOps::align_size(bh->size);
+    }
+
+    if (t->index.size() != count)
+    {
+        gu_throw_error(EINVAL) << "Corrupt cold segment '" << seg.name
+                               << "': found " << t->index.size()
+                               << " buffers out of " << count;
+    }
+
+    return t;
+#else
+    gu_throw_error(ENOTSUP) << "Compression is not supported";
+#endif /* HAVE_ZLIB_H */
+}
+
+void
+gcache::ColdStore::add_thawed (const ThawedPtr& t)
+{
+    thawed_.insert(std::make_pair(t->last, t)); // may be thawed concurrently
+}
+
+const void*
+gcache::ColdStore::thawed_ptr (seqno_t const s, ThawedPtr& holder) const
+{
+    std::map<seqno_t, ThawedPtr>::const_iterator const i(
+        thawed_.lower_bound(s));
+
+    if (i == thawed_.end() || i->second->first > s) return 0;
+
+    holder = i->second;
+
+    return (i->second->index[s - i->second->first] + 1);
+}
+
+void
+gcache::ColdStore::release_thawed (seqno_t const locked)
+{
+    thawed_.erase(thawed_.begin(), SEQNO_NONE == locked ?
+                  thawed_.end() : thawed_.lower_bound(locked));
+}
+
+void
+gcache::ColdStore::discard_tail (seqno_t const s)
+{
+    release_thawed(SEQNO_NONE);
+
+    while (!segments_.empty() && segments_.back().last > s) remove_back();
+}
+
+void
+gcache::ColdStore::reset ()
+{
+    release_thawed(SEQNO_NONE);
+
+    while (!segments_.empty()) remove_front();
+}
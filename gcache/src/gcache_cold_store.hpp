@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file cold history store class */
+
+#ifndef _gcache_cold_store_hpp_
+#define _gcache_cold_store_hpp_
+
+#include "gcache_bh.hpp"
+#include "gcache_seqno.hpp"
+
+#include <gu_shared_ptr.hpp>
+
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace gcache
+{
+    /*
+     * Compressed copies of old history for IST. Runs of consecutive released
+     * buffers are compressed into segment files, which are decompressed
+     * ("thawed") as a whole when any buffer in them is requested. Thawed
+     * buffers are laid out as in the other stores (BufferHeader followed by
+     * payload), marked released and BUFFER_IN_MEM. They are shared with
+     * the users and are kept in the store until release_thawed() past them.
+     *
+     * Segments are not recovered: leftover segment files are removed on
+     * startup. Not thread safe, except for write() and thaw() which are
+     * meant to be called unlocked, write() from a single thread.
+     */
+    class ColdStore
+    {
+    public:
+
+        struct Segment
+        {
+            Segment() : name(), first(SEQNO_NONE), last(SEQNO_NONE),
+                        raw_size(0), size(0) {}
+
+            std::string name;
+            seqno_t     first;
+            seqno_t     last;
+            size_t      raw_size; /* size of buffers in the segment */
+            size_t      size;     /* size of the segment file */
+        };
+
+        struct Thawed
+        {
+            Thawed() : first(SEQNO_NONE), last(SEQNO_NONE), image(), index()
+            {}
+
+            seqno_t                           first;
+            seqno_t                           last;
+            std::vector<uint8_t>              image;
+            std::vector<const BufferHeader*>  index;
+        };
+
+        typedef gu::shared_ptr<Thawed>::type ThawedPtr;
+
+        /* max_size is the limit on the total size of segment files,
+         * 0 disables the store */
+        ColdStore (const std::string& dir_name, size_t max_size);
+
+        ~ColdStore ();
+
+        /* false if compression is not available in this build */
+        static bool supported();
+
+        bool    enabled()   const { return max_size_ > 0; }
+
+        /* Appends a buffer to a segment image */
+        static void image_append (std::vector<uint8_t>& image,
+                                  const BufferHeader*   bh);
+
+        /* Compresses a segment image of buffers first - last into a new
+         * segment file. Throws on failure. */
+        Segment write (const std::vector<uint8_t>& image,
+                       seqno_t first, seqno_t last);
+
+        /* Adds a written segment, which must continue the stored ones, and
+         * removes the oldest segments which exceed the size limit, unless
+         * they have seqnos from locked on */
+        void    add   (const Segment& seg, seqno_t locked);
+
+        /* Removes the file of a written but not added segment */
+        static void remove (const Segment& seg);
+
+        /* Segment containing seqno s, 0 if none */
+        const Segment* find (seqno_t s) const;
+
+        seqno_t seqno_min() const
+        {
+            return segments_.empty() ? SEQNO_NONE : segments_.front().first;
+        }
+
+        seqno_t seqno_max() const
+        {
+            return segments_.empty() ? SEQNO_NONE : segments_.back().last;
+        }
+
+        /* Reads and decompresses a segment. Throws on failure. */
+        static ThawedPtr thaw (const Segment& seg);
+
+        void        add_thawed (const ThawedPtr& t);
+
+        /* buffer payload of thawed seqno s and the segment holding it,
+         * 0 if s is not thawed */
+        const void* thawed_ptr (seqno_t s, ThawedPtr& holder) const;
+
+        /* Frees thawed segments which end before seqno locked,
+         * all of them if locked is SEQNO_NONE */
+        void        release_thawed (seqno_t locked);
+
+        /* Removes segments with seqnos greater than s */
+        void    discard_tail (seqno_t s);
+
+        /* Removes all segments */
+        void    reset ();
+
+        size_t  count()    const { return segments_.size(); }
+        size_t  size()     const { return size_;     }
+        size_t  raw_size() const { return raw_size_; }
+
+    private:
+
+        std::string const           base_name_; /* /.../.../gcache.cold. */
+        size_t const                max_size_;
+        size_t                      seg_count_; /* used only by write() */
+        std::deque<Segment>         segments_;
+        size_t                      size_;
+        size_t                      raw_size_;
+        std::map<seqno_t, ThawedPtr> thawed_;   /* by the last seqno */
+
+        void remove_front ();
+        void remove_back  ();
+        void cleanup_dir  ();
+
+        ColdStore(const gcache::ColdStore&);
+        ColdStore& operator=(const gcache::ColdStore&);
+    };
+}
+
+#endif /* _gcache_cold_store_hpp_ */
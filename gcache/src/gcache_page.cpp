@@ -10,6 +10,9 @@
 #include <gu_throw.hpp>
 #include <gu_logger.hpp>
 
+#include <algorithm>
+#include <sstream>
+
 // for posix_fadvise()
 #if !defined(_XOPEN_SOURCE)
 #define _XOPEN_SOURCE 600
@@ -26,12 +29,119 @@ gcache::Page::reset ()
         abort();
     }
 
-    space_ = mmap_.size;
-    next_  = static_cast<uint8_t*>(mmap_.ptr);
+    space_ = mmap_.size - PREAMBLE_LEN;
+    next_  = start();
 
     BH_clear (reinterpret_cast<BufferHeader*>(next_));
 }
 
+static std::string const PR_KEY_VERSION = "Version:";
+static std::string const PR_KEY_GID     = "GID:";
+
+void
+gcache::Page::write_preamble()
+{
+    std::ostringstream os;
+
+    os << PR_KEY_VERSION << ' ' << VERSION << '\n';
+    os << PR_KEY_GID << ' ' << gid_ << '\n';
+    os << '\n';
+
+    std::string const str(os.str());
+    assert(str.length() < PREAMBLE_LEN);
+
+    ::memset(mmap_.ptr, '\0', PREAMBLE_LEN);
+    ::memcpy(mmap_.ptr, str.c_str(), std::min(str.length(), PREAMBLE_LEN - 1));
+}
+
+void
+gcache::Page::open_preamble()
+{
+    int version(0);
+    gu::UUID gid;
+
+    std::string const str(static_cast<const char*>(mmap_.ptr),
+                          ::strnlen(static_cast<const char*>(mmap_.ptr),
+                                    std::min(PREAMBLE_LEN, mmap_.size)));
+    std::istringstream iss(str);
+    std::string line;
+
+    while (getline(iss, line), iss.good())
+    {
+        std::istringstream istr(line);
+        std::string key;
+
+        istr >> key;
+
+        if      (PR_KEY_VERSION == key) istr >> version;
+        else if (PR_KEY_GID     == key) istr >> gid;
+    }
+
+    if (VERSION == version) gid_ = gid;
+}
+
+size_t
+gcache::Page::recover (seqno2ptr_t& seqno2ptr)
+{
+    assert(0 == used_);
+
+    uint8_t* const end(static_cast<uint8_t*>(mmap_.ptr) + mmap_.size);
+    uint8_t*       ptr(start());
+    size_t         ret(0);
+
+    while (ptr + sizeof(BufferHeader) <= end)
+    {
+        BufferHeader* const bh(BH_cast(ptr));
+
+        if (BH_is_clear(bh)) break;
+
+        if (bh->store != BUFFER_IN_PAGE ||
+            bh->size < sizeof(BufferHeader) ||
+            bh->size > size_t(end - ptr) ||
+            bh->flags > BUFFER_FLAGS_MAX ||
+            (uintptr_t(ptr) % MemOps::ALIGNMENT))
+        {
+            log_warn << "Corrupt buffer header in page " << name()
+                     << " at offset " << ptr - start() << ": " << bh
+                     << ". Skipping the rest of the page.";
+            BH_clear(bh);
+            break;
+        }
+
+        bh->ctx    = this;
+        bh->flags |= BUFFER_RELEASED;
+
+        if (bh->seqno_g > 0)
+        {
+            if (seqno2ptr.insert(seqno2ptr_pair_t(bh->seqno_g, bh + 1)).second)
+            {
+                used_++;
+                ret++;
+                seqno_assigned(bh->seqno_g);
+            }
+            else
+            {
+                log_warn << "Discarding duplicate seqno " << bh->seqno_g
+                         << " in page " << name();
+                bh->seqno_g = SEQNO_ILL;
+            }
+        }
+        else
+        {
+            /* unordered or discarded buffer, nobody can be using it now */
+            bh->seqno_g = SEQNO_ILL;
+        }
+
+        ptr += bh->size;
+    }
+
+    next_  = ptr;
+    space_ = end - ptr;
+    min_space_ = space_;
+
+    return ret;
+}
+
 void
 gcache::Page::drop_fs_cache() const
 {
@@ -48,26 +158,54 @@ gcache::Page::drop_fs_cache() const
 #endif
 }
 
-gcache::Page::Page (void* ps, const std::string& name, size_t size)
+gcache::Page::Page (void* ps, const std::string& name, size_t size,
+                    const gu::UUID& gid, bool const allocate)
     :
 #ifdef HAVE_PSI_INTERFACE
-    fd_   (name, WSREP_PFS_INSTR_TAG_GCACHE_PAGE_FILE, size, false, false),
+    fd_   (name, WSREP_PFS_INSTR_TAG_GCACHE_PAGE_FILE, size + PREAMBLE_LEN,
+           allocate, false),
 #else
-    fd_   (name, size, false, false),
+    fd_   (name, size + PREAMBLE_LEN, allocate, false),
 #endif /* HAVE_PSI_INTERFACE */
     mmap_ (fd_),
     ps_   (ps),
-    next_ (static_cast<uint8_t*>(mmap_.ptr)),
+    next_ (start()),
     size_ (mmap_.size),
-    space_(size_),
+    space_(size_ - PREAMBLE_LEN),
     used_ (0),
-    min_space_ (space_)
+    min_space_ (space_),
+    gid_  (gid),
+    seqno_max_(SEQNO_NONE)
 {
     log_info << "Created page " << name << " of size " << space_
              << " bytes";
+    write_preamble();
     BH_clear (reinterpret_cast<BufferHeader*>(next_));
 }
 
+gcache::Page::Page (void* ps, const std::string& name)
+    :
+#ifdef HAVE_PSI_INTERFACE
+    fd_   (name, WSREP_PFS_INSTR_TAG_GCACHE_PAGE_FILE, false),
+#else
+    fd_   (name, false),
+#endif /* HAVE_PSI_INTERFACE */
+    mmap_ (fd_),
+    ps_   (ps),
+    next_ (0),
+    size_ (mmap_.size),
+    space_(0),
+    used_ (0),
+    min_space_ (0),
+    gid_  (),
+    seqno_max_(SEQNO_NONE)
+{
+    if (size_ >= PREAMBLE_LEN + sizeof(BufferHeader)) open_preamble();
+
+    /* not usable for allocations until recovered */
+    next_ = static_cast<uint8_t*>(mmap_.ptr) + size_;
+}
+
 void*
 gcache::Page::malloc (size_type size)
 {
@@ -94,15 +232,12 @@ gcache::Page::malloc (size_type size)
             min_space_ = space_;
         }
 
-#ifndef NDEBUG
-        if (space_ >= sizeof(BufferHeader))
-        {
-            BH_clear (BH_cast(next_));
-            assert (reinterpret_cast<uint8_t*>(bh + 1) < next_);
-        }
+        /* terminate the chain of buffers for recovery scan */
+        if (space_ >= sizeof(BufferHeader)) BH_clear (BH_cast(next_));
 
+        assert (reinterpret_cast<uint8_t*>(bh + 1) <= next_);
         assert (next_ <= static_cast<uint8_t*>(mmap_.ptr) + mmap_.size);
-#endif
+
         return (bh + 1);
     }
     else
@@ -136,15 +271,13 @@ gcache::Page::realloc (void* ptr, size_type size)
                 min_space_ = space_;
             }
 
-#ifndef NDEBUG
             if (space_ >= static_cast<size_t>(sizeof(BufferHeader)))
             {
                 BH_clear (BH_cast(next_));
-                assert (reinterpret_cast<uint8_t*>(bh + 1) < next_);
             }
 
+            assert (reinterpret_cast<uint8_t*>(bh + 1) <= next_);
             assert (next_ <= static_cast<uint8_t*>(mmap_.ptr) + mmap_.size);
-#endif
 
             return ptr;
         }
@@ -175,5 +308,5 @@ gcache::Page::realloc (void* ptr, size_type size)
 
 size_t gcache::Page::allocated_pool_size ()
 {
-    return mmap_.size - min_space_;
+    return mmap_.size - PREAMBLE_LEN - min_space_;
 }
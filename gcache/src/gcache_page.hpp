@@ -9,9 +9,11 @@
 
 #include "gcache_memops.hpp"
 #include "gcache_bh.hpp"
+#include "gcache_types.hpp"
 
 #include "gu_fdesc.hpp"
 #include "gu_mmap.hpp"
+#include "gu_uuid.hpp"
 
 #include <string>
 
@@ -21,14 +23,22 @@ namespace gcache
     {
     public:
 
-        Page (void* ps, const std::string& name, size_t size);
+        /* Creates a new page file able to hold size bytes of buffers,
+         * history UUID is recorded in the page preamble. If allocate is true
+         * the file space is reserved with fallocate(). */
+        Page (void* ps, const std::string& name, size_t size,
+              const gu::UUID& gid, bool allocate = false);
+
+        /* Opens existing page file for recovery, see recover() */
+        Page (void* ps, const std::string& name);
+
         ~Page () {}
 
         void* malloc  (size_type size);
 
         void  free    (BufferHeader* bh)
         {
-            assert (bh >= mmap_.ptr);
+            assert (reinterpret_cast<uint8_t*>(bh) >= start());
             assert (static_cast<void*>(bh) <=
                     (static_cast<uint8_t*>(mmap_.ptr) + mmap_.size -
                      sizeof(BufferHeader)));
@@ -44,10 +54,43 @@ namespace gcache
 
         size_t size() const { return size_; } /* size on storage */
 
+        size_t space() const { return space_; } /* left for allocations */
+
         const std::string& name() const { return fd_.name(); }
 
+        /* descriptor of the page file and offset of ptr in it */
+        int   fd() const { return fd_.get(); }
+        off_t offset(const void* ptr) const
+        {
+            return (static_cast<const uint8_t*>(ptr) -
+                    static_cast<const uint8_t*>(mmap_.ptr));
+        }
+
         void reset ();
 
+        /* History UUID the page was created for, undefined if the page
+         * preamble could not be parsed */
+        const gu::UUID& gid() const { return gid_; }
+
+        /* Assigns a page created in advance to history gid */
+        void gid(const gu::UUID& gid)
+        {
+            assert(0 == used_);
+            gid_ = gid;
+            write_preamble();
+        }
+
+        /* Scans the page and adds seqno'd buffers to seqno2ptr as released.
+         * Returns the number of buffers added. */
+        size_t recover (seqno2ptr_t& seqno2ptr);
+
+        /* Highest seqno ever assigned to a buffer in this page */
+        seqno_t seqno_max() const { return seqno_max_; }
+        void    seqno_assigned(seqno_t s)
+        {
+            if (s > seqno_max_) seqno_max_ = s;
+        }
+
         /* Drop filesystem cache on the file */
         void drop_fs_cache() const;
 
@@ -57,6 +100,10 @@ namespace gcache
 
     private:
 
+        /* ASCII preamble in the beginning of the page file, buffers follow */
+        static size_t const PREAMBLE_LEN = 256;
+        static int    const VERSION      = 1;
+
         gu::FileDescriptor fd_;
         gu::MMap           mmap_;
         void* const        ps_;
@@ -65,6 +112,16 @@ namespace gcache
         size_t             space_;
         size_t             used_;
         size_t             min_space_;
+        gu::UUID           gid_;
+        seqno_t            seqno_max_;
+
+        uint8_t* start() const
+        {
+            return static_cast<uint8_t*>(mmap_.ptr) + PREAMBLE_LEN;
+        }
+
+        void write_preamble();
+        void open_preamble();
 
         Page(const gcache::Page&);
         Page& operator=(const gcache::Page&);
@@ -12,10 +12,14 @@
 #include <gu_throw.hpp>
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <pthread.h>
+#include <dirent.h>
 
 #include <iomanip>
+#include <map>
+#include <vector>
 
 static const std::string base_name ("gcache.page.");
 
@@ -47,10 +51,12 @@ make_page_name (const std::string& base_name, size_t count)
     return os.str();
 }
 
+/* arg is a heap allocated vector of file names, it is deleted here */
 static void*
 remove_file (void* __restrict__ arg)
 {
-    char* const file_name (static_cast<char*>(arg));
+    std::vector<std::string>* const file_names
+        (static_cast<std::vector<std::string>*>(arg));
 
 #ifdef HAVE_PSI_INTERFACE
     pfs_instr_callback(WSREP_PFS_INSTR_TYPE_THREAD,
@@ -59,21 +65,26 @@ remove_file (void* __restrict__ arg)
                        NULL, NULL, NULL);
 #endif /* HAVE_PSI_INTERFACE */
 
-    if (NULL != file_name)
+    if (NULL != file_names)
     {
-        if (remove (file_name))
+        for (size_t i(0); i < file_names->size(); ++i)
         {
-            int err = errno;
-
-            log_error << "Failed to remove page file '" << file_name << "': "
-                      << err << " (" << strerror(err) << ")";
-        }
-        else
-        {
-            log_info << "Deleted page " << file_name;
+            const char* const file_name((*file_names)[i].c_str());
+
+            if (remove (file_name))
+            {
+                int err = errno;
+
+                log_error << "Failed to remove page file '" << file_name
+                          << "': " << err << " (" << strerror(err) << ")";
+            }
+            else
+            {
+                log_info << "Deleted page " << file_name;
+            }
         }
 
-        free (file_name);
+        delete file_names;
     }
     else
     {
@@ -106,13 +117,38 @@ gcache::PageStore::delete_page ()
 
     pages_.pop_front();
 
-    char* const file_name(strdup(page->name().c_str()));
-
     total_size_ -= page->size();
+    pages_deleted_++;
 
     if (current_ == page) current_ = 0;
 
-    delete page;
+    delete_page_file (page);
+
+    return true;
+}
+
+void
+gcache::PageStore::delete_page_file (Page* const page)
+{
+    std::deque<Page*> pages(1, page);
+    delete_page_files (pages);
+}
+
+void
+gcache::PageStore::delete_page_files (std::deque<Page*>& pages)
+{
+    if (pages.empty()) return;
+
+    std::vector<std::string>* const file_names
+        (new std::vector<std::string>());
+
+    while (!pages.empty())
+    {
+        Page* const page(pages.front());
+        pages.pop_front();
+        file_names->push_back(page->name());
+        delete page;
+    }
 
 #ifdef GCACHE_DETACH_THREAD
     pthread_t delete_thr_;
@@ -121,14 +157,13 @@ gcache::PageStore::delete_page ()
 #endif /* GCACHE_DETACH_THERAD */
 
     int err = gu_thread_create (&delete_thr_, &delete_page_attr_, remove_file,
-                                file_name);
+                                file_names);
     if (0 != err)
     {
+        delete file_names;
         delete_thr_ = pthread_t(-1);
         gu_throw_error(err) << "Failed to create page file deletion thread";
     }
-
-    return true;
 }
 
 /* Deleting pages only from the beginning kinda means that some free pages
@@ -173,23 +208,155 @@ gcache::PageStore::reset ()
     while (pages_.size() > 0 && delete_page()) {};
 }
 
+/* With pre-allocation enabled a ready page is taken from the reserve, it only
+ * needs its preamble rewritten. Reserved pages which are too small for the
+ * request (page size was increased or the buffer is bigger than a page) are
+ * dropped, all in one go to the page deletion thread, and a new page is
+ * created inline as before. */
 inline void
 gcache::PageStore::new_page (size_type size)
 {
-    Page* const page(new Page(this, make_page_name (base_name_, count_), size));
+    Page*       page(0);
+    std::string name;
+
+    if (reserve_max_ > 0)
+    {
+        std::deque<Page*> drop;
+
+        {
+            gu::Lock lock(reserve_mtx_);
+
+            reserve_on_ = true;
+
+            /* the page being created comes next in the order: wait for it
+             * rather than create one inline, unless a ready one fits */
+            while (reserve_busy_ &&
+                   (reserve_.empty() || reserve_.front()->space() < size))
+            {
+                lock.wait(reserve_cond_);
+            }
+
+            if (!reserve_.empty() && reserve_.front()->space() >= size)
+            {
+                page = reserve_.front();
+                reserve_.pop_front();
+            }
+            else
+            {
+                drop.swap(reserve_);
+                name = make_page_name (base_name_, count_++);
+            }
+
+            reserve_cond_.signal();
+        }
+
+        delete_page_files (drop);
+    }
+    else
+    {
+        name = make_page_name (base_name_, count_++);
+    }
+
+    if (page)
+    {
+        page->gid(gid_);
+    }
+    else
+    {
+        page = new Page(this, name, size, gid_);
+    }
 
     pages_.push_back (page);
     total_size_ += page->size();
+    pages_created_++;
     current_ = page;
-    count_++;
+}
+
+/* not instrumented: the wsrep API has no PFS thread tag for it and the page
+ * file removal tag would make it show up as a page deletion thread */
+void*
+gcache::PageStore::reserve_thread (void* arg)
+{
+    static_cast<PageStore*>(arg)->reserve_loop();
+
+    return NULL;
+}
+
+/* Pages are created with fallocate()'d files and undefined history, so
+ * that pages left by a crash are discarded by recover(). After a failure
+ * the thread waits for the next new_page() to retry. */
+void
+gcache::PageStore::reserve_loop ()
+{
+    for (;;)
+    {
+        size_t      size;
+        std::string name;
+
+        {
+            gu::Lock lock(reserve_mtx_);
+
+            while (!reserve_exit_ &&
+                   (!reserve_on_ || reserve_.size() >= reserve_max_))
+            {
+                lock.wait(reserve_cond_);
+            }
+
+            if (reserve_exit_) break;
+
+            size = reserve_size_;
+            name = make_page_name (base_name_, count_++);
+            reserve_busy_ = true;
+        }
+
+        Page* page(0);
+
+        try
+        {
+            page = new Page(this, name, size, gu::UUID(), true);
+        }
+        catch (gu::Exception& e)
+        {
+            log_warn << "Failed to pre-allocate cache page: " << e.what();
+        }
+
+        gu::Lock lock(reserve_mtx_);
+
+        if (page)
+            reserve_.push_back(page);
+        else
+            reserve_on_ = false;
+
+        reserve_busy_ = false;
+        reserve_cond_.broadcast();
+    }
+}
+
+void
+gcache::PageStore::set_page_size (size_t const size)
+{
+    page_size_ = size;
+
+    {
+        gu::Lock lock(reserve_mtx_);
+        reserve_size_ = size;
+    }
+
+    cleanup();
 }
 
 gcache::PageStore::PageStore (const std::string& dir_name,
                               size_t             keep_size,
                               size_t             page_size,
-                              size_t             keep_page)
+                              size_t             keep_page,
+                              seqno2ptr_t&       seqno2ptr,
+                              gu::UUID&          gid,
+                              bool const         recover,
+                              size_t const       reserve)
     :
     base_name_ (make_base_name(dir_name)),
+    seqno2ptr_ (seqno2ptr),
+    gid_       (gid),
     keep_size_ (keep_size),
     page_size_ (page_size),
     keep_page_ (keep_page),
@@ -197,10 +364,27 @@ gcache::PageStore::PageStore (const std::string& dir_name,
     pages_     (),
     current_   (0),
     total_size_(0),
+    pages_created_(0),
+    pages_deleted_(0),
+    persist_   (recover),
     delete_page_attr_()
 #ifndef GCACHE_DETACH_THREAD
     , delete_thr_(pthread_t(-1))
 #endif /* GCACHE_DETACH_THREAD */
+#ifdef HAVE_PSI_INTERFACE
+    , reserve_mtx_ (WSREP_PFS_INSTR_TAG_GCACHE_MUTEX)
+    , reserve_cond_(WSREP_PFS_INSTR_TAG_GCACHE_CONDVAR)
+#else
+    , reserve_mtx_ ()
+    , reserve_cond_()
+#endif /* HAVE_PSI_INTERFACE */
+    , reserve_     ()
+    , reserve_max_ (reserve)
+    , reserve_size_(page_size)
+    , reserve_on_  (false)
+    , reserve_busy_(false)
+    , reserve_exit_(false)
+    , reserve_thr_ ()
 {
     int err = pthread_attr_init (&delete_page_attr_);
 
@@ -220,12 +404,176 @@ gcache::PageStore::PageStore (const std::string& dir_name,
                             << "page file deletion thread";
     }
 #endif /* GCACHE_DETACH_THREAD */
+
+    if (recover) this->recover();
+
+    if (reserve_max_ > 0)
+    {
+        err = gu_thread_create (&reserve_thr_, NULL, reserve_thread, this);
+
+        if (0 != err)
+        {
+            log_warn << "Failed to start page pre-allocation thread: " << err
+                     << " (" << strerror(err) << "). Pages will be created "
+                     << "on demand.";
+            reserve_max_ = 0;
+        }
+    }
+}
+
+void
+gcache::PageStore::recover ()
+{
+    std::string::size_type const slash(base_name_.rfind('/'));
+    std::string const dir_name(std::string::npos == slash ?
+                               "." : base_name_.substr(0, slash + 1));
+    std::string const prefix(std::string::npos == slash ?
+                             base_name_ : base_name_.substr(slash + 1));
+
+    std::map<size_t, std::string> files;
+
+    DIR* const dir(opendir(dir_name.c_str()));
+
+    if (0 == dir)
+    {
+        int const err(errno);
+        log_warn << "Failed to open GCache page directory '" << dir_name
+                 << "': " << err << " (" << strerror(err) << ')';
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0)
+    {
+        std::string const name(entry->d_name);
+
+        if (name.compare(0, prefix.length(), prefix)) continue;
+
+        std::string const num(name.substr(prefix.length()));
+
+        if (num.empty() || num.find_first_not_of("0123456789") !=
+            std::string::npos) continue;
+
+        files[strtoull(num.c_str(), NULL, 10)] = base_name_ + num;
+    }
+
+    closedir(dir);
+
+    if (files.empty()) return;
+
+    /* new pages continue numbering */
+    count_ = files.rbegin()->first + 1;
+
+    std::vector<Page*> found;
+
+    for (std::map<size_t, std::string>::iterator i(files.begin());
+         i != files.end(); ++i)
+    {
+        try
+        {
+            found.push_back(new Page(this, i->second));
+        }
+        catch (gu::Exception& e)
+        {
+            log_warn << "Failed to open page " << i->second << ": "
+                     << e.what();
+            ::remove(i->second.c_str());
+        }
+    }
+
+    /* unless history is already known, the newest page determines it */
+    gu::UUID gid(gid_);
+    for (std::vector<Page*>::reverse_iterator r(found.rbegin());
+         gu::UUID() == gid && r != found.rend(); ++r)
+    {
+        gid = (*r)->gid();
+    }
+
+    size_t recovered(0);
+
+    for (size_t i(0); i < found.size(); ++i)
+    {
+        Page* const page(found[i]);
+        size_t const n(gu::UUID() != gid && page->gid() == gid ?
+                       page->recover(seqno2ptr_) : 0);
+
+        if (n > 0)
+        {
+            pages_.push_back(page);
+            total_size_ += page->size();
+            recovered   += n;
+        }
+        else
+        {
+            std::string const name(page->name());
+            delete page;
+            if (::remove(name.c_str()))
+            {
+                int const err(errno);
+                log_warn << "Failed to remove page file '" << name << "': "
+                         << err << " (" << strerror(err) << ')';
+            }
+            else
+            {
+                log_info << "Deleted unusable page " << name;
+            }
+        }
+    }
+
+    if (recovered > 0)
+    {
+        gid_ = gid;
+
+        log_info << "Recovered " << recovered << " buffers of history " << gid
+                 << " from " << pages_.size() << " GCache page(s)";
+    }
 }
 
 gcache::PageStore::~PageStore ()
 {
+    if (reserve_max_ > 0)
+    {
+        {
+            gu::Lock lock(reserve_mtx_);
+            reserve_exit_ = true;
+            reserve_cond_.signal();
+        }
+
+        pthread_join (reserve_thr_, NULL);
+    }
+
+    if (persist_)
+    {
+        /* leave pages holding buffers on disk for recovery on restart */
+        size_t kept(0);
+
+        for (std::deque<Page*>::iterator i(pages_.begin()); i != pages_.end();)
+        {
+            if ((*i)->used() > 0)
+            {
+                total_size_ -= (*i)->size();
+                delete *i;
+                i = pages_.erase(i);
+                kept++;
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        current_ = 0;
+
+        if (kept > 0)
+        {
+            log_info << "Keeping " << kept << " GCache page(s) for recovery";
+        }
+    }
+
     try
     {
+        delete_page_files (reserve_);
+
         while (pages_.size() && delete_page()) {};
 #ifndef GCACHE_DETACH_THREAD
         if (delete_thr_ != pthread_t(-1)) pthread_join (delete_thr_, NULL);
@@ -10,6 +10,10 @@
 #include "gcache_memops.hpp"
 #include "gcache_page.hpp"
 #include "gcache_seqno.hpp"
+#include "gcache_types.hpp"
+
+#include <gu_uuid.hpp>
+#include <gu_lock.hpp>
 
 #include <string>
 #include <deque>
@@ -20,10 +24,20 @@ namespace gcache
     {
     public:
 
+        /* If recover is true, page files left by the previous run are
+         * scanned and buffers of history gid (or the history of the newest
+         * page if gid is undefined) are added to seqno2ptr as released.
+         * Page files are then left on disk at shutdown.
+         * If reserve is not 0, a background thread keeps that many empty
+         * pages ready once the store gets used, see new_page(). */
         PageStore (const std::string& dir_name,
                    size_t             keep_size,
                    size_t             page_size,
-                   size_t             keep_page);
+                   size_t             keep_page,
+                   seqno2ptr_t&       seqno2ptr,
+                   gu::UUID&          gid,
+                   bool               recover = false,
+                   size_t             reserve = 0);
 
         ~PageStore ();
 
@@ -47,8 +61,16 @@ namespace gcache
 
         void  reset();
 
+        /* new history: don't mix it with the old one in the same page */
+        void  seqno_reset() { current_ = 0; }
+
+        /* highest seqno in the oldest page, SEQNO_NONE if no pages */
+        seqno_t oldest_seqno_max() const
+        {
+            return pages_.empty() ? SEQNO_NONE : pages_.front()->seqno_max();
+        }
 
-        void  set_page_size (size_t size) { page_size_ = size; cleanup();}
+        void  set_page_size (size_t size);
 
         void  set_keep_size (size_t size) { keep_size_ = size; cleanup();}
 
@@ -57,13 +79,26 @@ namespace gcache
         size_t allocated_pool_size ();
 
         /* for unit tests */
-        size_t count()       const { return count_;        }
+        size_t count()
+        {
+            gu::Lock lock(reserve_mtx_);
+            return count_;
+        }
         size_t total_pages() const { return pages_.size(); }
         size_t total_size()  const { return total_size_;   }
+        long long pages_created() const { return pages_created_; }
+        long long pages_deleted() const { return pages_deleted_; }
+        size_t reserved()
+        {
+            gu::Lock lock(reserve_mtx_);
+            return reserve_.size();
+        }
 
     private:
 
         std::string const base_name_; /* /.../.../gcache.page. */
+        seqno2ptr_t&      seqno2ptr_;
+        gu::UUID&         gid_;
         size_t            keep_size_; /* how much pages to keep after freeing*/
         size_t            page_size_; /* min size of the individual page */
         size_t            keep_page_; /* whether to keep the last page(s) */
@@ -71,21 +106,52 @@ namespace gcache
         std::deque<Page*> pages_;
         Page*             current_;
         size_t            total_size_;
+        long long         pages_created_;
+        long long         pages_deleted_;
+        bool              persist_;   /* leave page files at shutdown */
         pthread_attr_t    delete_page_attr_;
 #ifndef GCACHE_DETACH_THREAD
         pthread_t         delete_thr_;
 #endif /* GCACHE_DETACH_THREAD */
 
+        /* page pre-allocation thread state, protected by reserve_mtx_
+         * together with count_ */
+#ifdef HAVE_PSI_INTERFACE
+        gu::MutexWithPFS  reserve_mtx_;
+        gu::CondWithPFS   reserve_cond_;
+#else
+        gu::Mutex         reserve_mtx_;
+        gu::Cond          reserve_cond_;
+#endif /* HAVE_PSI_INTERFACE */
+        std::deque<Page*> reserve_;      /* ready empty pages */
+        size_t            reserve_max_;  /* 0 - no pre-allocation thread */
+        size_t            reserve_size_; /* page_size_ for the thread */
+        bool              reserve_on_;   /* the store is in use */
+        bool              reserve_busy_; /* a page is being created */
+        bool              reserve_exit_;
+        pthread_t         reserve_thr_;
+
         void new_page    (size_type size);
 
         // returns true if a page could be deleted
         bool delete_page ();
 
+        // closes the page and removes its file in background
+        void delete_page_file (Page* page);
+
+        // same for all pages in the deque, which is left empty
+        void delete_page_files (std::deque<Page*>& pages);
+
+        static void* reserve_thread (void* arg);
+        void  reserve_loop ();
+
         // cleans up extra pages.
         void cleanup     ();
 
         void* malloc_new (size_type size);
 
+        void  recover    ();
+
         void
         free_page_ptr (Page* page, BufferHeader* bh)
         {
@@ -4,6 +4,8 @@
 
 #include "GCache.hpp"
 
+#include <algorithm>
+
 static const std::string GCACHE_PARAMS_DIR        ("gcache.dir");
 static const std::string GCACHE_DEFAULT_DIR       ("");
 static const std::string GCACHE_PARAMS_RB_NAME    ("gcache.name");
@@ -18,8 +20,24 @@ static const std::string GCACHE_PARAMS_KEEP_PAGES_SIZE("gcache.keep_pages_size")
 static const std::string GCACHE_PARAMS_KEEP_PAGES_COUNT("gcache.keep_pages_count");
 static const std::string GCACHE_DEFAULT_KEEP_PAGES_SIZE("0");
 static const std::string GCACHE_DEFAULT_KEEP_PAGES_COUNT("0");
+static const std::string GCACHE_PARAMS_KEEP_PAGES_BUDGET("gcache.keep_pages_budget");
+static const std::string GCACHE_DEFAULT_KEEP_PAGES_BUDGET("0");
+static const std::string GCACHE_PARAMS_PAGE_RESERVE("gcache.page_reserve");
+static const std::string GCACHE_DEFAULT_PAGE_RESERVE("1");
+static const std::string GCACHE_PARAMS_HUGEPAGES  ("gcache.hugepages");
+static const std::string GCACHE_DEFAULT_HUGEPAGES ("no");
+static const std::string GCACHE_PARAMS_POPULATE   ("gcache.populate");
+static const std::string GCACHE_DEFAULT_POPULATE  ("no");
+static const std::string GCACHE_PARAMS_MLOCK      ("gcache.mlock");
+static const std::string GCACHE_DEFAULT_MLOCK     ("no");
 static const std::string GCACHE_PARAMS_RECOVER    ("gcache.recover");
 static const std::string GCACHE_DEFAULT_RECOVER   ("no");
+static const std::string GCACHE_PARAMS_RECOVER_THREADS ("gcache.recover_threads");
+static const std::string GCACHE_DEFAULT_RECOVER_THREADS("0");
+static const std::string GCACHE_PARAMS_COLD_SIZE  ("gcache.cold_size");
+static const std::string GCACHE_DEFAULT_COLD_SIZE ("0");
+static const std::string GCACHE_PARAMS_COLD_AGE   ("gcache.cold_age");
+static const std::string GCACHE_DEFAULT_COLD_AGE  ("0");
 static const std::string GCACHE_PARAMS_FREEZE_PURGE_SEQNO("gcache.freeze_purge_at_seqno");
 static const std::string GCACHE_DEFAULT_FREEZE_PURGE_SEQNO("-1");
 
@@ -33,7 +51,15 @@ gcache::GCache::Params::register_params(gu::Config& cfg)
     cfg.add(GCACHE_PARAMS_PAGE_SIZE,        GCACHE_DEFAULT_PAGE_SIZE);
     cfg.add(GCACHE_PARAMS_KEEP_PAGES_SIZE,  GCACHE_DEFAULT_KEEP_PAGES_SIZE);
     cfg.add(GCACHE_PARAMS_KEEP_PAGES_COUNT, GCACHE_DEFAULT_KEEP_PAGES_COUNT);
+    cfg.add(GCACHE_PARAMS_KEEP_PAGES_BUDGET, GCACHE_DEFAULT_KEEP_PAGES_BUDGET);
+    cfg.add(GCACHE_PARAMS_PAGE_RESERVE,     GCACHE_DEFAULT_PAGE_RESERVE);
+    cfg.add(GCACHE_PARAMS_HUGEPAGES,        GCACHE_DEFAULT_HUGEPAGES);
+    cfg.add(GCACHE_PARAMS_POPULATE,         GCACHE_DEFAULT_POPULATE);
+    cfg.add(GCACHE_PARAMS_MLOCK,            GCACHE_DEFAULT_MLOCK);
     cfg.add(GCACHE_PARAMS_RECOVER,          GCACHE_DEFAULT_RECOVER);
+    cfg.add(GCACHE_PARAMS_RECOVER_THREADS,  GCACHE_DEFAULT_RECOVER_THREADS);
+    cfg.add(GCACHE_PARAMS_COLD_SIZE,        GCACHE_DEFAULT_COLD_SIZE);
+    cfg.add(GCACHE_PARAMS_COLD_AGE,         GCACHE_DEFAULT_COLD_AGE);
     cfg.add(GCACHE_PARAMS_FREEZE_PURGE_SEQNO, GCACHE_DEFAULT_FREEZE_PURGE_SEQNO);
 }
 
@@ -71,7 +97,18 @@ gcache::GCache::Params::Params (gu::Config& cfg, const std::string& data_dir)
     page_size_(cfg.get<size_t>(GCACHE_PARAMS_PAGE_SIZE)),
     keep_pages_size_(cfg.get<size_t>(GCACHE_PARAMS_KEEP_PAGES_SIZE)),
     keep_pages_count_(cfg.get<size_t>(GCACHE_PARAMS_KEEP_PAGES_COUNT)),
+    page_reserve_(cfg.get<size_t>(GCACHE_PARAMS_PAGE_RESERVE)),
+    rb_mmap_opts_((cfg.get<bool>(GCACHE_PARAMS_HUGEPAGES) ?
+                   RingBuffer::MMAP_HUGEPAGES : 0) |
+                  (cfg.get<bool>(GCACHE_PARAMS_POPULATE) ?
+                   RingBuffer::MMAP_POPULATE  : 0) |
+                  (cfg.get<bool>(GCACHE_PARAMS_MLOCK) ?
+                   RingBuffer::MMAP_LOCK      : 0)),
     recover_  (cfg.get<bool>(GCACHE_PARAMS_RECOVER)),
+    recover_threads_(cfg.get<int>(GCACHE_PARAMS_RECOVER_THREADS)),
+    cold_size_(cfg.get<size_t>(GCACHE_PARAMS_COLD_SIZE)),
+    cold_age_ (cfg.get<int64_t>(GCACHE_PARAMS_COLD_AGE)),
+    keep_pages_budget_(cfg.get<size_t>(GCACHE_PARAMS_KEEP_PAGES_BUDGET)),
     freeze_purge_at_seqno_(cfg.get<seqno_t>(GCACHE_PARAMS_FREEZE_PURGE_SEQNO))
 {}
 
@@ -148,7 +185,47 @@ gcache::GCache::param_set (const std::string& key, const std::string& val)
                           params.keep_pages_count() :
                           !((params.mem_size() + params.rb_size()) > 0));
    }
-   else if (key == GCACHE_PARAMS_RECOVER)
+   else if (key == GCACHE_PARAMS_KEEP_PAGES_BUDGET)
+   {
+       size_t const tmp_size(gu::Config::from_config<size_t>(val));
+
+       gu::Lock lock(mtx);
+
+       config.set<size_t>(key, tmp_size);
+       params.keep_pages_budget(tmp_size);
+   }
+   else if (key == GCACHE_PARAMS_PAGE_RESERVE)
+   {
+       gu_throw_error(EPERM) << "Can't change page reserve in runtime.";
+   }
+   else if (key == GCACHE_PARAMS_HUGEPAGES ||
+            key == GCACHE_PARAMS_POPULATE  ||
+            key == GCACHE_PARAMS_MLOCK)
+   {
+       gu_throw_error(EPERM) << "Can't change ring buffer memory mapping "
+                             << "options in runtime.";
+   }
+   else if (key == GCACHE_PARAMS_COLD_SIZE)
+   {
+       gu_throw_error(EPERM) << "Can't change cold history size in runtime.";
+   }
+   else if (key == GCACHE_PARAMS_COLD_AGE)
+   {
+       int64_t const age(gu::Config::from_config<int64_t>(val));
+
+       if (age < 0)
+       {
+           gu_throw_error(EINVAL) << "Negative " << key << ": " << age;
+       }
+
+       gu::Lock lock(mtx);
+
+       config.set<int64_t>(key, age);
+       params.cold_age(age);
+       cold_notify();
+   }
+   else if (key == GCACHE_PARAMS_RECOVER ||
+            key == GCACHE_PARAMS_RECOVER_THREADS)
    {
        gu_throw_error(EINVAL) << "'" << key
                               << "' has a meaning only on startup.";
@@ -186,3 +263,27 @@ gcache::GCache::param_set (const std::string& key, const std::string& val)
        throw gu::NotFound();
    }
 }
+
+void
+gcache::GCache::keep_pages_grow ()
+{
+    Advice a;
+    advice_locked(a);
+
+    /* the ring buffer holds the newest history, pages have to hold the
+     * rest */
+    if (a.recommended_size <= params.rb_size()) return;
+
+    size_t const keep(std::min(a.recommended_size - params.rb_size(),
+                               params.keep_pages_budget()));
+
+    if (keep <= params.keep_pages_size()) return;
+
+    log_info << "Growing " << GCACHE_PARAMS_KEEP_PAGES_SIZE << " from "
+             << params.keep_pages_size() << " to " << keep
+             << " to hold " << a.recommended_time << " seconds of history";
+
+    config.set<size_t>(GCACHE_PARAMS_KEEP_PAGES_SIZE, keep);
+    params.keep_pages_size(keep);
+    ps.set_keep_size(params.keep_pages_size());
+}
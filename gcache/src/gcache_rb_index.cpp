@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file ring buffer seqno index: saves locations of seqno'd buffers on
+ *        graceful close so that recovery does not have to scan the buffer */
+
+#include "gcache_rb_store.hpp"
+#include "gcache_limits.hpp"
+
+#include <gu_logger.hpp>
+#include <gu_throw.hpp>
+#include <gu_hash.h>
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+/*
+ * Index file: header followed by a list of (seqno, offset) pairs of all
+ * seqno'd buffers in the ring buffer in the order of their location, starting
+ * with the first (oldest). Each pair is stored as two zigzag LEB128-encoded
+ * deltas: of the seqno and of the offset (in MemOps::ALIGNMENT units) from
+ * the previous pair, so a typical entry takes 2-4 bytes.
+ */
+namespace
+{
+    static const char   IDX_MAGIC[8] = { 'G','R','B','I','D','X','1','\0' };
+    static size_t const IDX_HEADER_LEN = 128;
+
+    struct IndexHeader
+    {
+        char     magic[sizeof(IDX_MAGIC)];
+        uint64_t size;     /* size_cache_, offsets are valid only for it */
+        int64_t  seqno_min;
+        int64_t  seqno_max;
+        uint64_t count;
+        uint64_t first;    /* offsets from the start of the cache area */
+        uint64_t next;
+        uint64_t trail;    /* size_trail_ */
+        uint64_t holes;    /* total size of discarded buffers in between */
+    }__attribute__((__packed__));
+
+    GU_COMPILE_ASSERT(sizeof(IndexHeader) <= IDX_HEADER_LEN,
+                      index_header_size_check);
+
+    /* number of last entries which headers are checked on recovery */
+    static size_t const IDX_TAIL = 16;
+
+    inline void
+    idx_put (std::vector<uint8_t>& buf, int64_t const d)
+    {
+        uint64_t v((uint64_t(d) << 1) ^ uint64_t(d >> 63)); // zigzag
+
+        while (v >= 0x80)
+        {
+            buf.push_back(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+
+        buf.push_back(uint8_t(v));
+    }
+
+    /* returns false if the buffer ends prematurely */
+    inline bool
+    idx_get (const uint8_t*& p, const uint8_t* const end, int64_t& d)
+    {
+        uint64_t v(0);
+
+        for (unsigned int shift(0); p < end && shift < 64; shift += 7)
+        {
+            uint8_t const b(*p++);
+
+            v |= uint64_t(b & 0x7f) << shift;
+
+            if (!(b & 0x80))
+            {
+                d = int64_t(v >> 1) ^ -int64_t(v & 1);
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+namespace gcache
+{
+    void
+    RingBuffer::remove_index() const
+    {
+        std::string const name(index_name());
+
+        if (::unlink(name.c_str()) && ENOENT != errno)
+        {
+            int const err(errno);
+            log_warn << "Failed to remove GCache ring buffer index '" << name
+                     << "': " << err << " (" << strerror(err) << ')';
+        }
+    }
+
+    uint64_t
+    RingBuffer::write_index()
+    {
+        IndexHeader hdr;
+        ::memset(&hdr, 0, sizeof(hdr));
+        ::memcpy(hdr.magic, IDX_MAGIC, sizeof(hdr.magic));
+        hdr.size = size_cache_;
+
+        std::vector<uint8_t> buf(IDX_HEADER_LEN);
+
+        BufferHeader* first(NULL);
+        BufferHeader* last(NULL);
+        size_t        holes(0);
+        seqno_t       prev_seqno(0);
+        off_t         prev_off(0);
+
+        /* Collect the same state recover() would arrive at: trim discarded
+         * buffers at both ends. Seqno'd buffers are left as they are, they
+         * are released in bulk after recovery, see recover_index(). Only
+         * unordered buffers which were not freed need the released flag,
+         * as they would block the ring buffer otherwise. */
+        BufferHeader* bh(BH_cast(first_));
+        while (bh != BH_cast(next_))
+        {
+            if (gu_unlikely(0 == bh->size))
+            {
+                bh = BH_cast(start_); // rollover
+                continue;
+            }
+
+            if (SEQNO_NONE == bh->seqno_g && !BH_is_released(bh))
+            {
+                bh->flags |= BUFFER_RELEASED;
+            }
+
+            if (bh->seqno_g > 0)
+            {
+                off_t const off(reinterpret_cast<uint8_t*>(bh) - start_);
+
+                if (NULL == first)
+                {
+                    first = bh;
+                    hdr.seqno_min = hdr.seqno_max = bh->seqno_g;
+                }
+
+                hdr.seqno_min = std::min<int64_t>(hdr.seqno_min, bh->seqno_g);
+                hdr.seqno_max = std::max<int64_t>(hdr.seqno_max, bh->seqno_g);
+                hdr.count++;
+                hdr.holes = holes;
+
+                idx_put(buf, bh->seqno_g - prev_seqno);
+                idx_put(buf, (off - prev_off) / MemOps::ALIGNMENT);
+
+                prev_seqno = bh->seqno_g;
+                prev_off   = off;
+                last       = bh;
+            }
+            else if (SEQNO_ILL == bh->seqno_g && NULL != first)
+            {
+                holes += bh->size;
+            }
+
+            bh = BH_next(bh);
+        }
+
+        if (NULL == first) return 0;
+
+        uint8_t* const first_ptr(reinterpret_cast<uint8_t*>(first));
+        uint8_t* const next_ptr (reinterpret_cast<uint8_t*>(BH_next(last)));
+
+        hdr.first = first_ptr - start_;
+        hdr.next  = next_ptr  - start_;
+        hdr.trail = (first_ptr < next_ptr ? 0 : size_trail_);
+
+        ::memcpy(&buf[0], &hdr, sizeof(hdr));
+
+        {
+#ifdef HAVE_PSI_INTERFACE
+            gu::FileDescriptor fd(index_name(),
+                                  WSREP_PFS_INSTR_TAG_RINGBUFFER_FILE,
+                                  buf.size(), true, true);
+#else
+            gu::FileDescriptor fd(index_name(), buf.size(), true, true);
+#endif /* HAVE_PSI_INTERFACE */
+            gu::MMap mmap(fd);
+
+            ::memcpy(mmap.ptr, &buf[0], buf.size());
+            mmap.sync();
+        }
+
+        uint64_t const hash(gu_fast_hash64(&buf[0], buf.size()));
+
+        log_info << "Saved GCache ring buffer index: " << hdr.count
+                 << " seqnos " << hdr.seqno_min << '-' << hdr.seqno_max
+                 << ", " << buf.size() << " bytes";
+
+        return (hash ? hash : 1);
+    }
+
+    bool
+    RingBuffer::recover_index(uint64_t const hash)
+    {
+        static const char* const diag_prefix =
+            "Recovering GCache ring buffer from index: ";
+
+        std::string const name(index_name());
+
+        try
+        {
+#ifdef HAVE_PSI_INTERFACE
+            gu::FileDescriptor fd(name, WSREP_PFS_INSTR_TAG_RINGBUFFER_FILE,
+                                  false);
+#else
+            gu::FileDescriptor fd(name, false);
+#endif /* HAVE_PSI_INTERFACE */
+            gu::MMap mmap(fd, true);
+
+            const uint8_t* const buf(static_cast<const uint8_t*>(mmap.ptr));
+            const uint8_t* const buf_end(buf + mmap.size);
+
+            if (mmap.size < IDX_HEADER_LEN ||
+                gu_fast_hash64(buf, mmap.size) != hash)
+            {
+                log_info << diag_prefix << "checksum mismatch.";
+                return false;
+            }
+
+            IndexHeader hdr;
+            ::memcpy(&hdr, buf, sizeof(hdr));
+
+            if (::memcmp(hdr.magic, IDX_MAGIC, sizeof(hdr.magic)) ||
+                hdr.size != size_cache_ ||
+                0 == hdr.count || hdr.seqno_min <= 0 ||
+                hdr.seqno_max < hdr.seqno_min ||
+                uint64_t(hdr.seqno_max - hdr.seqno_min) + 1 < hdr.count ||
+                hdr.first >= size_cache_ || hdr.next > size_cache_ ||
+                (hdr.first % MemOps::ALIGNMENT) ||
+                (hdr.next  % MemOps::ALIGNMENT) ||
+                (hdr.first <  hdr.next && hdr.trail != 0) ||
+                (hdr.first >= hdr.next && (hdr.trail < sizeof(BufferHeader) ||
+                                           hdr.trail > size_t(end_ - start_))))
+            {
+                log_info << diag_prefix << "bogus header.";
+                return false;
+            }
+
+            /* Pass 1: decode and validate everything without touching the
+             * ring buffer, remember locations of the tail entries. */
+            size_t const range(hdr.seqno_max - hdr.seqno_min + 1);
+            std::vector<bool> seen(range, false);
+            std::vector<std::pair<seqno_t, off_t> > tail(IDX_TAIL);
+
+            const uint8_t* p(buf + IDX_HEADER_LEN);
+            seqno_t s(0);
+            off_t   off(0);
+
+            for (uint64_t i(0); i < hdr.count; ++i)
+            {
+                int64_t ds, doff;
+
+                if (!idx_get(p, buf_end, ds) || !idx_get(p, buf_end, doff))
+                {
+                    log_info << diag_prefix << "truncated.";
+                    return false;
+                }
+
+                s   += ds;
+                off += doff * MemOps::ALIGNMENT;
+
+                if (s < hdr.seqno_min || s > hdr.seqno_max ||
+                    seen[s - hdr.seqno_min] || off < 0 ||
+                    size_t(off) + sizeof(BufferHeader) > size_cache_ ||
+                    (0 == i && off != off_t(hdr.first)))
+                {
+                    log_info << diag_prefix << "bogus entry " << i << ": "
+                             << s << '@' << off;
+                    return false;
+                }
+
+                seen[s - hdr.seqno_min] = true;
+                tail[i % IDX_TAIL] = std::make_pair(s, off);
+            }
+
+            /* Buffers recovered from pages may fill gaps in the ring buffer
+             * history, but the result must be gapless as recover() would
+             * otherwise discard a part of it. */
+            seqno_t min(hdr.seqno_min);
+            seqno_t max(hdr.seqno_max);
+
+            if (!seqno2ptr_.empty())
+            {
+                min = std::min(min, seqno2ptr_.begin()->first);
+                max = std::max(max, seqno2ptr_.rbegin()->first);
+
+                for (seqno2ptr_t::iterator i(seqno2ptr_.lower_bound(
+                                                 hdr.seqno_min));
+                     i != seqno2ptr_.end() && i->first <= hdr.seqno_max; ++i)
+                {
+                    if (seen[i->first - hdr.seqno_min])
+                    {
+                        log_info << diag_prefix << "seqno " << i->first
+                                 << " is also found in page store.";
+                        return false;
+                    }
+                }
+            }
+
+            if (uint64_t(max - min + 1) != seqno2ptr_.size() + hdr.count)
+            {
+                log_info << diag_prefix << "history is not contiguous.";
+                return false;
+            }
+
+            /* Validate the tail: buffers must be where the index says */
+            size_t const tail_len(std::min<uint64_t>(hdr.count, IDX_TAIL));
+
+            for (size_t i(0); i < tail_len; ++i)
+            {
+                std::pair<seqno_t, off_t> const& t(
+                    tail[(hdr.count - 1 - i) % IDX_TAIL]);
+                const BufferHeader* const b(BH_cast(start_ + t.second));
+
+                if (!BH_test(b) || b->seqno_g != t.first ||
+                    size_t(t.second) + b->size > size_t(end_ - start_) ||
+                    (0 == i && size_t(t.second) + b->size != hdr.next))
+                {
+                    log_info << diag_prefix << "buffer " << t.first
+                             << " not found at offset " << t.second;
+                    return false;
+                }
+            }
+
+            {
+                const BufferHeader* const b(BH_cast(start_ + hdr.first));
+
+                if (!BH_test(b) || b->seqno_g <= 0)
+                {
+                    log_info << diag_prefix << "first buffer not found.";
+                    return false;
+                }
+            }
+
+            /* Pass 2: populate seqno2ptr */
+            p = buf + IDX_HEADER_LEN;
+            s = 0;
+            off = 0;
+
+            for (uint64_t i(0); i < hdr.count; ++i)
+            {
+                int64_t ds, doff;
+
+                idx_get(p, buf_end, ds);
+                idx_get(p, buf_end, doff);
+
+                s   += ds;
+                off += doff * MemOps::ALIGNMENT;
+
+                BufferHeader* const b(BH_cast(start_ + off));
+                seqno2ptr_.insert(seqno2ptr_pair_t(s, b + 1));
+            }
+
+            first_      = start_ + hdr.first;
+            next_       = start_ + hdr.next;
+            size_trail_ = hdr.trail;
+            BH_clear(BH_cast(next_));
+
+            estimate_space();
+            /* as in recover(): all buffers are released and discarded ones
+             * are free space. Seqno'd buffers don't need the released flag
+             * in their headers: they are released in bulk up to the
+             * recovered seqno_max, see released() and GCache::GCache() */
+            size_used_  = 0;
+            size_free_ += hdr.holes;
+
+            assert_sizes();
+
+            log_info << diag_prefix << "found gapless sequence "
+                     << hdr.seqno_min << '-' << hdr.seqno_max;
+            log_info << "GCache DEBUG: RingBuffer::recover_index(): used space: "
+                     << size_cache_ - size_free_ << '/' << size_cache_;
+
+            return true;
+        }
+        catch (gu::Exception& e)
+        {
+            log_info << diag_prefix << "failed to read '" << name << "': "
+                     << e.what();
+            return false;
+        }
+    }
+
+} /* namespace gcache */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+/*! @file parallel part of the ring buffer recovery scan */
+
+#include "gcache_rb_store.hpp"
+
+#include <gu_logger.hpp>
+#include <gu_threads.h>
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace
+{
+    /* regions smaller than that are not worth a thread */
+    static size_t const SCAN_REGION_MIN  = 64 << 20;
+    static long   const SCAN_THREADS_MAX = 16;
+
+    /* number of consecutive buffer headers which must check out to
+     * resynchronize on a buffer chain */
+    static int    const SCAN_SYNC_DEPTH  = 4;
+}
+
+namespace gcache
+{
+    /* the same test as GCACHE_SCAN_BUFFER_TEST in scan(): a sane header
+     * followed by a sane header */
+    static inline bool
+    scan_test (const uint8_t* const ptr, const uint8_t* const end)
+    {
+        const BufferHeader* const bh
+            (reinterpret_cast<const BufferHeader*>(ptr));
+
+        return (BH_test(bh) && bh->size > 0 &&
+                bh->size <= size_t(end - ptr) &&
+                BH_test(ptr + bh->size));
+    }
+
+    /* true if ptr starts a chain of at least SCAN_SYNC_DEPTH sane headers
+     * or a shorter one terminated by a clear header */
+    static bool
+    scan_sync (const uint8_t* ptr, const uint8_t* const end)
+    {
+        for (int i(0); i < SCAN_SYNC_DEPTH; ++i)
+        {
+            if (!scan_test(ptr, end))
+            {
+                return (i > 0 && BH_is_clear(
+                            reinterpret_cast<const BufferHeader*>(ptr)));
+            }
+
+            ptr += reinterpret_cast<const BufferHeader*>(ptr)->size;
+        }
+
+        return true;
+    }
+
+    void*
+    RingBuffer::scan_region_thread (void* const arg)
+    {
+        ScanRegion&    r(*static_cast<ScanRegion*>(arg));
+        uint8_t* const end(r.rb->end_ - sizeof(BufferHeader));
+        uint8_t*       ptr(r.begin);
+
+        while (ptr < r.end && !scan_sync(ptr, end)) ptr += r.step;
+
+        if (ptr >= r.end) return NULL; // no chain starts in this region
+
+        r.sync = ptr;
+
+        while (ptr < r.end && scan_test(ptr, end))
+        {
+            BufferHeader* const bh(BH_cast(ptr));
+
+            if (bh->seqno_g > 0) r.seqnos.push_back(bh);
+
+            ptr += bh->size;
+        }
+
+        r.stop = ptr;
+
+        return NULL;
+    }
+
+    void
+    RingBuffer::scan_regions (ScanRegions& regions, int const step)
+    {
+        size_t const size(end_ - start_);
+        long         n(scan_threads_);
+
+        if (n <= 0)
+        {
+            n = std::min(::sysconf(_SC_NPROCESSORS_ONLN), SCAN_THREADS_MAX);
+            n = std::min(n, long(size / SCAN_REGION_MIN));
+        }
+
+        size_t region(n > 0 ? size / n : 0);
+        region -= region % step;
+
+        if (n < 2 || region < SCAN_SYNC_DEPTH * sizeof(BufferHeader)) return;
+
+        log_info << "GCache::RingBuffer initial scan in " << n << " threads";
+
+        regions.resize(n);
+
+        for (long i(0); i < n; ++i)
+        {
+            ScanRegion& r(regions[i]);
+
+            r.rb       = this;
+            r.begin    = start_ + i * region;
+            r.end      = (i + 1 < n ? r.begin + region :
+                          end_ - sizeof(BufferHeader));
+            r.step     = step;
+            r.joinable = (0 == gu_thread_create(&r.thr, NULL,
+                                                scan_region_thread, &r));
+        }
+
+        size_t synced(0);
+
+        for (long i(0); i < n; ++i)
+        {
+            ScanRegion& r(regions[i]);
+
+            if (r.joinable)
+                gu_thread_join(r.thr, NULL);
+            else
+                scan_region_thread(&r);
+
+            if (r.sync) ++synced;
+        }
+
+        log_info << "GCache::RingBuffer initial scan: found buffers in "
+                 << synced << " of " << n << " regions";
+    }
+
+    RingBuffer::ScanRegion*
+    RingBuffer::scan_adopt (ScanRegions&         regions,
+                            const uint8_t* const ptr,
+                            const uint8_t* const segment_end)
+    {
+        if (regions.empty()) return NULL;
+
+        size_t const region(regions[0].end - regions[0].begin);
+        size_t const i(std::min<size_t>((ptr - start_) / region,
+                                        regions.size() - 1));
+        ScanRegion&  r(regions[i]);
+
+        /* the chain from r.sync is the same as the one being walked, unless
+         * it goes beyond the current segment */
+        if (ptr != r.sync || r.adopted || r.stop > segment_end) return NULL;
+
+        r.adopted = true;
+
+        return &r;
+    }
+
+    void*
+    RingBuffer::mark_region_thread (void* const arg)
+    {
+        ScanRegion& r(*static_cast<ScanRegion*>(arg));
+
+        for (uint8_t* ptr(r.sync); ptr != r.stop; )
+        {
+            BufferHeader* const bh(BH_cast(ptr));
+
+            bh->flags |= BUFFER_RELEASED;
+            bh->ctx    = r.rb;
+
+            ptr += bh->size;
+        }
+
+        return NULL;
+    }
+
+    /* marks buffers of the adopted regions like scan() does for the rest */
+    void
+    RingBuffer::scan_mark (ScanRegions& regions)
+    {
+        for (size_t i(0); i < regions.size(); ++i)
+        {
+            ScanRegion& r(regions[i]);
+
+            r.joinable = (r.adopted &&
+                          0 == gu_thread_create(&r.thr, NULL,
+                                                mark_region_thread, &r));
+        }
+
+        size_t adopted(0);
+
+        for (size_t i(0); i < regions.size(); ++i)
+        {
+            ScanRegion& r(regions[i]);
+
+            if (r.joinable)
+                gu_thread_join(r.thr, NULL);
+            else if (r.adopted)
+                mark_region_thread(&r);
+
+            if (r.adopted) ++adopted;
+        }
+
+        if (!regions.empty())
+        {
+            log_info << "GCache::RingBuffer initial scan: used results of "
+                     << adopted << " of " << regions.size() << " regions";
+        }
+    }
+
+} /* namespace gcache */
@@ -12,9 +12,12 @@
 #include <gu_progress.hpp>
 #include <gu_hexdump.hpp>
 #include <gu_hash.h>
+#include <gu_time.h>
 
 #include <cassert>
 
+#include <sys/resource.h>
+
 namespace gcache
 {
     static inline size_t check_size (size_t s)
@@ -36,6 +39,8 @@ namespace gcache
         size_used_ = 0;
         size_trail_= 0;
 
+        seqno_release_reset();
+
 //        mallocs_  = 0;
 //        reallocs_ = 0;
     }
@@ -47,7 +52,9 @@ namespace gcache
                             size_t             size,
                             seqno2ptr_t&       seqno2ptr,
                             gu::UUID&          gid,
-                            bool const         recover)
+                            bool const         recover,
+                            int const          mmap_opts,
+                            int const          scan_threads)
     :
 #ifdef HAVE_PSI_INTERFACE
         fd_        (name, WSREP_PFS_INSTR_TAG_RINGBUFFER_FILE, check_size(size)),
@@ -70,14 +77,58 @@ namespace gcache
         size_free_ (size_cache_),
         size_used_ (0),
         size_trail_(0),
+        wraps_     (0),
+        seqno2size_(),
+        size_assigned_ (1),
+        size_released_ (1),
+        seqno_released_(SEQNO_NONE),
 //        mallocs_   (0),
 //        reallocs_  (0),
-        open_      (true)
+        open_      (true),
+        index_hash_(0),
+        save_index_(recover),
+        scan_threads_(scan_threads)
     {
         assert((uintptr_t(start_) % MemOps::ALIGNMENT) == 0);
         constructor_common ();
+
+        /* must be advised before the pages are touched by recovery */
+        if (mmap_opts & MMAP_HUGEPAGES) mmap_.hugepages();
+
         open_preamble(recover);
         BH_clear (BH_cast(next_));
+
+        mmap_setup(mmap_opts);
+    }
+
+    void
+    RingBuffer::mmap_setup(int const opts)
+    {
+        if (!(opts & (MMAP_POPULATE | MMAP_LOCK))) return;
+
+#ifdef RUSAGE_THREAD
+        int const who(RUSAGE_THREAD);
+#else
+        int const who(RUSAGE_SELF);
+#endif
+        struct rusage ru_start, ru_end;
+        ::getrusage(who, &ru_start);
+        long long const start(gu_time_monotonic());
+
+        bool const populated((opts & MMAP_POPULATE) && mmap_.populate());
+        bool const locked   ((opts & MMAP_LOCK)     && mmap_.lock());
+
+        long long const end(gu_time_monotonic());
+        ::getrusage(who, &ru_end);
+
+        log_info << "GCache ring buffer " << mmap_.size << " bytes"
+                 << (populated ? " prefaulted" : "")
+                 << (populated && locked ? " and" : "")
+                 << (locked ? " locked in memory" : "")
+                 << " in " << (double(end - start) / 1.0e9)
+                 << " sec, page faults minor/major: "
+                 << (ru_end.ru_minflt - ru_start.ru_minflt) << '/'
+                 << (ru_end.ru_majflt - ru_start.ru_majflt);
     }
 
     RingBuffer::~RingBuffer ()
@@ -99,6 +150,61 @@ namespace gcache
         return (SEQNO_ILL == bh->seqno_g);
     }
 
+    static inline void
+    discard_in_page(BufferHeader* const bh)
+    {
+        Page*      const page (static_cast<Page*>(bh->ctx));
+        PageStore* const ps   (PageStore::page_store(page));
+        ps->discard(bh);
+    }
+
+    /* marks empty and discards released page buffers in range,
+     * seqno2ptr entries are left for the caller to erase */
+    static void
+    empty_page_buffers(seqno2ptr_t::iterator       i,
+                       seqno2ptr_t::iterator const i_end)
+    {
+        for (; i != i_end; ++i)
+        {
+            if (NULL == i->second) continue;
+
+            BufferHeader* const bh(ptr2BH(i->second));
+
+            if (BUFFER_IN_PAGE == bh->store)
+            {
+                empty_buffer(bh);
+                discard_in_page(bh);
+            }
+        }
+    }
+
+    /* discards page buffers which precede the newest gapless seqno
+     * sequence, history can't be served across a gap */
+    static void
+    trim_page_history(seqno2ptr_t& s2p)
+    {
+        if (s2p.empty()) return;
+
+        seqno2ptr_t::reverse_iterator r(s2p.rbegin());
+        seqno_t const seqno_max(r->first);
+        seqno_t       seqno_min(seqno_max);
+
+        for (++r; r != s2p.rend() && r->first + 1 == seqno_min; ++r)
+        {
+            seqno_min = r->first;
+        }
+
+        if (r == s2p.rend()) return;
+
+        log_info << "Recovering GCache page store: found gapless sequence "
+                 << seqno_min << '-' << seqno_max << ", discarding seqnos "
+                 << s2p.begin()->first << '-' << r->first;
+
+        seqno2ptr_t::iterator const i_min(s2p.find(seqno_min));
+        empty_page_buffers(s2p.begin(), i_min);
+        s2p.erase(s2p.begin(), i_min);
+    }
+
     /* discard all seqnos preceeding and including seqno */
     bool
     RingBuffer::discard_seqnos(seqno2ptr_t::iterator const i_begin,
@@ -113,9 +219,10 @@ namespace gcache
             seqno2ptr_t::iterator j(i); ++i;
             BufferHeader* const bh (ptr2BH (j->second));
 
-            if (gu_likely (BH_is_released(bh)))
+            if (gu_likely (released(bh)))
             {
                 seqno2ptr_.erase (j);
+                if (!BH_is_released(bh)) BH_release(bh);
                 empty_buffer(bh);
 
                 switch (bh->store)
@@ -127,13 +234,7 @@ namespace gcache
                     ms->discard(bh);
                     break;
                 }
-                case BUFFER_IN_PAGE:
-                {
-                    Page*      const page (static_cast<Page*>(bh->ctx));
-                    PageStore* const ps   (PageStore::page_store(page));
-                    ps->discard(bh);
-                    break;
-                }
+                case BUFFER_IN_PAGE: discard_in_page(bh); break;
                 default:
                     log_fatal << "Corrupt buffer header: " << bh;
                     abort();
@@ -192,7 +293,7 @@ namespace gcache
             // try to discard first buffer to get more space
             BufferHeader* bh = BH_cast(first_);
 
-            if (!BH_is_released(bh) /* true also when first_ == next_ */ ||
+            if (!released(bh) /* true also when first_ == next_ */ ||
                 (bh->seqno_g > 0 && !discard_seqno (bh->seqno_g)))
             {
                 // can't free any more space, so no buffer, next_ is unchanged
@@ -267,6 +368,8 @@ namespace gcache
         bh->store   = BUFFER_IN_RB;
         bh->ctx     = this;
 
+        if (ret < next_) wraps_++;
+
         next_ = ret + size;
 
         size_t max_used=
@@ -314,8 +417,12 @@ namespace gcache
     {
         assert(BH_is_released(bh));
 
-        assert(size_used_ >= bh->size);
-        size_used_ -= bh->size;
+        /* buffers up to seqno_released_ were accounted in seqno_release() */
+        if (bh->seqno_g > seqno_released_ || SEQNO_NONE == bh->seqno_g)
+        {
+            assert(size_used_ >= bh->size);
+            size_used_ -= bh->size;
+        }
 
         if (SEQNO_NONE == bh->seqno_g)
         {
@@ -324,6 +431,70 @@ namespace gcache
         }
     }
 
+    void
+    RingBuffer::seqno_assigned (seqno_t const seqno,
+                                const BufferHeader* const bh)
+    {
+        assert(seqno > 0);
+
+        size_t const size(BUFFER_IN_RB == bh->store ? bh->size : 0);
+
+        if (gu_unlikely(seqno <= seqno_released_))
+        {
+            /* released already */
+            assert(size_used_ >= size);
+            size_used_ -= size;
+            return;
+        }
+
+        size_assigned_ += size;
+
+        if (gu_likely(seqno2size_.empty() ||
+                      seqno2size_.rbegin()->first < seqno))
+        {
+            seqno2size_.insert(seqno2size_t::value_type(seqno,size_assigned_));
+        }
+        else
+        {
+            /* out of order: account it at the last seqno, so that it is
+             * not released before itself */
+            seqno_t const last(seqno2size_.rbegin()->first);
+            seqno2size_.erase(seqno2size_.find(last));
+            seqno2size_.insert(seqno2size_t::value_type(last, size_assigned_));
+        }
+    }
+
+    void
+    RingBuffer::seqno_release (seqno_t const seqno)
+    {
+        if (gu_likely(seqno >= seqno_released_))
+        {
+            seqno2size_t::iterator i(seqno2size_.upper_bound(seqno));
+
+            if (i != seqno2size_.begin())
+            {
+                size_t const total((--i)->second);
+
+                assert(total >= size_released_);
+                assert(size_used_ >= total - size_released_);
+                size_used_    -= total - size_released_;
+                size_released_ = total;
+
+                seqno2size_.erase(seqno2size_.begin(), ++i);
+            }
+        }
+        else
+        {
+            /* history above seqno was discarded, all of it was released */
+            assert(size_assigned_ == size_released_);
+            seqno2size_.clear();
+            size_assigned_ = size_released_;
+        }
+
+        seqno_released_ = seqno;
+        assert_size_free();
+    }
+
     void*
     RingBuffer::realloc (void* ptr, size_type const size)
     {
@@ -420,7 +591,11 @@ namespace gcache
     {
         write_preamble(false);
 
-        if (size_cache_ == size_free_) return;
+        if (size_cache_ == size_free_)
+        {
+            seqno_release_reset();
+            return;
+        }
 
         /* Find the last seqno'd RB buffer. It is likely to be close to the
          * end of released buffers chain. */
@@ -433,7 +608,7 @@ namespace gcache
             if (BUFFER_IN_RB == b->store)
             {
 #ifndef NDEBUG
-                if (!BH_is_released(b))
+                if (!released(b))
                 {
                     log_fatal << "Buffer "
                               << reinterpret_cast<const void*>(r->second)
@@ -447,10 +622,14 @@ namespace gcache
             }
         }
 
-        if (!bh) return; /* no seqno'd buffers in RB */
+        if (!bh) /* no seqno'd buffers in RB */
+        {
+            seqno_release_reset();
+            return;
+        }
 
         assert(bh->size > 0);
-        assert(BH_is_released(bh));
+        assert(released(bh));
 
         /* Seek the first unreleased buffer.
          * This should be called in isolation, when all seqno'd buffers are
@@ -462,7 +641,7 @@ namespace gcache
         assert (0 == size_trail_ || first_ > next_);
         first_ = reinterpret_cast<uint8_t*>(bh);
 
-        while (BH_is_released(bh)) // next_ is never released - no endless loop
+        while (released(bh)) // next_ is never released - no endless loop
         {
              first_ = reinterpret_cast<uint8_t*>(BH_next(bh));
 
@@ -489,7 +668,7 @@ namespace gcache
         assert ((BH_cast(first_))->size > 0);
         assert (first_ != next_);
         assert ((BH_cast(first_))->seqno_g == SEQNO_NONE);
-        assert (!BH_is_released(BH_cast(first_)));
+        assert (!released(BH_cast(first_)));
 
         estimate_space();
 
@@ -517,14 +696,15 @@ namespace gcache
                 if (bh->seqno_g != SEQNO_NONE)
                 {
                     // either released or already discarded buffer
-                    assert (BH_is_released(bh));
+                    assert (released(bh));
+                    if (!BH_is_released(bh)) BH_release(bh);
                     empty_buffer(bh);
                     discard (bh);
                     locked++;
                 }
                 else
                 {
-                    assert(!BH_is_released(bh));
+                    assert(!released(bh));
                 }
 
                 bh = BH_next(bh);
@@ -540,6 +720,7 @@ namespace gcache
                  << locked << '/' << total << " locked buffers";
 
         assert_sizes();
+        seqno_release_reset();
 
         if (next_ > first_ && first_ > start_) BH_clear(BH_cast(start_));
         /* this is needed to avoid rescanning from start_ on recovery */
@@ -568,6 +749,7 @@ namespace gcache
     std::string const RingBuffer::PR_KEY_SEQNO_MIN = "seqno_min:";
     std::string const RingBuffer::PR_KEY_OFFSET    = "offset:";
     std::string const RingBuffer::PR_KEY_SYNCED    = "synced:";
+    std::string const RingBuffer::PR_KEY_INDEX     = "index:";
 
     void
     RingBuffer::write_preamble(bool const synced)
@@ -590,6 +772,9 @@ namespace gcache
                    << seqno2ptr_.rbegin()->first << '\n';
 
                 os << PR_KEY_OFFSET << ' ' << first_ - preamble << '\n';
+
+                if (index_hash_)
+                    os << PR_KEY_INDEX << ' ' << index_hash_ << '\n';
             }
             else
             {
@@ -612,7 +797,7 @@ namespace gcache
     }
 
     void
-    RingBuffer::open_preamble(bool const do_recover)
+    RingBuffer::open_preamble(bool do_recover)
     {
         int version(0); // used only for recovery on upgrade
         uint8_t* const preamble(reinterpret_cast<uint8_t*>(preamble_));
@@ -620,6 +805,11 @@ namespace gcache
         long long seqno_min(SEQNO_ILL);
         off_t offset(-1);
         bool  synced(false);
+        unsigned long long index(0);
+        /* history of buffers recovered from page store, if any */
+        gu::UUID const pages_gid(gid_);
+
+        gid_ = gu::UUID(); // unknown unless found in the preamble
 
         {
             std::istringstream iss(preamble_);
@@ -642,6 +832,7 @@ namespace gcache
                 else if (PR_KEY_SEQNO_MIN == key) istr >> seqno_min;
                 else if (PR_KEY_OFFSET    == key) istr >> offset;
                 else if (PR_KEY_SYNCED    == key) istr >> synced;
+                else if (PR_KEY_INDEX     == key) istr >> index;
             }
         }
 
@@ -661,6 +852,27 @@ namespace gcache
            offset = -1;
         }
 
+        if (pages_gid != gu::UUID() && pages_gid != gid_)
+        {
+            if (gid_ != gu::UUID())
+            {
+                log_info << "Discarding GCache page buffers of history "
+                         << pages_gid << ": ring buffer history is " << gid_;
+
+                empty_page_buffers(seqno2ptr_.begin(), seqno2ptr_.end());
+                seqno2ptr_.clear();
+            }
+            else
+            {
+                /* ring buffer history is unknown, nothing to recover in it,
+                 * but recovered page history must still be gapless as if
+                 * the ring buffer was scanned */
+                gid_ = pages_gid;
+                do_recover = false;
+                trim_page_history(seqno2ptr_);
+            }
+        }
+
         if (do_recover)
         {
             if (gid_ != gu::UUID())
@@ -670,7 +882,11 @@ namespace gcache
 
                 try
                 {
-                    recover(offset - (start_ - preamble), version);
+                    if (!(synced && index && VERSION == version &&
+                          recover_index(index)))
+                    {
+                        recover(offset - (start_ - preamble), version);
+                    }
                 }
                 catch (gu::Exception& e)
                 {
@@ -686,15 +902,129 @@ namespace gcache
             }
         }
 
+        /* the index becomes stale as soon as the buffer is written to */
+        remove_index();
+
         write_preamble(false);
     }
 
     void
     RingBuffer::close_preamble()
     {
+        try
+        {
+            index_hash_ = save_index_ ? write_index() : 0;
+        }
+        catch (gu::Exception& e)
+        {
+            log_warn << "Failed to write GCache ring buffer index: "
+                     << e.what();
+            index_hash_ = 0;
+            remove_index();
+        }
+
         write_preamble(true);
     }
 
+    /* accounts for a seqno'd buffer found by scan() */
+    void
+    RingBuffer::scan_seqno(BufferHeader* const bh, int64_t& seqno_max,
+                           size_t& collision_count, int64_t& erase_up_to)
+    {
+        int64_t const seqno_g(bh->seqno_g);
+
+        if (gu_likely(seqno_g > 0))
+        {
+            if (seqno_g > seqno_max) seqno_max = seqno_g;
+
+            /* map may already contain page buffers */
+            bool const append(seqno2ptr_.empty() ||
+                              seqno2ptr_.rbegin()->first < seqno_g);
+
+            const std::pair<seqno2ptr_iter_t, bool>& res(
+                append ?
+                std::pair<seqno2ptr_iter_t, bool>(
+                    seqno2ptr_.insert(seqno2ptr_.end(),
+                                      seqno2ptr_pair_t(seqno_g, bh + 1)),
+                    true) :
+                seqno2ptr_.insert(seqno2ptr_pair_t(seqno_g, bh + 1))
+                );
+
+            if (gu_unlikely (false == res.second))
+            {
+                collision_count++;
+
+                /* compare two buffers */
+                const void* const old_ptr(res.first->second);
+                BufferHeader* const old_bh
+                    (old_ptr ? ptr2BH(old_ptr) : NULL);
+
+                bool const same_meta(NULL != old_bh &&
+                    bh->seqno_g == old_bh->seqno_g  &&
+                    bh->size    == old_bh->size     &&
+                    bh->flags   == old_bh->flags);
+
+                const void* const new_ptr(static_cast<void*>(bh+1));
+
+                uint8_t cs_old[16] = { 0, };
+                uint8_t cs_new[16] = { 0, };
+                if (same_meta)
+                {
+                    gu_fast_hash128(old_ptr,
+                                    old_bh->size - sizeof(BufferHeader),
+                                    cs_old);
+                    gu_fast_hash128(new_ptr,
+                                    bh->size - sizeof(BufferHeader),
+                                    cs_new);
+                }
+
+                bool const same_data(same_meta &&
+                                     !::memcmp(cs_old, cs_new,
+                                               sizeof(cs_old)));
+                std::ostringstream msg;
+
+                msg << "Attempt to reuse the same seqno: " << seqno_g
+                    << ". New ptr = " << new_ptr << ", " << bh
+                    << ", cs: " << gu::Hexdump(cs_new, sizeof(cs_new))
+                    << ", previous ptr = " << res.first->second;
+
+                empty_buffer(bh); // this buffer is unusable
+                assert(BH_is_released(bh));
+
+                if (old_bh != NULL)
+                {
+                    msg << ", " << old_bh << ", cs: "
+                        << gu::Hexdump(cs_old,sizeof(cs_old));
+
+                    if (!same_data) // no way to choose which is correct
+                    {
+                        empty_buffer(old_bh);
+                        if (BUFFER_IN_PAGE == old_bh->store)
+                            discard_in_page(old_bh);
+                        assert(BH_is_released(old_bh));
+                        seqno2ptr_.erase(res.first);
+                        /* the map can't hold invalid entries, but any
+                         * other buffer with this seqno is discarded
+                         * together with it in recover() */
+
+                        if (erase_up_to < seqno_g) erase_up_to = seqno_g;
+                    }
+                }
+
+                log_info << msg.str();
+
+                if (same_data) {
+                    log_info << "Contents are the same, discarding "
+                             << new_ptr;
+                } else {
+                    assert(seqno2ptr_.find(seqno_g) ==
+                           seqno2ptr_.end());
+                    log_info << "Contents differ. Discarding both.";
+                }
+            }
+        }
+    }
+
     int64_t
     RingBuffer::scan(off_t const offset, int const scan_step)
     {
@@ -720,6 +1050,10 @@ namespace gcache
                 segment_scans = 1;
         }
 
+        /* buffer chains found by threads in parallel, if any */
+        ScanRegions regions;
+        scan_regions(regions, scan_step);
+
         gu::Progress<ptrdiff_t> progress("GCache::RingBuffer initial scan",
                                          " bytes", end_ - start_, 1<<22 /*4Mb*/);
 
@@ -739,92 +1073,36 @@ namespace gcache
             {
                 assert((uintptr_t(bh) % scan_step) == 0);
 
-                bh->flags |= BUFFER_RELEASED;
-                bh->ctx    = this;
-
-                int64_t const seqno_g(bh->seqno_g);
+                ScanRegion* const r(scan_adopt(regions, ptr, segment_end));
 
-                if (gu_likely(seqno_g > 0))
+                if (r)
                 {
-                    const std::pair<seqno2ptr_iter_t, bool>& res(
-                        seqno_g > seqno_max ? seqno_max = seqno_g,
-                        std::pair<seqno2ptr_iter_t, bool>(
-                            seqno2ptr_.insert(seqno2ptr_.end(),
-                                              seqno2ptr_pair_t(seqno_g, bh + 1)),
-                            true) :
-                        seqno2ptr_.insert(seqno2ptr_pair_t(seqno_g, bh + 1))
-                        );
-
-                    if (gu_unlikely (false == res.second))
+                    /* the chain has joined the one found by the region scan,
+                     * take the region result and skip to its end. Seqno'd
+                     * buffers are marked right away as below, scan_mark()
+                     * comes too late for scan_seqno(). */
+                    for (size_t i(0); i < r->seqnos.size(); ++i)
                     {
-                        collision_count++;
-
-                        /* compare two buffers */
-                        const void* const old_ptr(res.first->second);
-                        BufferHeader* const old_bh
-                            (old_ptr ? ptr2BH(old_ptr) : NULL);
-
-                        bool const same_meta(NULL != old_bh &&
-                            bh->seqno_g == old_bh->seqno_g  &&
-                            bh->size    == old_bh->size     &&
-                            bh->flags   == old_bh->flags);
-
-                        const void* const new_ptr(static_cast<void*>(bh+1));
-
-                        uint8_t cs_old[16] = { 0, };
-                        uint8_t cs_new[16] = { 0, };
-                        if (same_meta)
-                        {
-                            gu_fast_hash128(old_ptr,
-                                            old_bh->size - sizeof(BufferHeader),
-                                            cs_old);
-                            gu_fast_hash128(new_ptr,
-                                            bh->size - sizeof(BufferHeader),
-                                            cs_new);
-                        }
-
-                        bool const same_data(same_meta &&
-                                             !::memcmp(cs_old, cs_new,
-                                                       sizeof(cs_old)));
-                        std::ostringstream msg;
-
-                        msg << "Attempt to reuse the same seqno: " << seqno_g
-                            << ". New ptr = " << new_ptr << ", " << bh
-                            << ", cs: " << gu::Hexdump(cs_new, sizeof(cs_new))
-                            << ", previous ptr = " << res.first->second;
-
-                        empty_buffer(bh); // this buffer is unusable
-                        assert(BH_is_released(bh));
-
-                        if (old_bh != NULL)
-                        {
-                            msg << ", " << old_bh << ", cs: "
-                                << gu::Hexdump(cs_old,sizeof(cs_old));
-
-                            if (!same_data) // no way to choose which is correct
-                            {
-                                empty_buffer(old_bh);
-                                assert(BH_is_released(old_bh));
-                                res.first->second = NULL;
-                                /* mark entry as invalid, but don't remove from
-                                 * the map to block this seqno */
-
-                                if (erase_up_to < seqno_g) erase_up_to = seqno_g;
-                            }
-                        }
-
-                        log_info << msg.str();
-
-                        if (same_data) {
-                            log_info << "Contents are the same, discarding "
-                                     << new_ptr;
-                        } else {
-                            assert(NULL == res.first->second);
-                            log_info << "Contents differ. Discarding both.";
-                        }
+                        BufferHeader* const sbh(r->seqnos[i]);
+
+                        sbh->flags |= BUFFER_RELEASED;
+                        sbh->ctx    = this;
+
+                        scan_seqno(sbh, seqno_max, collision_count,
+                                   erase_up_to);
                     }
+
+                    progress.update(r->stop - ptr);
+                    ptr = r->stop;
+                    bh = BH_cast(ptr);
+                    continue;
                 }
 
+                bh->flags |= BUFFER_RELEASED;
+                bh->ctx    = this;
+
+                scan_seqno(bh, seqno_max, collision_count, erase_up_to);
+
                 progress.update(bh->size);
                 ptr += bh->size;
                 bh = BH_cast(ptr);
@@ -913,6 +1191,8 @@ namespace gcache
 #undef GCACHE_SCAN_BUFFER_TEST
         } // while (segment_scans < 2)
 
+        scan_mark(regions);
+
         progress.finish();
 
         return erase_up_to;
@@ -943,9 +1223,9 @@ namespace gcache
                 /* not all seqnos present */)
             {
                 /* need to search for seqno gaps */
-                assert(seqno_max >= lower);
-                if (lower == seqno_max)
+                if (lower >= seqno_max)
                 {
+                    empty_page_buffers(seqno2ptr_.begin(), seqno2ptr_.end());
                     seqno2ptr_.clear();
                     goto full_reset;
                 }
@@ -976,14 +1256,32 @@ namespace gcache
                          << seqno2ptr_.begin()->first << '-' << r->first;
 
                 /* clear up seqno2ptr map */
+                seqno2ptr_t::iterator const i_min(seqno2ptr_.find(seqno_min));
+                empty_page_buffers(seqno2ptr_.begin(), i_min);
                 for (; r != seqno2ptr_.rend(); ++r)
                 {
                     if (r->second) empty_buffer(ptr2BH(r->second));
                 }
-                seqno2ptr_.erase(seqno2ptr_.begin(), seqno2ptr_.find(seqno_min));
+                seqno2ptr_.erase(seqno2ptr_.begin(), i_min);
             }
             assert(seqno2ptr_.size() > 0);
 
+            /* the last seqno'd buffer in the ring buffer, the rest of the
+             * history may be stored in pages */
+            BufferHeader* last_rb(NULL);
+            for (r = seqno2ptr_.rbegin(); r != seqno2ptr_.rend(); ++r)
+            {
+                BufferHeader* const b(ptr2BH(r->second));
+                if (BUFFER_IN_RB == b->store) { last_rb = b; break; }
+            }
+
+            if (NULL == last_rb)
+            {
+                log_info << diag_prefix << "no events in the ring buffer.";
+                reset();
+                return;
+            }
+
             /* trim first_: start with the current first_ and scan forward to
              * the first non-empty buffer. */
             BufferHeader* bh(BH_cast(first_));
@@ -1000,7 +1298,7 @@ namespace gcache
 
             /* trim next_: start with the last seqno and scan forward up to the
              * current next_. Update to the end of the last non-empty buffer. */
-            bh = ptr2BH(seqno2ptr_[seqno_max]);
+            bh = last_rb;
             BufferHeader* last_bh(bh);
             while (bh != BH_cast(next_))
             {
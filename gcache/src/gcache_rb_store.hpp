@@ -16,6 +16,9 @@
 #include <gu_uuid.hpp>
 
 #include <string>
+#include <vector>
+
+#include <pthread.h>
 
 namespace gcache
 {
@@ -23,11 +26,21 @@ namespace gcache
     {
     public:
 
+        /* memory mapping options, see gu::MMap */
+        enum
+        {
+            MMAP_HUGEPAGES = 1 << 0,
+            MMAP_POPULATE  = 1 << 1,
+            MMAP_LOCK      = 1 << 2
+        };
+
         RingBuffer (const std::string& name,
                     size_t             size,
                     seqno2ptr_t&       seqno2ptr,
                     gu::UUID&          gid,
-                    bool               recover);
+                    bool               recover,
+                    int                mmap_opts = 0,
+                    int                scan_threads = 0);
 
         ~RingBuffer ();
 
@@ -39,7 +52,7 @@ namespace gcache
 
         void  discard (BufferHeader* const bh)
         {
-            assert (BH_is_released(bh));
+            assert (released(bh));
             assert (SEQNO_ILL == bh->seqno_g);
             size_free_ += bh->size;
             assert (size_free_ <= size_cache_);
@@ -49,12 +62,42 @@ namespace gcache
 
         size_t rb_size   () const { return fd_.size(); }
 
+        size_t    size_free () const { return size_free_;  }
+        size_t    size_used () const { return size_used_;  }
+        size_t    size_trail() const { return size_trail_; }
+
+        /* number of times allocation went back to the start */
+        long long wraps     () const { return wraps_;      }
+
         const std::string& rb_name() const { return fd_.name(); }
 
+        /* descriptor of the ring buffer file and offset of ptr in it */
+        int   rb_fd() const { return fd_.get(); }
+        off_t rb_offset(const void* ptr) const
+        {
+            return (static_cast<const uint8_t*>(ptr) -
+                    static_cast<const uint8_t*>(mmap_.ptr));
+        }
+
         void  reset();
 
         void  seqno_reset();
 
+        /* accounts for a buffer (in any store) which was assigned seqno */
+        void  seqno_assigned (seqno_t seqno, const BufferHeader* bh);
+
+        /* releases all ordered buffers up to and including seqno at once:
+         * their headers are not touched, they are treated as released by
+         * released() and get marked as such only when discarded.
+         * Moving seqno back means that history above it was discarded. */
+        void  seqno_release (seqno_t seqno);
+
+        bool  released (const BufferHeader* const bh) const
+        {
+            return (BH_is_released(bh) ||
+                    (bh->seqno_g > 0 && bh->seqno_g <= seqno_released_));
+        }
+
         /* returns true when successfully discards all seqnos in range */
         bool  discard_seqnos(seqno2ptr_t::iterator i_begin,
                              seqno2ptr_t::iterator i_end);
@@ -113,6 +156,16 @@ namespace gcache
 
         size_t allocated_pool_size ();
 
+        bool   mmap_stats (gu::MMap::Stats& st) const
+        {
+            return mmap_.stats(st);
+        }
+
+        bool   mmap_resident (size_t& bytes) const
+        {
+            return mmap_.resident(bytes);
+        }
+
         void set_freeze_purge_at_seqno(seqno_t seqno)
         {
             freeze_purge_at_seqno_ = seqno;
@@ -153,13 +206,39 @@ namespace gcache
         size_t             size_free_;
         size_t             size_used_;
         size_t             size_trail_;
+        long long          wraps_;
+
+        /* size_used_ accounting for bulk release: running total of sizes of
+         * RB buffers with assigned seqnos and its value at every seqno.
+         * Totals start with 1 since 0 marks a missing entry in the map. */
+        typedef gu::DeqMap<seqno_t, size_t> seqno2size_t;
+        seqno2size_t       seqno2size_;
+        size_t             size_assigned_;
+        size_t             size_released_;
+        seqno_t            seqno_released_;
 
         bool               open_;
 
+        /* checksum of the seqno index written on close, 0 if none */
+        uint64_t           index_hash_;
+        bool         const save_index_; /* only if recovery is enabled */
+
+        /* number of threads for recovery scan, 0 - automatic */
+        int          const scan_threads_;
+
         BufferHeader* get_new_buffer (size_type size);
 
+        void          seqno_release_reset()
+        {
+            seqno2size_.clear();
+            size_assigned_  = size_released_ = 1;
+            seqno_released_ = SEQNO_NONE;
+        }
+
         void          constructor_common();
 
+        void          mmap_setup(int opts);
+
         /* preamble fields */
         static std::string const PR_KEY_VERSION;
         static std::string const PR_KEY_GID;
@@ -167,6 +246,7 @@ namespace gcache
         static std::string const PR_KEY_SEQNO_MIN;
         static std::string const PR_KEY_OFFSET;
         static std::string const PR_KEY_SYNCED;
+        static std::string const PR_KEY_INDEX;
 
         void          write_preamble(bool synced);
         void          open_preamble(bool recover);
@@ -174,8 +254,74 @@ namespace gcache
 
         // returns lower bound (not inclusive) of valid seqno range
         int64_t       scan(off_t offset, int scan_step);
+        void          scan_seqno(BufferHeader* bh, int64_t& seqno_max,
+                                 size_t& collision_count,
+                                 int64_t& erase_up_to);
+
+        /* Parallel part of scan(), see gcache_rb_scan.cpp: the buffer is
+         * split into regions and every region is scanned by a thread
+         * starting from the first place which looks like a chain of buffer
+         * headers. scan() then takes the result of a region whole if its
+         * own walk over the buffer chain arrives at the same header. */
+        struct ScanRegion
+        {
+            ScanRegion() : rb(NULL), begin(NULL), end(NULL), step(0),
+                           sync(NULL), stop(NULL), seqnos(), adopted(false),
+                           thr(), joinable(false) {}
+
+            // regions are kept by value in ScanRegions
+            ScanRegion(const ScanRegion& r)
+                : rb(r.rb), begin(r.begin), end(r.end), step(r.step),
+                  sync(r.sync), stop(r.stop), seqnos(r.seqnos),
+                  adopted(r.adopted), thr(r.thr), joinable(r.joinable) {}
+
+            ScanRegion& operator=(const ScanRegion& r)
+            {
+                rb       = r.rb;
+                begin    = r.begin;
+                end      = r.end;
+                step     = r.step;
+                sync     = r.sync;
+                stop     = r.stop;
+                seqnos   = r.seqnos;
+                adopted  = r.adopted;
+                thr      = r.thr;
+                joinable = r.joinable;
+                return *this;
+            }
+
+            RingBuffer*                rb;
+            uint8_t*                   begin;
+            uint8_t*                   end;
+            int                        step;
+            uint8_t*                   sync;  // first header, NULL if none
+            uint8_t*                   stop;  // end of the chain from sync
+            std::vector<BufferHeader*> seqnos;// seqno'd buffers in the chain
+            bool                       adopted;
+            pthread_t                  thr;
+            bool                       joinable;
+        };
+
+        typedef std::vector<ScanRegion> ScanRegions;
+
+        void          scan_regions(ScanRegions& regions, int step);
+        ScanRegion*   scan_adopt  (ScanRegions& regions, const uint8_t* ptr,
+                                   const uint8_t* segment_end);
+        void          scan_mark   (ScanRegions& regions);
+        static void*  scan_region_thread(void* arg);
+        static void*  mark_region_thread(void* arg);
+
         void          recover(off_t offset, int version);
 
+        /* Seqno index: offsets of all seqno'd buffers saved on close to a
+         * file next to the ring buffer, so that graceful restart does not
+         * need to scan the whole buffer. Trusted only if its checksum
+         * matches the one in the synced preamble. */
+        std::string   index_name() const { return fd_.name() + ".index"; }
+        uint64_t      write_index();   // returns index checksum, 0 if none
+        bool          recover_index(uint64_t hash);
+        void          remove_index() const;
+
         void          estimate_space();
 
         RingBuffer(const gcache::RingBuffer&);
@@ -1,18 +1,19 @@
 /*
- * Copyright (C) 2016 Codership Oy <info@codership.com>
+ * Copyright (C) 2016-2018 Codership Oy <info@codership.com>
  */
 
 #ifndef __GCACHE_TYPES__
 #define __GCACHE_TYPES__
 
 #include "gcache_seqno.hpp"
-#include <map>
+#include <gu_deqmap.hpp>
 
 namespace gcache
 {
-    typedef std::map<seqno_t, const void*>  seqno2ptr_t;
-    typedef seqno2ptr_t::iterator           seqno2ptr_iter_t;
-    typedef std::pair<seqno_t, const void*> seqno2ptr_pair_t;
+    /* seqnos are dense and mostly ordered, see gu_deqmap.hpp */
+    typedef gu::DeqMap<seqno_t, const void*> seqno2ptr_t;
+    typedef seqno2ptr_t::iterator            seqno2ptr_iter_t;
+    typedef seqno2ptr_t::value_type          seqno2ptr_pair_t;
 
 } /* namespace gcache */
 
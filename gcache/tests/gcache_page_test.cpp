@@ -8,6 +8,11 @@
 #include "gcache_bh.hpp"
 #include "gcache_page_test.hpp"
 
+#include <iomanip>
+#include <sstream>
+
+#include <unistd.h>
+
 using namespace gcache;
 
 void ps_free (void* ptr)
@@ -24,7 +29,9 @@ START_TEST(test1)
     ssize_t const keep_size = 1;
     ssize_t const page_size = 2 + bh_size;
 
-    gcache::PageStore ps (dir_name, keep_size, page_size, false);
+    seqno2ptr_t s2p;
+    gu::UUID    gid;
+    gcache::PageStore ps (dir_name, keep_size, page_size, false, s2p, gid);
 
     fail_if(ps.count()       != 0,"expected count 0, got %zu",ps.count());
     fail_if(ps.total_pages() != 0,"expected 0 pages, got %zu",ps.total_pages());
@@ -65,7 +72,9 @@ START_TEST(test2)
     ssize_t const keep_size = 1;
     ssize_t page_size = (1 << 20) + bh_size;
 
-    gcache::PageStore ps (dir_name, keep_size, page_size, false);
+    seqno2ptr_t s2p;
+    gu::UUID    gid;
+    gcache::PageStore ps (dir_name, keep_size, page_size, false, s2p, gid);
 
     mark_point();
 
@@ -91,7 +100,9 @@ START_TEST(test3) // check that all page size is efficiently used
     ssize_t const keep_size = 1;
     ssize_t const page_size = 1024;
 
-    gcache::PageStore ps (dir_name, keep_size, page_size, false);
+    seqno2ptr_t s2p;
+    gu::UUID    gid;
+    gcache::PageStore ps (dir_name, keep_size, page_size, false, s2p, gid);
 
     mark_point();
 
@@ -115,6 +126,125 @@ START_TEST(test3) // check that all page size is efficiently used
 }
 END_TEST
 
+START_TEST(test4) // check that released buffers survive PageStore restart
+{
+    const char* const dir_name = "";
+    ssize_t const page_size = 1024;
+    ssize_t const buf_size  = 128;
+
+    gu::UUID    gid(NULL, 0);
+    seqno2ptr_t s2p;
+
+    {
+        gcache::PageStore ps (dir_name, 0, page_size, 0, s2p, gid, true);
+
+        for (seqno_t s(1); s <= 3; ++s)
+        {
+            void* const ptr(ps.malloc (buf_size));
+            fail_if (0 == ptr);
+
+            BufferHeader* const bh(ptr2BH(ptr));
+            bh->seqno_g = s;
+            BH_release (bh);
+        }
+
+        fail_if (ps.total_pages() != 1);
+    }
+
+    gu::UUID    rgid;
+    seqno2ptr_t rs2p;
+
+    gcache::PageStore ps (dir_name, 0, page_size, 0, rs2p, rgid, true);
+
+    fail_if (rgid != gid);
+    fail_if (ps.total_pages() != 1, "expected 1 page, got %zu",
+             ps.total_pages());
+    fail_if (rs2p.size() != 3, "expected 3 buffers, got %zu", rs2p.size());
+
+    seqno_t s(1);
+    for (seqno2ptr_t::iterator i(rs2p.begin()); i != rs2p.end(); ++i, ++s)
+    {
+        BufferHeader* const bh(ptr2BH(i->second));
+
+        fail_if (i->first != s);
+        fail_if (bh->seqno_g != s);
+        fail_if (bh->size != buf_size);
+        fail_if (!BH_is_released(bh));
+        fail_if (bh->store != BUFFER_IN_PAGE);
+
+        bh->seqno_g = SEQNO_ILL;
+        ps.discard (bh);
+    }
+
+    fail_if (ps.total_pages() != 0, "expected 0 pages, got %zu",
+             ps.total_pages());
+}
+END_TEST
+
+static void wait_reserved(gcache::PageStore& ps, size_t const n)
+{
+    for (int i(0); ps.reserved() < n && i < 1000; ++i) usleep(10000);
+    fail_if (ps.reserved() != n, "expected %zu reserved pages, got %zu", n,
+             ps.reserved());
+}
+
+START_TEST(test5) // page pre-allocation
+{
+    const char* const dir_name = "";
+    ssize_t const page_size = 1024;
+    ssize_t const buf_size  = 600;
+
+    seqno2ptr_t s2p;
+    gu::UUID    gid(NULL, 0);
+
+    {
+        gcache::PageStore ps (dir_name, 0, page_size, 0, s2p, gid, false, 1);
+
+        /* nothing is reserved until the store is used */
+        usleep(100000);
+        fail_if (ps.reserved() != 0);
+        fail_if (ps.count()    != 0);
+
+        void* const ptr1(ps.malloc (buf_size));
+        fail_if (0 == ptr1);
+        wait_reserved(ps, 1);
+        fail_if (ps.count() != 2, "expected count 2, got %zu", ps.count());
+        fail_if (ps.total_pages() != 1);
+
+        /* next page comes from the reserve and is a new history page */
+        void* const ptr2(ps.malloc (buf_size));
+        fail_if (0 == ptr2);
+        fail_if (ps.total_pages() != 2);
+        fail_if (0 != access("gcache.page.000001", F_OK));
+        wait_reserved(ps, 1);
+        fail_if (ps.count() != 3, "expected count 3, got %zu", ps.count());
+
+        /* reserved page is too small: dropped, the page is created inline */
+        void* const ptr3(ps.malloc (page_size * 2));
+        fail_if (0 == ptr3);
+        fail_if (ps.total_pages() != 3);
+        fail_if (0 != access("gcache.page.000003", F_OK));
+        wait_reserved(ps, 1);
+
+        ps_free(ptr1); ps.discard(ptr2BH(ptr1));
+        ps_free(ptr2); ps.discard(ptr2BH(ptr2));
+        ps_free(ptr3); ps.discard(ptr2BH(ptr3));
+
+        fail_if (ps.total_pages() != 0);
+    }
+
+    /* reserved pages are removed on shutdown */
+    usleep(100000);
+    for (size_t i(0); i < 5; ++i)
+    {
+        std::ostringstream os;
+        os << "gcache.page." << std::setfill('0') << std::setw(6) << i;
+        fail_if (0 == access(os.str().c_str(), F_OK), "%s still exists",
+                 os.str().c_str());
+    }
+}
+END_TEST
+
 Suite* gcache_page_suite()
 {
     Suite* s = suite_create("gcache::PageStore");
@@ -124,6 +254,8 @@ Suite* gcache_page_suite()
     tcase_add_test(tc, test1);
     tcase_add_test(tc, test2);
     tcase_add_test(tc, test3);
+    tcase_add_test(tc, test4);
+    tcase_add_test(tc, test5);
     suite_add_tcase(s, tc);
 
     return s;
@@ -13,6 +13,11 @@
 #include <gu_logger.hpp>
 #include <gu_throw.hpp>
 
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <unistd.h>
+
 using namespace gcache;
 
 static gu::UUID    const GID(NULL, 0);
@@ -32,7 +37,7 @@ START_TEST(test1)
 
     size_t const rb_size(ALLOC_SIZE(2) * 2);
 
-    std::map<int64_t, const void*> s2p;
+    seqno2ptr_t s2p;
     gu::UUID   gid(GID);
     RingBuffer rb(RB_NAME, rb_size, s2p, gid, false);
 
@@ -116,6 +121,12 @@ START_TEST(test1)
     tmp = rb.malloc (ALLOC_SIZE(2));
     fail_if (NULL == tmp);
 
+    /* buffer must be readable from the file at the reported offset */
+    ::memcpy(tmp, "rb", 2);
+    char rbuf[2] = { 0, };
+    fail_if (::pread(rb.rb_fd(), rbuf, sizeof(rbuf), rb.rb_offset(tmp)) != 2);
+    fail_if (::memcmp(rbuf, "rb", sizeof(rbuf)));
+
     mark_point();
 }
 END_TEST
@@ -505,6 +516,262 @@ START_TEST(recovery)
     }
 
     ::unlink(RB_NAME.c_str());
+    ::unlink((RB_NAME + ".index").c_str());
+}
+END_TEST
+
+
+START_TEST(recovery_index)
+{
+    std::string const IDX_NAME(RB_NAME + ".index");
+
+    ::unlink(RB_NAME.c_str());
+    ::unlink(IDX_NAME.c_str());
+
+    size_type const buf_size(ALLOC_SIZE(8));
+    size_t    const rb_size(buf_size * 8);
+
+    std::map<seqno_t, off_t> expected;
+    off_t next_offset(0);
+
+    {
+        /* no index without recovery */
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, false);
+
+        void* const ptr(rb.malloc(buf_size));
+        fail_if(NULL == ptr);
+        ptr2BH(ptr)->seqno_g = 1;
+        s2p.insert(seqno2ptr_pair_t(1, ptr));
+    }
+
+    fail_if(0 == ::access(IDX_NAME.c_str(), F_OK), "index was saved");
+    ::unlink(RB_NAME.c_str());
+
+    {
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, true);
+
+        /* seqnos are assigned out of order and there is an unordered buffer
+         * in the middle: |1|2|-|4|3|5|6|7|, then 8 and 9 roll over */
+        seqno_t const seqnos[] = { 1, 2, SEQNO_NONE, 4, 3, 5, 6, 7, 8, 9 };
+
+        for (size_t i(0); i < sizeof(seqnos)/sizeof(seqnos[0]); ++i)
+        {
+            void* const ptr(rb.malloc(buf_size));
+            fail_if(NULL == ptr, "malloc failed at %zu", i);
+
+            BufferHeader* const bh(ptr2BH(ptr));
+
+            if (seqnos[i] > 0)
+            {
+                bh->seqno_g = seqnos[i];
+                s2p.insert(seqno2ptr_pair_t(seqnos[i], ptr));
+                expected[seqnos[i]] = rb.rb_offset(ptr);
+            }
+
+            BH_release(bh);
+            rb.free(bh);
+
+            next_offset = rb.rb_offset(ptr) + buf_size;
+        }
+
+        fail_if(s2p.begin()->first == 1, "first buffer was not discarded");
+        for (seqno_t s(1); s < s2p.begin()->first; ++s) expected.erase(s);
+        fail_if(expected.size() != s2p.size());
+    }
+
+    fail_if(::access(IDX_NAME.c_str(), F_OK), "index was not saved");
+
+    for (int corrupt(0); corrupt < 2; ++corrupt)
+    {
+        if (corrupt)
+        {
+            /* broken index must fall back to full scan with the same result */
+            FILE* const f(::fopen(IDX_NAME.c_str(), "r+"));
+            fail_if(NULL == f);
+            fail_if(::fseek(f, 70, SEEK_SET));
+            fail_if(EOF == ::fputc(0xff, f));
+            ::fclose(f);
+        }
+
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, true);
+
+        fail_if(0 == ::access(IDX_NAME.c_str(), F_OK),
+                "index was not removed on open");
+        fail_if(s2p.size() != expected.size(), "expected %zu seqnos, got %zu",
+                expected.size(), s2p.size());
+
+        for (std::map<seqno_t, off_t>::iterator i(expected.begin());
+             i != expected.end(); ++i)
+        {
+            seqno2ptr_t::iterator const f(s2p.find(i->first));
+            fail_if(f == s2p.end(), "seqno %lld not recovered",
+                    static_cast<long long>(i->first));
+            fail_if(rb.rb_offset(f->second) != i->second,
+                    "seqno %lld recovered at %lld, expected %lld",
+                    static_cast<long long>(i->first),
+                    static_cast<long long>(rb.rb_offset(f->second)),
+                    static_cast<long long>(i->second));
+            fail_if(!BH_is_released(ptr2BH(f->second)));
+        }
+
+        /* the next buffer must be allocated right after the last one */
+        void* const ptr(rb.malloc(buf_size));
+        fail_if(NULL == ptr);
+        fail_if(rb.rb_offset(ptr) != next_offset);
+        BH_release(ptr2BH(ptr));
+        rb.free(ptr2BH(ptr));
+
+        /* that could discard the oldest seqnos */
+        for (seqno_t s(expected.begin()->first); s < s2p.begin()->first; ++s)
+            expected.erase(s);
+    }
+
+    ::unlink(RB_NAME.c_str());
+    ::unlink(IDX_NAME.c_str());
+}
+END_TEST
+
+
+/* recovery scan split between threads must give the same result as a
+ * sequential one */
+START_TEST(recovery_parallel)
+{
+    std::string const IDX_NAME(RB_NAME + ".index");
+
+    ::unlink(RB_NAME.c_str());
+    ::unlink(IDX_NAME.c_str());
+
+    size_t const rb_size(1 << 20);
+    int    const threads(4);
+
+    std::map<seqno_t, off_t> expected;
+
+    {
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, false);
+
+        seqno_t  seqno(0);
+        uint32_t rnd(1);
+        bool     dup(false);
+
+        /* fill the buffer almost twice with buffers of various sizes,
+         * every 7th of them unordered. Ordered ones are released in bulk,
+         * so their headers are not marked released. */
+        for (size_t total(0); total < rb_size * 7 / 4; )
+        {
+            rnd = rnd * 1103515245 + 12345;
+            size_type const size(ALLOC_SIZE((rnd >> 16) % 4000 + 1));
+
+            void* const ptr(rb.malloc(size));
+            fail_if(NULL == ptr);
+            total += size;
+
+            BufferHeader* const bh(ptr2BH(ptr));
+
+            if ((rnd >> 8) % 7)
+            {
+                bh->seqno_g = ++seqno;
+                bh->seqno_d = seqno - 1;
+                s2p.insert(seqno2ptr_pair_t(seqno, ptr));
+                rb.seqno_assigned(seqno, bh);
+                rb.seqno_release(seqno);
+            }
+            else
+            {
+                BH_release(bh);
+                rb.free(bh);
+            }
+
+            if (!dup && bh->seqno_g > 0 && total > rb_size * 3 / 2)
+            {
+                /* a copy of the buffer with the same seqno in the part
+                 * which is not overwritten: recovery must keep one */
+                void* const copy(rb.malloc(size));
+                fail_if(NULL == copy);
+                total += size;
+
+                BufferHeader* const cbh(ptr2BH(copy));
+                fail_if(cbh->size != bh->size);
+                ::memcpy(copy, ptr, bh->size - sizeof(BufferHeader));
+                BH_release(cbh);
+                rb.free(cbh);
+                cbh->seqno_g = bh->seqno_g;
+                cbh->seqno_d = bh->seqno_d;
+
+                dup = true;
+            }
+        }
+
+        fail_if(!dup);
+
+        for (seqno2ptr_t::iterator i(s2p.begin()); i != s2p.end(); ++i)
+        {
+            expected[i->first] = rb.rb_offset(i->second);
+        }
+
+        fail_if(expected.size() < 100);
+        fail_if(expected.begin()->first == 1, "buffer did not roll over");
+    }
+
+    /* compare recovered map with the expected one */
+    struct check
+    {
+        static void map(const std::map<seqno_t, off_t>& e,
+                        const seqno2ptr_t& s2p, const RingBuffer& rb)
+        {
+            fail_if(s2p.size() != e.size(), "expected %zu seqnos, got %zu",
+                    e.size(), s2p.size());
+
+            for (std::map<seqno_t, off_t>::const_iterator i(e.begin());
+                 i != e.end(); ++i)
+            {
+                seqno2ptr_t::iterator const f(s2p.find(i->first));
+                fail_if(f == s2p.end(), "seqno %lld not recovered",
+                        static_cast<long long>(i->first));
+                fail_if(rb.rb_offset(f->second) != i->second);
+                fail_if(!BH_is_released(ptr2BH(f->second)));
+                fail_if(ptr2BH(f->second)->ctx != &rb);
+            }
+        }
+    };
+
+    /* known offset of the first buffer */
+    {
+        ::unlink(IDX_NAME.c_str());
+
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, true, 0, threads);
+
+        check::map(expected, s2p, rb);
+    }
+
+    /* unknown offset: open the file while it is still open */
+    {
+        ::unlink(IDX_NAME.c_str());
+
+        seqno2ptr_t s2p0;
+        gu::UUID    gid0(GID);
+        RingBuffer  rb0(RB_NAME, rb_size, s2p0, gid0, true, 0, 1);
+
+        check::map(expected, s2p0, rb0);
+
+        seqno2ptr_t s2p;
+        gu::UUID    gid(GID);
+        RingBuffer  rb(RB_NAME, rb_size, s2p, gid, true, 0, threads);
+
+        check::map(expected, s2p, rb);
+    }
+
+    ::unlink(RB_NAME.c_str());
+    ::unlink(IDX_NAME.c_str());
 }
 END_TEST
 
@@ -522,6 +789,8 @@ Suite* gcache_rb_suite()
 
     tcase_set_timeout(tc, 60);
     tcase_add_test(tc, recovery);
+    tcase_add_test(tc, recovery_index);
+    tcase_add_test(tc, recovery_parallel);
     suite_add_tcase(ts, tc);
 
     return ts;
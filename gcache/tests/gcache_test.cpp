@@ -0,0 +1,607 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+#include "GCache.hpp"
+#include "gcache_test.hpp"
+
+#include <gu_config.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace gcache;
+
+static const char* const RB_NAME = "gcache_test.cache";
+
+static void
+init_config (gu::Config& conf)
+{
+    GCache::register_params(conf);
+    conf.set("gcache.name", RB_NAME);
+    conf.set("gcache.size", "1M");
+}
+
+/* buffers freed with free() are queued and must not be freed again by
+ * seqno_release() */
+START_TEST(test_free_queue)
+{
+    gu::Config conf;
+    init_config(conf);
+
+    GCache* const gc(new GCache(conf, "."));
+
+    int64_t const n(100);
+
+    for (int64_t seqno(1); seqno <= n; ++seqno)
+    {
+        void* const ptr(gc->malloc(256));
+        fail_if(0 == ptr);
+
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+
+        if (seqno <= n/2) gc->free(ptr); // the rest is released below
+    }
+
+    fail_if(gc->seqno_min() != 1);
+
+    gc->seqno_release(n);
+
+    /* released buffers stay in history */
+    fail_if(gc->seqno_min() != 1);
+
+    std::vector<GCache::Buffer> v(n);
+    fail_if(size_t(n) != gc->seqno_get_buffers(v, 1));
+    fail_if(v[n - 1].seqno_g() != n);
+    gc->seqno_unlock();
+
+    /* every third seqno from 2 on, as an IST stripe reads them */
+    v.resize(n);
+    fail_if(size_t(n / 3) != gc->seqno_get_buffers(v, 2, 3));
+    for (int64_t i(0); i < n / 3; ++i) fail_if(v[i].seqno_g() != 2 + i * 3);
+    gc->seqno_prefetch(2, n / 3, 3);
+    gc->seqno_unlock();
+
+    /* more frees than FREE_BATCH without any allocation in between */
+    std::vector<void*> ptrs;
+    for (int i(0); i < 1000; ++i)
+    {
+        void* const ptr(gc->malloc(128));
+        fail_if(0 == ptr);
+        ptrs.push_back(ptr);
+    }
+
+    for (size_t i(0); i < ptrs.size(); ++i) gc->free(ptrs[i]);
+
+    fail_if(0 == gc->allocated_pool_size());
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+/* ordered buffers released in bulk must make room in the ring buffer */
+START_TEST(test_bulk_release)
+{
+    gu::Config conf;
+    init_config(conf);
+
+    GCache* const gc(new GCache(conf, "."));
+
+    int     rb_fd(-1);
+    int64_t const n(10000); // ~10 times the ring buffer size
+
+    for (int64_t seqno(1); seqno <= n; ++seqno)
+    {
+        void* const ptr(gc->malloc(1000));
+        fail_if(0 == ptr);
+
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+
+        int   fd;
+        off_t offset;
+        fail_if(!gc->seqno_file_location(ptr, fd, offset));
+
+        if (1 == seqno) rb_fd = fd;
+
+        fail_if(fd != rb_fd, "seqno %lld is not in the ring buffer",
+                static_cast<long long>(seqno));
+
+        if (0 == seqno % 100) gc->seqno_release(seqno);
+    }
+
+    gc->seqno_release(n);
+
+    int64_t const min(gc->seqno_min());
+    fail_if(min <= 1);
+
+    std::vector<GCache::Buffer> v(n - min + 1);
+    fail_if(v.size() != gc->seqno_get_buffers(v, min));
+    fail_if(v.back().seqno_g() != n);
+    gc->seqno_unlock();
+
+    /* written ring buffer is resident, residency comes from mincore() */
+    gu::MMap::Stats st;
+#ifdef __linux__
+    fail_if(!gc->rb_mmap_stats(st));
+    fail_if(0 == st.resident);
+    fail_if(0 != st.hugepages);
+#else
+    gc->rb_mmap_stats(st);
+#endif
+
+    /* history reset releases everything */
+    gc->seqno_reset(gu::UUID(), SEQNO_NONE);
+    fail_if(gc->seqno_min() != -1);
+
+    void* const ptr(gc->malloc(1000));
+    fail_if(0 == ptr);
+    gc->seqno_assign(ptr, 1, 0);
+    gc->seqno_release(1);
+    fail_if(gc->seqno_min() != 1);
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+/* prefaulted ring buffer must be resident */
+START_TEST(test_rb_mmap_opts)
+{
+    gu::Config conf;
+    init_config(conf);
+    conf.set("gcache.hugepages", "yes");
+    conf.set("gcache.populate", "yes");
+    conf.set("gcache.mlock", "yes"); // may fail with a warning
+
+    GCache* const gc(new GCache(conf, "."));
+
+    gu::MMap::Stats st;
+#ifdef __linux__
+    fail_if(!gc->rb_mmap_stats(st));
+    fail_if(st.resident < (1 << 20), "resident: %zu", st.resident);
+
+    /* smaps is not read again right away */
+    gu::MMap::Stats st2;
+    fail_if(!gc->rb_mmap_stats(st2));
+    fail_if(st2.resident != st.resident);
+#else
+    gc->rb_mmap_stats(st);
+#endif
+
+    try
+    {
+        gc->param_set("gcache.populate", "no");
+        fail("runtime change of gcache.populate did not throw");
+    }
+    catch (gu::Exception& e)
+    {
+        fail_if(e.get_errno() != EPERM);
+    }
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+static void*
+alloc_thread (void* arg)
+{
+    GCache* const gc(static_cast<GCache*>(arg));
+
+    for (int i(0); i < 10000; ++i)
+    {
+        void* const ptr(gc->malloc(1 + (i % 4000)));
+        if (0 == ptr) return arg;
+        static_cast<char*>(ptr)[0] = 'a';
+        gc->free(ptr);
+    }
+
+    return 0;
+}
+
+START_TEST(test_concurrent_alloc)
+{
+    gu::Config conf;
+    init_config(conf);
+
+    GCache* const gc(new GCache(conf, "."));
+
+    static int const threads(4);
+    pthread_t thd[threads];
+
+    for (int i(0); i < threads; ++i)
+    {
+        fail_if(pthread_create(&thd[i], NULL, alloc_thread, gc));
+    }
+
+    for (int i(0); i < threads; ++i)
+    {
+        void* ret;
+        pthread_join(thd[i], &ret);
+        fail_if(0 != ret, "thread %d failed to allocate", i);
+    }
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+static bool
+wait_cold (GCache* const gc, int64_t const seqno)
+{
+    GCache::ColdStats st;
+
+    for (int i(0); i < 500; ++i)
+    {
+        gc->cold_stats(st);
+        if (st.seqno_max >= seqno) return true;
+        usleep(10000);
+    }
+
+    return false;
+}
+
+/* history which no longer fits in the ring buffer is served from
+ * the cold tier */
+START_TEST(test_cold_history)
+{
+    gu::Config conf;
+    init_config(conf);
+    conf.set("gcache.cold_size", "16M");
+
+    GCache* const gc(new GCache(conf, "."));
+
+    int64_t const n(4096);
+    int     const size(500);
+
+    for (int64_t seqno(1); seqno <= n; ++seqno)
+    {
+        void* const ptr(gc->malloc(size));
+        fail_if(0 == ptr);
+        ::memset(ptr, seqno & 0xff, size);
+
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+
+        if (0 == seqno % 256)
+        {
+            gc->seqno_release(seqno);
+            fail_if(!wait_cold(gc, seqno), "seqno %lld not compressed",
+                    static_cast<long long>(seqno));
+        }
+    }
+
+    GCache::ColdStats st;
+    gc->cold_stats(st);
+    fail_if(st.seqno_min != 1);
+    fail_if(st.seqno_max != n);
+    fail_if(st.segments  != size_t(n / 256), "segments: %zu", st.segments);
+    fail_if(st.size >= st.raw_size);
+
+    /* the beginning of history is gone from the ring buffer */
+    fail_if(gc->seqno_min() != 1);
+
+    std::vector<GCache::Buffer> v(300);
+    fail_if(v.size() != gc->seqno_get_buffers(v, 1));
+    gc->seqno_unlock();
+
+    for (size_t i(0); i < v.size(); ++i)
+    {
+        int64_t const seqno(i + 1);
+        fail_if(v[i].seqno_g() != seqno);
+        fail_if(v[i].seqno_d() != seqno - 1);
+        fail_if(v[i].size()    <  size);
+        fail_if(v[i].ptr()[0]        != (seqno & 0xff));
+        fail_if(v[i].ptr()[size - 1] != (seqno & 0xff));
+    }
+
+    gc->seqno_lock(2);
+    gc->seqno_unlock();
+
+    /* new history discards the cold one */
+    gc->seqno_reset(gu::UUID(NULL, 0), 0);
+    gc->cold_stats(st);
+    fail_if(st.segments != 0);
+    fail_if(gc->seqno_min() != -1);
+    fail_if(0 == ::access("gcache.cold.000000", F_OK));
+
+    /* buffers returned before stay valid */
+    fail_if(v[0].ptr()[0] != 1);
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+/* history discarded with a released page buffer before it was compressed
+ * leaves a gap, cold history before it must not be reported */
+START_TEST(test_cold_history_gap)
+{
+    gu::Config conf;
+    init_config(conf);
+    conf.set("gcache.cold_size", "16M");
+
+    GCache* const gc(new GCache(conf, "."));
+
+    int64_t seqno(1);
+
+    for (; seqno <= 256; ++seqno)
+    {
+        void* const ptr(gc->malloc(500));
+        fail_if(0 == ptr);
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+    }
+
+    gc->seqno_release(256);
+    fail_if(!wait_cold(gc, 256));
+
+    /* seqnos up to the page buffer go with it, 257-299 uncompressed */
+    for (; seqno <= 600; ++seqno)
+    {
+        void* const ptr(gc->malloc(300 == seqno ? (2 << 20) : 500));
+        fail_if(0 == ptr);
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+    }
+
+    gc->seqno_release(600);
+    fail_if(!wait_cold(gc, 600));
+
+    GCache::ColdStats st;
+    gc->cold_stats(st);
+    fail_if(st.seqno_min != 301, "cold seqno_min: %lld",
+            static_cast<long long>(st.seqno_min));
+
+    fail_if(gc->seqno_min() != 301, "seqno_min: %lld",
+            static_cast<long long>(gc->seqno_min()));
+
+    try
+    {
+        gc->seqno_lock(1);
+        fail("seqno 1 is still in cache");
+    }
+    catch (gu::NotFound&) {}
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+/* advice follows write rate and IST demand over (fake) time */
+START_TEST(test_advisor)
+{
+    long long const sec(1000000000LL);
+
+    Advisor adv(0);
+    Advisor::Advice a;
+
+    adv.advice(a, 0, 0);
+    fail_if(a.write_rate != 0 || a.recommended_size != 0);
+
+    for (int i(0); i < 1000; ++i) adv.written(100);
+
+    adv.advice(a, 500, 10 * sec);
+    fail_if(a.write_rate != 10000, "write rate: %f", a.write_rate);
+    fail_if(a.seqno_rate != 100,   "seqno rate: %f", a.seqno_rate);
+    fail_if(a.history_time != 5,   "history: %f", a.history_time);
+    fail_if(a.recommended_size != 0);
+
+    adv.ist_request(200, true, 10 * sec);
+    adv.ist_request(5000, false, 10 * sec);
+    adv.ist_request(-1, false, 10 * sec); // joiner ahead of us
+
+    adv.advice(a, 500, 10 * sec);
+    fail_if(a.ist_requests != 3);
+    fail_if(a.ist_misses   != 2);
+    fail_if(a.demand_time  != 50, "demand: %f", a.demand_time);
+    fail_if(a.demand_size  != 500000, "demand: %zu", a.demand_size);
+    fail_if(a.recommended_time != 62.5);
+    fail_if(a.recommended_size != 625000, "size: %zu", a.recommended_size);
+
+    /* twice the write rate makes for twice the bytes per second */
+    for (int i(0); i < 120000; ++i) adv.written(100);
+
+    adv.advice(a, 500, 10 * sec + 10 * 60 * sec);
+    fail_if(a.write_rate <= 10000 || a.write_rate > 20000,
+            "write rate: %f", a.write_rate);
+    fail_if(a.recommended_size != size_t(a.write_rate * 62.5));
+
+    /* old demand is forgotten */
+    adv.advice(a, 500, 8 * 24 * 3600 * sec);
+    fail_if(a.demand_time != 0);
+    fail_if(a.recommended_size != 0);
+    fail_if(a.ist_requests != 3);
+}
+END_TEST
+
+/* IST demand grows keep_pages_size within the budget */
+START_TEST(test_keep_pages_budget)
+{
+    gu::Config conf;
+    init_config(conf);
+    conf.set("gcache.size", "0");
+    conf.set("gcache.page_size", "64K");
+    conf.set("gcache.keep_pages_budget", "100K");
+
+    GCache* const gc(new GCache(conf, "."));
+
+    for (int64_t seqno(1); seqno <= 200; ++seqno)
+    {
+        void* const ptr(gc->malloc(1000));
+        fail_if(0 == ptr);
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+    }
+
+    gc->seqno_release(200);
+
+    try { gc->seqno_lock(181); } catch (gu::NotFound&) {}
+    gc->seqno_unlock();
+
+    /* 20 seqnos take less than the budget */
+    size_t const keep(conf.get<size_t>("gcache.keep_pages_size"));
+    fail_if(keep < 20 * 1000 || keep >= 100 * 1024, "keep: %zu", keep);
+
+    try { gc->seqno_lock(1); } catch (gu::NotFound&) {}
+    gc->seqno_unlock();
+
+    fail_if(conf.get<size_t>("gcache.keep_pages_size") != 100 * 1024);
+
+    GCache::Advice a;
+    gc->advice(a);
+    fail_if(a.ist_requests != 2);
+    fail_if(a.recommended_size <= 100 * 1024);
+
+    /* locks of IST stripes after the first one are not new requests */
+    try { gc->seqno_lock(1, false); } catch (gu::NotFound&) {}
+    gc->seqno_unlock();
+    gc->advice(a);
+    fail_if(a.ist_requests != 2);
+
+    /* disabled budget leaves it alone */
+    gc->param_set("gcache.keep_pages_budget", "0");
+    gc->param_set("gcache.keep_pages_size", "0");
+
+    try { gc->seqno_lock(1); } catch (gu::NotFound&) {}
+    gc->seqno_unlock();
+
+    fail_if(conf.get<size_t>("gcache.keep_pages_size") != 0);
+
+    delete gc;
+}
+END_TEST
+
+/* allocation, fragmentation and lookup statistics */
+START_TEST(test_stats)
+{
+    gu::Config conf;
+    init_config(conf);
+
+    GCache* const gc(new GCache(conf, "."));
+
+    GCache::Stats st;
+    gc->stats(st);
+    fail_if(st.mallocs != 0);
+    fail_if(!st.alloc_sizes.empty());
+    fail_if(st.rb_free + st.rb_used != st.rb_size);
+
+    /* 4 times around the ring */
+    int64_t const n(4096);
+
+    for (int64_t seqno(1); seqno <= n; ++seqno)
+    {
+        void* const ptr(gc->malloc(1000));
+        fail_if(0 == ptr);
+        gc->seqno_assign(ptr, seqno, seqno - 1);
+        gc->free(ptr);
+    }
+
+    /* the oldest seqnos were overwritten */
+    std::vector<GCache::Buffer> v(8);
+    fail_if(gc->seqno_get_buffers(v, n - 7) != 8);
+    fail_if(gc->seqno_get_buffers(v, 1) != 0);
+    gc->seqno_unlock();
+
+    /* bigger than the ring buffer goes to a page */
+    void* const big(gc->malloc(2 << 20));
+    fail_if(0 == big);
+    gc->seqno_assign(big, n + 1, n);
+    gc->free(big);
+
+    gc->stats(st);
+    fail_if(st.mallocs      != n + 1);
+    fail_if(st.mallocs_rb   != n);
+    fail_if(st.mallocs_page != 1);
+    fail_if(st.mallocs_mem  != 0);
+    fail_if(st.rb_wraps < 3 || st.rb_wraps > 4, "wraps: %lld", st.rb_wraps);
+    fail_if(st.rb_used != 0);
+    fail_if(st.rb_trail > st.rb_free || st.rb_free > st.rb_size);
+    fail_if(st.pages_created != 1);
+    fail_if(st.alloc_sizes.find("1024:") == std::string::npos,
+            "alloc sizes: %s", st.alloc_sizes.c_str());
+
+    gc->seqno_release(n + 1);
+
+    gc->stats(st);
+    fail_if(st.seqno_hits   != 1);
+    fail_if(st.seqno_misses != 1);
+    fail_if(st.pages_deleted != 1, "deleted: %lld", st.pages_deleted);
+    fail_if(st.pages != 0);
+
+    delete gc;
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+/* page history recovered without the ring buffer must be gapless */
+START_TEST(test_page_history_gaps)
+{
+    gu::Config conf;
+    init_config(conf);
+    conf.set("gcache.recover", "yes");
+    conf.set("gcache.page_size", "1M");
+    conf.set("gcache.keep_pages_size", "64M");
+
+    gu::UUID const gid(NULL, 0);
+
+    {
+        GCache gc(conf, ".");
+        gc.seqno_reset(gid, SEQNO_NONE);
+
+        /* 1 and 4 go to the ring buffer, the rest to pages */
+        for (int64_t seqno(1); seqno <= 6; ++seqno)
+        {
+            bool const rb(1 == seqno || 4 == seqno);
+            void* const ptr(gc.malloc(rb ? 1000 : (2 << 20)));
+            fail_if(0 == ptr);
+            gc.seqno_assign(ptr, seqno, seqno - 1);
+            gc.free(ptr);
+        }
+
+        fail_if(gc.seqno_min() != 1, "seqno_min: %lld",
+                static_cast<long long>(gc.seqno_min()));
+    }
+
+    /* ring buffer history is lost, pages hold 2-3 and 5-6 */
+    ::unlink(RB_NAME);
+
+    {
+        GCache gc(conf, ".");
+
+        fail_if(gc.seqno_min() != 5, "seqno_min: %lld",
+                static_cast<long long>(gc.seqno_min()));
+
+        std::vector<GCache::Buffer> v(4);
+        fail_if(gc.seqno_get_buffers(v, 5) != 2);
+        fail_if(gc.seqno_get_buffers(v, 2) != 0);
+        gc.seqno_unlock();
+
+        gc.seqno_reset(gu::UUID(), SEQNO_NONE);
+    }
+
+    ::unlink(RB_NAME);
+}
+END_TEST
+
+Suite* gcache_suite()
+{
+    Suite* s = suite_create("gcache::GCache");
+    TCase* tc;
+
+    tc = tcase_create("test");
+    tcase_add_test(tc, test_free_queue);
+    tcase_add_test(tc, test_bulk_release);
+    tcase_add_test(tc, test_rb_mmap_opts);
+    tcase_add_test(tc, test_concurrent_alloc);
+    tcase_add_test(tc, test_cold_history);
+    tcase_add_test(tc, test_cold_history_gap);
+    tcase_add_test(tc, test_advisor);
+    tcase_add_test(tc, test_keep_pages_budget);
+    tcase_add_test(tc, test_stats);
+    tcase_add_test(tc, test_page_history_gaps);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    return s;
+}
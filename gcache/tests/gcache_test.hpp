@@ -0,0 +1,14 @@
+/*
+ * Copyright (C) 2018 Codership Oy <info@codership.com>
+ */
+
+#ifndef __gcache_test_hpp__
+#define __gcache_test_hpp__
+
+extern "C" {
+#include <check.h>
+}
+
+extern Suite* gcache_suite();
+
+#endif // __gcache_test_hpp__